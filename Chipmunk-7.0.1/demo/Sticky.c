@@ -171,25 +171,24 @@ init(void)
 	cpShapeSetFriction(shape, 1.0f);
 	cpShapeSetFilter(shape, NOT_GRABBABLE_FILTER);
 	
-	CellState *cell0 = new CellState(0);
-	CellState *cell1 = new CellState(1);
+	static CellState cell0(0);
+	static CellState cell1(1);
 
 	for(int i=0; i<200; i++){
 		cpFloat mass = 0.15f;
 		cpFloat radius = 10.0f;
-		CellState *cellxxx = new CellState(i);
 
 		cpBody *body = cpSpaceAddBody(space, cpBodyNew(mass, cpMomentForCircle(mass, 0.0f, radius, cpvzero)));
 		cpBodySetPosition(body, cpv(cpflerp(-150.0f, 150.0f, frand()), cpflerp(-150.0f, 150.0f, frand())));
 #if 1
 		if (i % 2 == 0) {
-			cpBodySetUserData(body, cell0);
+			cpBodySetUserData(body, &cell0);
 		}
 		else {
-			cpBodySetUserData(body, cell1);
+			cpBodySetUserData(body, &cell1);
 		}
 #else
-		cpBodySetUserData(body, cellxxx);
+		cpBodySetUserData(body, new CellState(i));
 #endif
 		cpShape *shape = cpSpaceAddShape(space, cpCircleShapeNew(body, radius + STICK_SENSOR_THICKNESS, cpvzero));
 		cpShapeSetFriction(shape, 0.9f);
@@ -71,19 +71,86 @@ CP_EXPORT void cpMessage(const char *condition, const char *file, int line, int
 	#define CP_BUFFER_BYTES (32*1024)
 #endif
 
+/// Heap allocations made through cpcalloc(), cprealloc() and cpfree().
+typedef struct cpAllocStats {
+	/// Number of cpcalloc() and cprealloc() calls.
+	unsigned long allocations;
+	/// Bytes requested by them.
+	unsigned long bytes;
+	/// Number of cpfree() calls.
+	unsigned long frees;
+} cpAllocStats;
+
+/// Allocations made from one cpcalloc() or cprealloc() call site.
+/// The source file tells the subsystem (cpArray.c, cpBBTree.c, cpSpaceStep.c, ...).
+typedef struct cpAllocSite {
+	const char *file;
+	int line;
+	unsigned long allocations;
+	unsigned long bytes;
+} cpAllocSite;
+
+/// calloc() that counts the allocation for its call site and uses the current allocator.
+CP_EXPORT void *cpCallocAt(size_t count, size_t size, const char *file, int line);
+/// realloc() that counts the allocation for its call site and uses the current allocator.
+CP_EXPORT void *cpReallocAt(void *ptr, size_t size, const char *file, int line);
+/// free() that counts the call and uses the current allocator.
+CP_EXPORT void cpFreeCounted(void *ptr);
+
+/// Totals of the counted allocations the calling thread made since it started.
+CP_EXPORT cpAllocStats cpGetAllocStats(void);
+/// Copy up to @c count call sites of the calling thread into @c sites and return the total number of its call sites.
+/// Call sites are only recorded when Chipmunk is built with CP_STEP_STATS defined to 1, otherwise this returns 0.
+CP_EXPORT int cpGetAllocSites(cpAllocSite *sites, int count);
+
+typedef void *(*cpAllocFunc)(void *data, size_t count, size_t size);
+typedef void *(*cpReallocFunc)(void *data, void *ptr, size_t size);
+typedef void (*cpFreeFunc)(void *data, void *ptr);
+
+/// A heap that cpcalloc(), cprealloc() and cpfree() can be routed to.
+/// @c allocFunc must return zeroed memory like calloc().
+typedef struct cpAllocator {
+	cpAllocFunc allocFunc;
+	cpReallocFunc reallocFunc;
+	cpFreeFunc freeFunc;
+	void *data;
+} cpAllocator;
+
+/// Make @c allocator the calling thread's current allocator and return the previous one.
+/// NULL is the C heap, which is the default.
+/// Memory must be freed with the allocator current when it was allocated.
+/// A space remembers the allocator current when it's created and switches to it while it allocates,
+/// so only create and free its bodies, shapes and constraints with that allocator current as well.
+CP_EXPORT cpAllocator *cpSetAllocator(cpAllocator *allocator);
+/// The calling thread's current allocator.
+CP_EXPORT cpAllocator *cpGetAllocator(void);
+
+/// A heap for one thread at a time that carves blocks out of large chunks.
+/// Freed blocks are kept per size class and reused, all of the memory is released at once by cpArenaFree().
+typedef struct cpArena cpArena;
+
+/// Create an arena that grows in chunks of at least @c chunkBytes.
+CP_EXPORT cpArena *cpArenaNew(size_t chunkBytes);
+/// Release all memory allocated from the arena. Nothing allocated from it may be used afterwards.
+CP_EXPORT void cpArenaFree(cpArena *arena);
+/// The allocator that allocates from the arena, pass it to cpSetAllocator().
+CP_EXPORT cpAllocator *cpArenaGetAllocator(cpArena *arena);
+/// Bytes of chunks the arena took from the C heap.
+CP_EXPORT size_t cpArenaGetBytes(cpArena *arena);
+
 #ifndef cpcalloc
 	/// Chipmunk calloc() alias.
-	#define cpcalloc calloc
+	#define cpcalloc(count, size) cpCallocAt(count, size, __FILE__, __LINE__)
 #endif
 
 #ifndef cprealloc
 	/// Chipmunk realloc() alias.
-	#define cprealloc realloc
+	#define cprealloc(ptr, size) cpReallocAt(ptr, size, __FILE__, __LINE__)
 #endif
 
 #ifndef cpfree
 	/// Chipmunk free() alias.
-	#define cpfree free
+	#define cpfree cpFreeCounted
 #endif
 
 typedef struct cpArray cpArray;
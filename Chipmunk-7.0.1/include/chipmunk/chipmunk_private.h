@@ -46,6 +46,7 @@ cpArray *cpArrayNew(int size);
 void cpArrayFree(cpArray *arr);
 
 void cpArrayPush(cpArray *arr, void *object);
+void cpArrayReserve(cpArray *arr, int size);
 void *cpArrayPop(cpArray *arr);
 void cpArrayDeleteObj(cpArray *arr, void *obj);
 cpBool cpArrayContains(cpArray *arr, void *ptr);
@@ -64,6 +65,7 @@ void cpHashSetSetDefaultValue(cpHashSet *set, void *default_value);
 void cpHashSetFree(cpHashSet *set);
 
 int cpHashSetCount(cpHashSet *set);
+void cpHashSetReserve(cpHashSet *set, int count);
 void *cpHashSetInsert(cpHashSet *set, cpHashValue hash, void *ptr, cpHashSetTransFunc trans, void *data);
 void *cpHashSetRemove(cpHashSet *set, cpHashValue hash, void *ptr);
 void *cpHashSetFind(cpHashSet *set, cpHashValue hash, void *ptr);
@@ -113,9 +115,15 @@ struct cpBody {
 	cpFloat w_bias;
 	
 	cpSpace *space;
+	// Slot in the space's dynamic or static body array, -1 while sleeping or not added.
+	int spaceIndex;
+	// Set when added to a space, unlike the address it's not shared with a body freed before.
+	cpHashValue hashid;
 	
 	cpShape *shapeList;
 	cpArbiter *arbiterList;
+	// Every arbiter in the space's cachedArbiters set that touches this body.
+	cpArbiter *cachedArbiterList;
 	cpConstraint *constraintList;
 	
 	struct {
@@ -125,6 +133,9 @@ struct cpBody {
 	} sleeping;
 };
 
+// Stores the CoG position and angle and updates the transform, like cpBodyUpdatePosition().
+void cpBodySetIntegratedTransform(cpBody *body, cpVect p, cpFloat a);
+
 void cpBodyAddShape(cpBody *body, cpShape *shape);
 void cpBodyRemoveShape(cpBody *body, cpShape *shape);
 
@@ -159,6 +170,12 @@ struct cpArbiterThread {
 	struct cpArbiter *next, *prev;
 };
 
+// cpArbiterUpdate() may swap body_a and body_b, so the cache list remembers its body.
+struct cpArbiterCacheThread {
+	cpBody *body;
+	struct cpArbiter *next, *prev;
+};
+
 struct cpContact {
 	cpVect r1, r2;
 	
@@ -192,15 +209,23 @@ struct cpArbiter {
 	const cpShape *a, *b;
 	cpBody *body_a, *body_b;
 	struct cpArbiterThread thread_a, thread_b;
+	struct cpArbiterCacheThread cache_a, cache_b;
+	// Slot in space->arbiters, only meaningful while arbiters->arr[index] == this arbiter.
+	int index;
 	
 	int count;
 	struct cpContact *contacts;
 	cpVect n;
+	// Collision id returned by the last cpCollide(), passed back in as a hint.
+	cpCollisionID id;
 	
 	// Regular, wildcard A and wildcard B collision handlers.
 	cpCollisionHandler *handler, *handlerA, *handlerB;
 	cpBool swapped;
 	
+	// Adhesion joint the space created for this arbiter, see cpShapeSetAdhesion().
+	cpConstraint *joint;
+	
 	cpTimestamp stamp;
 	enum cpArbiterState state;
 };
@@ -215,6 +240,15 @@ cpArbiterThreadForBody(cpArbiter *arb, cpBody *body)
 
 void cpArbiterUnthread(cpArbiter *arb);
 
+static inline struct cpArbiterCacheThread *
+cpArbiterCacheThreadForBody(cpArbiter *arb, cpBody *body)
+{
+	return (arb->cache_a.body == body ? &arb->cache_a : &arb->cache_b);
+}
+
+void cpArbiterCacheThread(cpArbiter *arb);
+void cpArbiterCacheUnthread(cpArbiter *arb);
+
 void cpArbiterUpdate(cpArbiter *arb, struct cpCollisionInfo *info, cpSpace *space);
 void cpArbiterPreStep(cpArbiter *arb, cpFloat dt, cpFloat bias, cpFloat slop);
 void cpArbiterApplyCachedImpulse(cpArbiter *arb, cpFloat dt_coef);
@@ -272,6 +306,10 @@ struct cpShape {
 	cpCollisionType type;
 	cpShapeFilter filter;
 	
+	cpFloat skin;
+	cpFloat adhesion;
+	cpGroup adhesionGroup;
+	
 	cpShape *next;
 	cpShape *prev;
 	
@@ -386,6 +424,8 @@ struct cpConstraint {
 	const cpConstraintClass *klass;
 	
 	cpSpace *space;
+	// Slot in the space's constraint array, -1 while sleeping or not added.
+	int spaceIndex;
 	
 	cpBody *a, *b;
 	cpConstraint *next_a, *next_b;
@@ -662,6 +702,7 @@ struct cpSpace {
 	cpArray *sleepingComponents;
 	
 	cpHashValue shapeIDCounter;
+	cpHashValue bodyIDCounter;
 	cpSpatialIndex *staticShapes;
 	cpSpatialIndex *dynamicShapes;
 	
@@ -679,8 +720,25 @@ struct cpSpace {
 	cpHashSet *collisionHandlers;
 	cpCollisionHandler defaultHandler;
 	
+	cpAdhesionFunc adhesionJoinFunc;
+	cpAdhesionFunc adhesionSeparateFunc;
+	cpDataPointer adhesionData;
+	cpTimestamp adhesionPersistence;
+	cpArray *pooledAdhesionJoints;
+	cpHashSet *adhesionImpulses;
+	cpArray *pooledAdhesionImpulses;
+	cpTimestamp adhesionFilterStamp;
+	
 	cpBool skipPostStep;
 	cpArray *postStepCallbacks;
+	cpHashSet *postStepCallbackSet;
+	cpArray *pooledPostStepCallbacks;
+	
+	cpAllocator *allocator;
+	cpAllocStats stepAllocStats;
+	
+	cpSpaceStepStats stepStats;
+	double stepStatsStart, stepStatsMark;
 	
 	cpBody *staticBody;
 	cpBody _staticBody;
@@ -708,23 +766,111 @@ typedef struct cpPostStepCallback {
 	void *data;
 } cpPostStepCallback;
 
+#define CP_POST_STEP_HASH(key) ((cpHashValue)(key)*CP_HASH_COEF)
+
 cpPostStepCallback *cpSpaceGetPostStepCallback(cpSpace *space, void *key);
 
+// Accumulated impulse of a released adhesion joint, kept for cpSpace.adhesionPersistence steps.
+// The bodies are referred to by hashid, the impulse can outlive them.
+typedef struct cpAdhesionImpulse {
+	cpHashValue a, b;
+	cpVect jAcc;
+	cpTimestamp stamp;
+} cpAdhesionImpulse;
+
+void cpSpaceFilterAdhesionImpulses(cpSpace *space);
+
 cpBool cpSpaceArbiterSetFilter(cpArbiter *arb, cpSpace *space);
+void cpSpaceReleaseAdhesion(cpSpace *space, cpArbiter *arb);
 void cpSpaceFilterArbiters(cpSpace *space, cpBody *body, cpShape *filter);
 
 void cpSpaceActivateBody(cpSpace *space, cpBody *body);
+
+// Makes the allocator the space was created with current, returns the one to restore with cpSetAllocator().
+static inline cpAllocator *
+cpSpaceUseAllocator(const cpSpace *space)
+{
+	return cpSetAllocator(space->allocator);
+}
+
+// Allocations made since start was taken with cpGetAllocStats().
+static inline cpAllocStats
+cpAllocStatsSince(cpAllocStats start)
+{
+	cpAllocStats stats = cpGetAllocStats();
+	stats.allocations -= start.allocations;
+	stats.bytes -= start.bytes;
+	stats.frees -= start.frees;
+	return stats;
+}
+
+//MARK: Step Stats
+
+#ifndef CP_STEP_STATS
+	#define CP_STEP_STATS 0
+#endif
+
+#if CP_STEP_STATS
+	// Seconds on a monotonic clock.
+	double cpStepStatsTime(void);
+	
+	// Clears the stats of the last step and starts timing the first phase.
+	#define cpSpaceBeginStepStats(space) {\
+		cpSpaceStepStats __noStats__ = {0};\
+		(space)->stepStats = __noStats__;\
+		(space)->stepStatsStart = (space)->stepStatsMark = cpStepStatsTime();\
+	}
+	// Adds the time since the end of the last phase to __phase__.
+	#define cpSpaceStepPhase(space, __phase__) {\
+		double __now__ = cpStepStatsTime();\
+		(space)->stepStats.__phase__ += __now__ - (space)->stepStatsMark;\
+		(space)->stepStatsMark = __now__;\
+	}
+	#define cpSpaceStepCount(space, __counter__, __n__) ((space)->stepStats.__counter__ += (unsigned long)(__n__))
+	#define cpSpaceEndStepStats(space) ((space)->stepStats.step = (space)->stepStatsMark - (space)->stepStatsStart)
+#else
+	#define cpSpaceBeginStepStats(space)
+	#define cpSpaceStepPhase(space, __phase__)
+	#define cpSpaceStepCount(space, __counter__, __n__)
+	#define cpSpaceEndStepStats(space)
+#endif
+
 void cpSpaceLock(cpSpace *space);
 void cpSpaceUnlock(cpSpace *space, cpBool runPostStep);
 
+static inline void
+cpSpacePushArbiter(cpSpace *space, cpArbiter *arb)
+{
+	arb->index = space->arbiters->num;
+	cpArrayPush(space->arbiters, arb);
+}
+
+// The arbiters array is emptied at the start of each step without clearing the indexes,
+// so the slot is checked before it is trusted.
+static inline void
+cpSpaceDeleteArbiter(cpSpace *space, cpArbiter *arb)
+{
+	cpArray *arr = space->arbiters;
+	int i = arb->index;
+	if(i < 0 || i >= arr->num || arr->arr[i] != arb) return;
+	
+	cpArbiter *last = (cpArbiter *)arr->arr[--arr->num];
+	arr->arr[i] = last;
+	last->index = i;
+	
+	arr->arr[arr->num] = NULL;
+	arb->index = -1;
+}
+
 static inline void
 cpSpaceUncacheArbiter(cpSpace *space, cpArbiter *arb)
 {
 	const cpShape *a = arb->a, *b = arb->b;
 	const cpShape *shape_pair[] = {a, b};
-	cpHashValue arbHashID = CP_HASH_PAIR((cpHashValue)a, (cpHashValue)b);
+	cpHashValue arbHashID = CP_HASH_PAIR(a->hashid, b->hashid);
 	cpHashSetRemove(space->cachedArbiters, arbHashID, shape_pair);
-	cpArrayDeleteObj(space->arbiters, arb);
+	cpArbiterCacheUnthread(arb);
+	cpSpaceDeleteArbiter(space, arb);
 }
 
 static inline cpArray *
@@ -733,7 +879,56 @@ cpSpaceArrayForBodyType(cpSpace *space, cpBodyType type)
 	return (type == CP_BODY_TYPE_STATIC ? space->staticBodies : space->dynamicBodies);
 }
 
+// Bodies and constraints remember their slot so removal is a swap with the last element.
+static inline void
+cpSpacePushBody(cpArray *arr, cpBody *body)
+{
+	body->spaceIndex = arr->num;
+	cpArrayPush(arr, body);
+}
+
+static inline void
+cpSpaceDeleteBody(cpArray *arr, cpBody *body)
+{
+	// Like cpArrayDeleteObj(), removing an object that is not in an array does nothing.
+	int i = body->spaceIndex;
+	if(i < 0) return;
+	cpAssertSoft(i < arr->num && arr->arr[i] == body, "Internal Error: Body slot does not match the array it is removed from.");
+	
+	cpBody *last = (cpBody *)arr->arr[--arr->num];
+	arr->arr[i] = last;
+	last->spaceIndex = i;
+	
+	arr->arr[arr->num] = NULL;
+	body->spaceIndex = -1;
+}
+
+static inline void
+cpSpacePushConstraint(cpArray *arr, cpConstraint *constraint)
+{
+	constraint->spaceIndex = arr->num;
+	cpArrayPush(arr, constraint);
+}
+
+static inline void
+cpSpaceDeleteConstraint(cpArray *arr, cpConstraint *constraint)
+{
+	// Like cpArrayDeleteObj(), removing an object that is not in an array does nothing.
+	int i = constraint->spaceIndex;
+	if(i < 0) return;
+	cpAssertSoft(i < arr->num && arr->arr[i] == constraint, "Internal Error: Constraint slot does not match the array it is removed from.");
+	
+	cpConstraint *last = (cpConstraint *)arr->arr[--arr->num];
+	arr->arr[i] = last;
+	last->spaceIndex = i;
+	
+	arr->arr[arr->num] = NULL;
+	constraint->spaceIndex = -1;
+}
+
 void cpShapeUpdateFunc(cpShape *shape, void *unused);
+cpBool cpSpaceShapeQueryReject(cpShape *a, cpShape *b);
+void cpSpaceHandleCollision(cpSpace *space, struct cpCollisionInfo *info);
 cpCollisionID cpSpaceCollideShapes(cpShape *a, cpShape *b, cpCollisionID id, cpSpace *space);
 
 
@@ -10,18 +10,73 @@ typedef struct cpHastySpace cpHastySpace;
 
 /// Create a new hasty space.
 /// On ARM platforms that support NEON, this will enable the vectorized solver.
-/// cpHastySpace also supports multiple threads, but runs single threaded by default for determinism.
+/// cpHastySpace also supports multiple threads, but runs single threaded by default.
 CP_EXPORT cpSpace *cpHastySpaceNew(void);
 CP_EXPORT void cpHastySpaceFree(cpSpace *space);
 
-/// Set the number of threads to use for the solver.
-/// Currently Chipmunk is limited to 2 threads as using more generally provides very minimal performance gains.
-/// Passing 0 as the thread count on iOS or OS X will cause Chipmunk to automatically detect the number of threads it should use.
-/// On other platforms passing 0 for the thread count will set 1 thread.
+/// Set the number of threads to use when stepping.
+/// The threads are kept in a pool that spins between the phases of a step and parks between steps.
+/// Position and velocity integration, BB updates, narrowphase, prestep and the solver are split across the threads,
+/// so body position and velocity functions must be thread safe when using more than one thread.
+/// Contacts and constraints are graph colored each step so that rows sharing a dynamic body are never solved concurrently.
+/// The solve order only depends on the colors, so the results are the same for any thread count.
+/// The pool only grows, so this is cheap to call between steps to use fewer threads.
+/// Passing 0 as the thread count will cause Chipmunk to automatically detect the number of threads it should use.
 CP_EXPORT void cpHastySpaceSetThreads(cpSpace *space, unsigned long threads);
 
-/// Returns the number of threads the solver is using to run.
+/// Returns the number of threads used to step.
 CP_EXPORT unsigned long cpHastySpaceGetThreads(cpSpace *space);
 
+/// Solve the contacts of 2 (SSE2) or 4 (AVX2) arbiters at a time. (enabled by default where the CPU supports it)
+/// The results match the scalar solver up to floating point rounding. Has no effect on other CPUs.
+CP_EXPORT void cpHastySpaceSetBatchContacts(cpSpace *space, cpBool enabled);
+
+/// Solve pivot joints 2 (SSE2) or 4 (AVX2) at a time, the other joints still go through their class. (enabled by default where the CPU supports it)
+/// maxForce and maxBias are applied as in cpPivotJoint.c, the results match up to floating point rounding.
+CP_EXPORT void cpHastySpaceSetBatchJoints(cpSpace *space, cpBool enabled);
+
+/// Integrate the bodies that use the default velocity and position functions in batches. (disabled by default)
+/// Their state is copied into small arrays and integrated with SSE2 or AVX2 where available, other bodies still have their functions called.
+/// Results are identical, but the copies only pay off when the bodies are already in cache. Measure before enabling it.
+CP_EXPORT void cpHastySpaceSetBatchIntegration(cpSpace *space, cpBool enabled);
+
+/// Same as cpSpaceReserve(), and also sizes the narrowphase pairs and the solver rows for @c pairs shape pairs.
+/// Use this instead of cpSpaceReserve() with a hasty space.
+CP_EXPORT void cpHastySpaceReserve(cpSpace *space, int pairs, int contacts, int joints);
+
+/// Wall clock time in seconds spent in each phase of the last cpHastySpaceStep().
+/// These are always recorded, cpSpaceGetStepStats() splits the phases further and counts pairs and arbiters.
+typedef struct cpHastySpaceTimings {
+	cpFloat integratePositions;
+	cpFloat updateBBs;
+	cpFloat broadphase;
+	cpFloat narrowphase;
+	/// Arbiter updates, including the begin and preSolve callbacks.
+	cpFloat mergeContacts;
+	cpFloat processComponents;
+	/// Includes the separate callbacks of removed arbiters.
+	cpFloat preStep;
+	cpFloat integrateVelocities;
+	/// Coloring, cached impulses and the solver iterations.
+	cpFloat solve;
+	/// Includes the post-step callbacks.
+	cpFloat postSolve;
+	/// The whole step.
+	cpFloat step;
+	/// Time the calling thread spent waiting for the other threads to finish a phase.
+	cpFloat wait;
+} cpHastySpaceTimings;
+
+/// Get the per phase timings of the last step.
+CP_EXPORT cpHastySpaceTimings cpHastySpaceGetTimings(cpSpace *space);
+
+/// Called by each thread when it starts (@c begin true) and finishes its share of a parallel job of cpHastySpaceStep().
+/// @c name is a static string naming the job, @c thread is 0 for the thread calling cpHastySpaceStep() and 1 or more for the workers.
+/// The threads call it concurrently, so it must be thread safe.
+typedef void (*cpHastySpaceWorkHook)(const char *name, unsigned long thread, cpBool begin, void *data);
+
+/// Set a hook to see what the threads of the space are doing, for profilers. NULL removes it.
+CP_EXPORT void cpHastySpaceSetWorkHook(cpSpace *space, cpHastySpaceWorkHook hook, void *data);
+
 /// When stepping a hasty space, you must use this function.
 CP_EXPORT void cpHastySpaceStep(cpSpace *space, cpFloat dt);
@@ -158,6 +158,25 @@ CP_EXPORT cpShapeFilter cpShapeGetFilter(const cpShape *shape);
 /// Set the collision filtering parameters of this shape.
 CP_EXPORT void cpShapeSetFilter(cpShape *shape, cpShapeFilter filter);
 
+/// Get the skin thickness of this shape.
+CP_EXPORT cpFloat cpShapeGetSkin(const cpShape *shape);
+/// Set the skin thickness of this shape.
+/// Contact points are sunk this far into the shape, so touching shapes can overlap by their skins before they are pushed apart.
+CP_EXPORT void cpShapeSetSkin(cpShape *shape, cpFloat skin);
+
+/// Get the adhesion strength of this shape.
+CP_EXPORT cpFloat cpShapeGetAdhesion(const cpShape *shape);
+/// Set the adhesion strength of this shape, 0 (the default) disables adhesion.
+/// When two adhesive shapes of the same adhesion group touch, the space pins them together with a pivot joint
+/// at their first contact point. The joint's max force is the smaller strength of the two.
+/// The space owns the joint and removes it when the shapes separate, see cpSpaceSetAdhesionFuncs().
+/// Don't remove or free it yourself.
+CP_EXPORT void cpShapeSetAdhesion(cpShape *shape, cpFloat adhesion);
+/// Get the adhesion group of this shape.
+CP_EXPORT cpGroup cpShapeGetAdhesionGroup(const cpShape *shape);
+/// Set the adhesion group of this shape. Adhesive shapes only stick to shapes of the same group.
+CP_EXPORT void cpShapeSetAdhesionGroup(cpShape *shape, cpGroup group);
+
 
 /// @}
 /// @defgroup cpCircleShape cpCircleShape
@@ -123,6 +123,65 @@ CP_EXPORT void cpSpaceSetCollisionBias(cpSpace *space, cpFloat collisionBias);
 CP_EXPORT cpTimestamp cpSpaceGetCollisionPersistence(const cpSpace *space);
 CP_EXPORT void cpSpaceSetCollisionPersistence(cpSpace *space, cpTimestamp collisionPersistence);
 
+/// Number of frames the impulse of a separated adhesion joint is remembered, see cpShapeSetAdhesion().
+/// If the same bodies stick together again within that time, their new joint starts from the old impulse.
+/// Defaults to 30.
+CP_EXPORT cpTimestamp cpSpaceGetAdhesionPersistence(const cpSpace *space);
+CP_EXPORT void cpSpaceSetAdhesionPersistence(cpSpace *space, cpTimestamp adhesionPersistence);
+
+/// The allocator that was current when the space was created, see cpSetAllocator().
+/// The space makes it current while it steps, adds or removes objects and frees itself.
+CP_EXPORT cpAllocator *cpSpaceGetAllocator(const cpSpace *space);
+
+/// Heap allocations made by Chipmunk during the last step of the space, see cpGetAllocStats().
+/// Once a scene has settled its pools should be large enough that this stays at zero.
+CP_EXPORT cpAllocStats cpSpaceGetStepAllocStats(const cpSpace *space);
+/// Preallocate room for @c arbiters colliding shape pairs with @c contacts contact points between them, and for @c joints adhesion joints.
+/// A step that stays within these doesn't grow any of the space's pools.
+CP_EXPORT void cpSpaceReserve(cpSpace *space, int arbiters, int contacts, int joints);
+
+/// What the last step of the space did and how long each of its phases took in seconds.
+/// Only recorded when Chipmunk is built with CP_STEP_STATS defined to 1, otherwise everything stays zero.
+typedef struct cpSpaceStepStats {
+	/// Resetting and unthreading last step's arbiters.
+	double resetArbiters;
+	double integratePositions;
+	double updateBBs;
+	/// Reindexing the dynamic shapes and querying them for pairs.
+	double broadphase;
+	/// cpCollide() and the arbiter updates, including the begin and preSolve callbacks.
+	double narrowphase;
+	double processComponents;
+	/// Throwing out old arbiters and adhesion impulses, including the separate callbacks.
+	double filterArbiters;
+	double preStep;
+	double integrateVelocities;
+	/// cpHastySpace applies the cached impulses in its solver, so they are part of solve there.
+	double applyCachedImpulses;
+	/// The solver iterations.
+	double solve;
+	/// The post-solve and the post-step callbacks.
+	double postSolve;
+	/// The whole step.
+	double step;
+	
+	/// Shape pairs the broadphase reported.
+	unsigned long candidatePairs;
+	/// Pairs that passed the filters and went through cpCollide().
+	unsigned long collideCalls;
+	/// Arbiters of shapes that started touching this step.
+	unsigned long newArbiters;
+	/// Arbiters of shapes that were already touching.
+	unsigned long cachedArbiters;
+	/// Arbiters thrown out of the cache after collisionPersistence steps without contact.
+	unsigned long removedArbiters;
+	/// Post-step callbacks queued during the step.
+	unsigned long postStepCallbacks;
+} cpSpaceStepStats;
+
+/// Get the phase timings and counters of the last step.
+CP_EXPORT cpSpaceStepStats cpSpaceGetStepStats(const cpSpace *space);
+
 /// User definable data pointer.
 /// Generally this points to your game's controller or game state
 /// class so you can access it when given a cpSpace reference in a callback.
@@ -151,6 +210,13 @@ CP_EXPORT cpCollisionHandler *cpSpaceAddCollisionHandler(cpSpace *space, cpColli
 /// Create or return the existing wildcard collision handler for the specified type.
 CP_EXPORT cpCollisionHandler *cpSpaceAddWildcardHandler(cpSpace *space, cpCollisionType type);
 
+/// Adhesion callback function type.
+typedef void (*cpAdhesionFunc)(cpSpace *space, cpConstraint *joint, cpDataPointer userData);
+/// Set the functions called when the space joins two adhesive shapes and when they separate again, see cpShapeSetAdhesion().
+/// @c joinFunc is called once the new joint is added, @c separateFunc right before the joint is removed and freed.
+/// Both may be called while the space is locked, so they must not add or remove objects.
+CP_EXPORT void cpSpaceSetAdhesionFuncs(cpSpace *space, cpAdhesionFunc joinFunc, cpAdhesionFunc separateFunc, cpDataPointer userData);
+
 
 //MARK: Add/Remove objects
 
@@ -164,6 +230,9 @@ CP_EXPORT cpConstraint* cpSpaceAddConstraint(cpSpace *space, cpConstraint *const
 
 /// Remove a collision shape from the simulation.
 CP_EXPORT void cpSpaceRemoveShape(cpSpace *space, cpShape *shape);
+/// Remove several collision shapes at once.
+/// Separate callbacks are called for all of them before any post-step callback runs.
+CP_EXPORT void cpSpaceRemoveShapes(cpSpace *space, cpShape **shapes, int count);
 /// Remove a rigid body from the simulation.
 CP_EXPORT void cpSpaceRemoveBody(cpSpace *space, cpBody *body);
 /// Remove a constraint from the simulation.
@@ -247,6 +316,9 @@ CP_EXPORT void cpSpaceReindexShapesForBody(cpSpace *space, cpBody *body);
 
 /// Switch the space to use a spatial has as it's spatial index.
 CP_EXPORT void cpSpaceUseSpatialHash(cpSpace *space, cpFloat dim, int count);
+/// Switch the space to use a uniform grid as it's spatial index.
+/// This is a good fit for spaces where most shapes are about the same size, @c dim should be a little larger than them.
+CP_EXPORT void cpSpaceUseSpatialGrid(cpSpace *space, cpFloat dim);
 
 
 //MARK: Time Stepping
@@ -81,6 +81,22 @@ CP_EXPORT cpSpatialIndex* cpSpaceHashNew(cpFloat celldim, int cells, cpSpatialIn
 /// Some trial and error is required to find the optimum numbers for efficiency.
 CP_EXPORT void cpSpaceHashResize(cpSpaceHash *hash, cpFloat celldim, int numcells);
 
+//MARK: Uniform Grid
+
+typedef struct cpSpaceGrid cpSpaceGrid;
+
+/// Allocate a uniform grid.
+CP_EXPORT cpSpaceGrid* cpSpaceGridAlloc(void);
+/// Initialize a uniform grid.
+CP_EXPORT cpSpatialIndex* cpSpaceGridInit(cpSpaceGrid *grid, cpFloat celldim, cpSpatialIndexBBFunc bbfunc, cpSpatialIndex *staticIndex);
+/// Allocate and initialize a uniform grid.
+CP_EXPORT cpSpatialIndex* cpSpaceGridNew(cpFloat celldim, cpSpatialIndexBBFunc bbfunc, cpSpatialIndex *staticIndex);
+
+/// Change the cell dimensions of the uniform grid.
+/// Works best when most objects are about the same size and the cells are a little larger than them.
+/// Unlike the spatial hash there is no table size to tune, the cells are sorted into flat arrays on every reindex.
+CP_EXPORT void cpSpaceGridResize(cpSpaceGrid *grid, cpFloat celldim);
+
 //MARK: AABB Tree
 
 typedef struct cpBBTree cpBBTree;
@@ -95,6 +111,10 @@ CP_EXPORT cpSpatialIndex* cpBBTreeNew(cpSpatialIndexBBFunc bbfunc, cpSpatialInde
 /// Perform a static top down optimization of the tree.
 CP_EXPORT void cpBBTreeOptimize(cpSpatialIndex *index);
 
+/// Preallocate room for @c count overlapping pairs in the tree's pair cache, it's shared with its static tree.
+/// Does nothing if the index is not a tree.
+CP_EXPORT void cpBBTreeReservePairs(cpSpatialIndex *index, int count);
+
 /// Bounding box tree velocity callback function.
 /// This function should return an estimate for the object's velocity.
 typedef cpVect (*cpBBTreeVelocityFunc)(void *obj);
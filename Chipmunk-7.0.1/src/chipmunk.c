@@ -40,6 +40,154 @@ cpMessage(const char *condition, const char *file, int line, int isError, int is
 	fprintf(stderr, "\tSource:%s:%d\n", file, line);
 }
 
+//MARK: Allocation Accounting
+
+#if defined(_MSC_VER)
+	#define CP_THREAD_LOCAL __declspec(thread)
+#else
+	#define CP_THREAD_LOCAL __thread
+#endif
+
+// Per thread, so spaces stepped on different threads neither race on nor see each other's counts.
+static CP_THREAD_LOCAL cpAllocStats AllocStats;
+
+static CP_THREAD_LOCAL cpAllocator *CurrentAllocator = NULL;
+
+#if CP_STEP_STATS
+
+#define ALLOC_SITE_COUNT 128
+
+static CP_THREAD_LOCAL cpAllocSite AllocSites[ALLOC_SITE_COUNT];
+static CP_THREAD_LOCAL int AllocSiteCount = 0;
+
+static void
+CountAllocSite(size_t bytes, const char *file, int line)
+{
+	cpAllocSite *site = NULL;
+	for(int i=0; i<AllocSiteCount; i++){
+		// __FILE__ is almost always the same pointer for a file, strcmp() is only the fallback.
+		if(AllocSites[i].line == line && (AllocSites[i].file == file || strcmp(AllocSites[i].file, file) == 0)){
+			site = &AllocSites[i];
+			break;
+		}
+	}
+	
+	if(site == NULL){
+		// Once the table is full the remaining sites only show up in the totals.
+		if(AllocSiteCount == ALLOC_SITE_COUNT) return;
+		
+		site = &AllocSites[AllocSiteCount++];
+		site->file = file;
+		site->line = line;
+	}
+	
+	site->allocations++;
+	site->bytes += (unsigned long)bytes;
+}
+
+#endif
+
+static inline void
+CountAlloc(size_t bytes, const char *file, int line)
+{
+	AllocStats.allocations++;
+	AllocStats.bytes += (unsigned long)bytes;
+	
+#if CP_STEP_STATS
+	CountAllocSite(bytes, file, line);
+#endif
+}
+
+void *
+cpCallocAt(size_t count, size_t size, const char *file, int line)
+{
+	CountAlloc(count*size, file, line);
+	
+	cpAllocator *allocator = CurrentAllocator;
+	return (allocator ? allocator->allocFunc(allocator->data, count, size) : calloc(count, size));
+}
+
+void *
+cpReallocAt(void *ptr, size_t size, const char *file, int line)
+{
+	CountAlloc(size, file, line);
+	
+	cpAllocator *allocator = CurrentAllocator;
+	return (allocator ? allocator->reallocFunc(allocator->data, ptr, size) : realloc(ptr, size));
+}
+
+void
+cpFreeCounted(void *ptr)
+{
+	if(ptr == NULL) return;
+	AllocStats.frees++;
+	
+	cpAllocator *allocator = CurrentAllocator;
+	if(allocator){
+		allocator->freeFunc(allocator->data, ptr);
+	} else {
+		free(ptr);
+	}
+}
+
+cpAllocStats
+cpGetAllocStats(void)
+{
+	return AllocStats;
+}
+
+int
+cpGetAllocSites(cpAllocSite *sites, int count)
+{
+#if CP_STEP_STATS
+	for(int i=0; i<count && i<AllocSiteCount; i++) sites[i] = AllocSites[i];
+	return AllocSiteCount;
+#else
+	return 0;
+#endif
+}
+
+cpAllocator *
+cpSetAllocator(cpAllocator *allocator)
+{
+	cpAllocator *prev = CurrentAllocator;
+	CurrentAllocator = allocator;
+	return prev;
+}
+
+cpAllocator *
+cpGetAllocator(void)
+{
+	return CurrentAllocator;
+}
+
+//MARK: Step Stats
+
+#if CP_STEP_STATS
+
+#if defined(_WIN32)
+	#include <windows.h>
+#else
+	#include <time.h>
+#endif
+
+double
+cpStepStatsTime(void)
+{
+#if defined(_WIN32)
+	LARGE_INTEGER count, frequency;
+	QueryPerformanceCounter(&count);
+	QueryPerformanceFrequency(&frequency);
+	return (double)count.QuadPart/(double)frequency.QuadPart;
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec*1e-9;
+#endif
+}
+
+#endif
+
 #define STR(s) #s
 #define XSTR(s) STR(s)
 
@@ -228,6 +376,8 @@ QHullReduce(cpFloat tol, cpVect *verts, int count, cpVect a, cpVect pivot, cpVec
 		result[index++] = pivot;
 		
 		int right_count = QHullPartition(verts + left_count, count - left_count, pivot, b, tol);
+		// Nothing right of the pivot, verts[left_count] would be read past the end.
+		if(right_count == 0) return index;
 		return index + QHullReduce(tol, verts + left_count + 1, right_count - 1, pivot, verts[left_count], b, result + index);
 	}
 }
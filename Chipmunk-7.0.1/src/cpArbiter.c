@@ -51,6 +51,52 @@ cpArbiterUnthread(cpArbiter *arb)
 	unthreadHelper(arb, arb->body_b);
 }
 
+static inline void
+cacheThreadHelper(cpArbiter *arb, struct cpArbiterCacheThread *thread, cpBody *body)
+{
+	cpArbiter *next = body->cachedArbiterList;
+	
+	thread->body = body;
+	thread->prev = NULL;
+	thread->next = next;
+	if(next) cpArbiterCacheThreadForBody(next, body)->prev = arb;
+	body->cachedArbiterList = arb;
+}
+
+static inline void
+cacheUnthreadHelper(cpArbiter *arb, cpBody *body)
+{
+	struct cpArbiterCacheThread *thread = cpArbiterCacheThreadForBody(arb, body);
+	cpArbiter *prev = thread->prev;
+	cpArbiter *next = thread->next;
+	
+	if(prev){
+		cpArbiterCacheThreadForBody(prev, body)->next = next;
+	} else if(body->cachedArbiterList == arb) {
+		body->cachedArbiterList = next;
+	}
+	
+	if(next) cpArbiterCacheThreadForBody(next, body)->prev = prev;
+	
+	thread->prev = NULL;
+	thread->next = NULL;
+}
+
+// Called when the arbiter is added to or removed from space->cachedArbiters.
+void
+cpArbiterCacheThread(cpArbiter *arb)
+{
+	cacheThreadHelper(arb, &arb->cache_a, arb->body_a);
+	cacheThreadHelper(arb, &arb->cache_b, arb->body_b);
+}
+
+void
+cpArbiterCacheUnthread(cpArbiter *arb)
+{
+	cacheUnthreadHelper(arb, arb->cache_a.body);
+	cacheUnthreadHelper(arb, arb->cache_b.body);
+}
+
 cpBool cpArbiterIsFirstContact(const cpArbiter *arb)
 {
 	return arb->state == CP_ARBITER_STATE_FIRST_COLLISION;
@@ -326,6 +372,7 @@ cpArbiterInit(cpArbiter *arb, cpShape *a, cpShape *b)
 	
 	arb->count = 0;
 	arb->contacts = NULL;
+	arb->id = 0;
 	
 	arb->a = a; arb->body_a = a->body;
 	arb->b = b; arb->body_b = b->body;
@@ -335,10 +382,19 @@ cpArbiterInit(cpArbiter *arb, cpShape *a, cpShape *b)
 	arb->thread_a.prev = NULL;
 	arb->thread_b.prev = NULL;
 	
+	arb->cache_a.body = NULL;
+	arb->cache_b.body = NULL;
+	arb->cache_a.next = NULL;
+	arb->cache_b.next = NULL;
+	arb->cache_a.prev = NULL;
+	arb->cache_b.prev = NULL;
+	arb->index = -1;
+	
 	arb->stamp = 0;
 	arb->state = CP_ARBITER_STATE_FIRST_COLLISION;
 	
 	arb->data = NULL;
+	arb->joint = NULL;
 	
 	return arb;
 }
@@ -359,6 +415,7 @@ cpArbiterUpdate(cpArbiter *arb, struct cpCollisionInfo *info, cpSpace *space)
 	// For collisions between two similar primitive types, the order could have been swapped since the last frame.
 	arb->a = a; arb->body_a = a->body;
 	arb->b = b; arb->body_b = b->body;
+	arb->id = info->id;
 	
 	// Iterate over the possible pairs to look for hash value matches.
 	for(int i=0; i<info->count; i++){
@@ -366,8 +423,9 @@ cpArbiterUpdate(cpArbiter *arb, struct cpCollisionInfo *info, cpSpace *space)
 		
 		// r1 and r2 store absolute offsets at init time.
 		// Need to convert them to relative offsets.
-		con->r1 = cpvsub(con->r1, a->body->p);
-		con->r2 = cpvsub(con->r2, b->body->p);
+		// The skins sink the contact points into the surface of each shape.
+		con->r1 = cpvsub(con->r1, cpvadd(a->body->p, cpvmult(info->n, a->skin)));
+		con->r2 = cpvsub(con->r2, cpvsub(b->body->p, cpvmult(info->n, b->skin)));
 		
 		// Cached impulses are not zeroed at init time.
 		con->jnAcc = con->jtAcc = 0.0f;
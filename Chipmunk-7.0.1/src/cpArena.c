@@ -0,0 +1,224 @@
+/* Copyright (c) 2013 Scott Lembcke and Howling Moon Software
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// Arena allocator.
+// Blocks are carved out of large chunks and carry their size class in a small header.
+// Freed blocks go on a free list per size class, there are four classes per power of two
+// so the CP_BUFFER_BYTES pools don't end up in blocks twice their size.
+// Nothing is returned to the C heap until the whole arena is released.
+
+#include <string.h>
+
+#include "chipmunk/chipmunk_private.h"
+
+// Keeps the blocks 16 byte aligned for SSE.
+#define HEADER_BYTES 16
+#define MIN_SHIFT 6
+#define MAX_SHIFT 48
+#define CLASS_COUNT (4*(MAX_SHIFT - MIN_SHIFT))
+
+// Blocks at least this fraction of a chunk get a chunk of their own.
+#define LARGE_BLOCK_FRACTION 4
+
+typedef struct Chunk {
+	struct Chunk *next;
+	size_t bytes;
+} Chunk;
+
+#define CHUNK_DATA_OFFSET ((sizeof(Chunk) + HEADER_BYTES - 1) & ~(size_t)(HEADER_BYTES - 1))
+
+struct cpArena {
+	cpAllocator allocator;
+	size_t chunkBytes;
+	size_t bytes;
+
+	Chunk *chunks;
+	// Chunk the small blocks are carved from.
+	Chunk *current;
+	size_t used;
+
+	void *freeBlocks[CLASS_COUNT];
+};
+
+//MARK: Size Classes
+
+static inline size_t
+ClassBytes(int sizeClass)
+{
+	int shift = MIN_SHIFT + sizeClass/4;
+	return ((size_t)1 << shift) + (sizeClass%4)*((size_t)1 << (shift - 2));
+}
+
+static int
+SizeClass(size_t bytes)
+{
+	if(bytes <= ((size_t)1 << MIN_SHIFT)) return 0;
+
+	int shift = MIN_SHIFT;
+	while(((size_t)1 << (shift + 1)) < bytes) shift++;
+
+	size_t step = (size_t)1 << (shift - 2);
+	int sizeClass = 4*(shift - MIN_SHIFT) + (int)((bytes - ((size_t)1 << shift) + step - 1)/step);
+	cpAssertHard(sizeClass < CLASS_COUNT, "Arena block is too large.");
+	return sizeClass;
+}
+
+static inline int
+BlockClass(void *ptr)
+{
+	return *(int *)((char *)ptr - HEADER_BYTES);
+}
+
+//MARK: Chunks
+
+static Chunk *
+ArenaNewChunk(cpArena *arena, size_t bytes)
+{
+	// The chunks come from the C heap, not from the current allocator.
+	Chunk *chunk = (Chunk *)malloc(CHUNK_DATA_OFFSET + bytes);
+	cpAssertHard(chunk, "Out of memory.");
+
+	chunk->bytes = bytes;
+	chunk->next = arena->chunks;
+	arena->chunks = chunk;
+	arena->bytes += bytes;
+
+	return chunk;
+}
+
+static char *
+ArenaCarve(cpArena *arena, size_t blockBytes)
+{
+	if(blockBytes*LARGE_BLOCK_FRACTION >= arena->chunkBytes){
+		return (char *)ArenaNewChunk(arena, blockBytes) + CHUNK_DATA_OFFSET;
+	}
+
+	if(arena->current == NULL || arena->used + blockBytes > arena->current->bytes){
+		// The rest of the old chunk is small compared to a chunk, just leave it.
+		arena->current = ArenaNewChunk(arena, arena->chunkBytes);
+		arena->used = 0;
+	}
+
+	char *block = (char *)arena->current + CHUNK_DATA_OFFSET + arena->used;
+	arena->used += blockBytes;
+	return block;
+}
+
+//MARK: Blocks
+
+static void *
+ArenaAllocBlock(cpArena *arena, size_t bytes)
+{
+	int sizeClass = SizeClass(bytes + HEADER_BYTES);
+
+	char *block = (char *)arena->freeBlocks[sizeClass];
+	if(block){
+		arena->freeBlocks[sizeClass] = *(void **)block;
+		block -= HEADER_BYTES;
+	} else {
+		block = ArenaCarve(arena, ClassBytes(sizeClass));
+	}
+
+	*(int *)block = sizeClass;
+	return block + HEADER_BYTES;
+}
+
+static void
+ArenaFreeBlock(cpArena *arena, void *ptr)
+{
+	if(ptr == NULL) return;
+
+	int sizeClass = BlockClass(ptr);
+	*(void **)ptr = arena->freeBlocks[sizeClass];
+	arena->freeBlocks[sizeClass] = ptr;
+}
+
+static void *
+ArenaAlloc(cpArena *arena, size_t count, size_t size)
+{
+	void *ptr = ArenaAllocBlock(arena, count*size);
+	memset(ptr, 0, count*size);
+	return ptr;
+}
+
+static void *
+ArenaRealloc(cpArena *arena, void *ptr, size_t size)
+{
+	if(ptr == NULL) return ArenaAllocBlock(arena, size);
+
+	size_t capacity = ClassBytes(BlockClass(ptr)) - HEADER_BYTES;
+	if(size <= capacity) return ptr;
+
+	void *block = ArenaAllocBlock(arena, size);
+	memcpy(block, ptr, capacity);
+	ArenaFreeBlock(arena, ptr);
+
+	return block;
+}
+
+//MARK: Public Functions
+
+cpArena *
+cpArenaNew(size_t chunkBytes)
+{
+	cpArena *arena = (cpArena *)calloc(1, sizeof(cpArena));
+	cpAssertHard(arena, "Out of memory.");
+
+	arena->allocator.allocFunc = (cpAllocFunc)ArenaAlloc;
+	arena->allocator.reallocFunc = (cpReallocFunc)ArenaRealloc;
+	arena->allocator.freeFunc = (cpFreeFunc)ArenaFreeBlock;
+	arena->allocator.data = arena;
+
+	// Small chunks would make every pool buffer a large block.
+	size_t minChunkBytes = LARGE_BLOCK_FRACTION*2*CP_BUFFER_BYTES;
+	arena->chunkBytes = (chunkBytes > minChunkBytes ? chunkBytes : minChunkBytes);
+
+	return arena;
+}
+
+void
+cpArenaFree(cpArena *arena)
+{
+	if(arena){
+		cpAssertWarn(cpGetAllocator() != &arena->allocator, "Freeing the current allocator.");
+
+		Chunk *chunk = arena->chunks;
+		while(chunk){
+			Chunk *next = chunk->next;
+			free(chunk);
+			chunk = next;
+		}
+
+		free(arena);
+	}
+}
+
+cpAllocator *
+cpArenaGetAllocator(cpArena *arena)
+{
+	return &arena->allocator;
+}
+
+size_t
+cpArenaGetBytes(cpArena *arena)
+{
+	return arena->bytes;
+}
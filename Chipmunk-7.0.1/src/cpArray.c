@@ -59,6 +59,15 @@ cpArrayPush(cpArray *arr, void *object)
 	arr->num++;
 }
 
+void
+cpArrayReserve(cpArray *arr, int size)
+{
+	if(size > arr->max){
+		arr->max = size;
+		arr->arr = (void **)cprealloc(arr->arr, arr->max*sizeof(void*));
+	}
+}
+
 void *
 cpArrayPop(cpArray *arr)
 {
@@ -139,6 +139,19 @@ PairRecycle(cpBBTree *tree, Pair *pair)
 	tree->pooledPairs = pair;
 }
 
+static int
+PairPoolGrow(cpBBTree *tree)
+{
+	int count = CP_BUFFER_BYTES/sizeof(Pair);
+	cpAssertHard(count, "Internal Error: Buffer size is too small.");
+	
+	Pair *buffer = (Pair *)cpcalloc(1, CP_BUFFER_BYTES);
+	cpArrayPush(tree->allocatedBuffers, buffer);
+	
+	for(int i=0; i<count; i++) PairRecycle(tree, buffer + i);
+	return count;
+}
+
 static Pair *
 PairFromPool(cpBBTree *tree)
 {
@@ -146,23 +159,12 @@ PairFromPool(cpBBTree *tree)
 	// TODO: would be lovely to move the pairs stuff into an external data structure.
 	tree = GetMasterTree(tree);
 	
-	Pair *pair = tree->pooledPairs;
+	// Pool is exhausted, make more
+	if(!tree->pooledPairs) PairPoolGrow(tree);
 	
-	if(pair){
-		tree->pooledPairs = pair->a.next;
-		return pair;
-	} else {
-		// Pool is exhausted, make more
-		int count = CP_BUFFER_BYTES/sizeof(Pair);
-		cpAssertHard(count, "Internal Error: Buffer size is too small.");
-		
-		Pair *buffer = (Pair *)cpcalloc(1, CP_BUFFER_BYTES);
-		cpArrayPush(tree->allocatedBuffers, buffer);
-		
-		// push all but the first one, return the first instead
-		for(int i=1; i<count; i++) PairRecycle(tree, buffer + i);
-		return buffer;
-	}
+	Pair *pair = tree->pooledPairs;
+	tree->pooledPairs = pair->a.next;
+	return pair;
 }
 
 static inline void
@@ -574,6 +576,30 @@ cpBBTreeInit(cpBBTree *tree, cpSpatialIndexBBFunc bbfunc, cpSpatialIndex *static
 	return (cpSpatialIndex *)tree;
 }
 
+static void
+CountLeafThreads(Node *leaf, int *count)
+{
+	for(Pair *pair = leaf->PAIRS; pair; pair = (pair->a.leaf == leaf ? pair->a.next : pair->b.next)) (*count)++;
+}
+
+void
+cpBBTreeReservePairs(cpSpatialIndex *index, int count)
+{
+	cpBBTree *tree = GetTree(index);
+	if(!tree) return;
+	tree = GetMasterTree(tree);
+	
+	// Every pair is threaded through both of its leaves, one of them may be in the static tree.
+	int threads = 0;
+	cpHashSetEach(tree->leaves, (cpHashSetIteratorFunc)CountLeafThreads, &threads);
+	cpBBTree *staticTree = GetTree(tree->spatialIndex.staticIndex);
+	if(staticTree) cpHashSetEach(staticTree->leaves, (cpHashSetIteratorFunc)CountLeafThreads, &threads);
+	
+	int pairs = threads/2;
+	for(Pair *pair = tree->pooledPairs; pair; pair = pair->a.next) pairs++;
+	while(pairs < count) pairs += PairPoolGrow(tree);
+}
+
 void
 cpBBTreeSetVelocityFunc(cpSpatialIndex *index, cpBBTreeVelocityFunc func)
 {
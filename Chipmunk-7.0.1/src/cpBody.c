@@ -34,8 +34,11 @@ cpBody *
 cpBodyInit(cpBody *body, cpFloat mass, cpFloat moment)
 {
 	body->space = NULL;
+	body->spaceIndex = -1;
+	body->hashid = 0;
 	body->shapeList = NULL;
 	body->arbiterList = NULL;
+	body->cachedArbiterList = NULL;
 	body->constraintList = NULL;
 	
 	body->velocity_func = cpBodyUpdateVelocity;
@@ -172,6 +175,7 @@ cpBodySetType(cpBody *body, cpBodyType type)
 	cpSpace *space = cpBodyGetSpace(body);
 	if(space != NULL){
 		cpAssertSpaceUnlocked(space);
+		cpAllocator *allocator = cpSpaceUseAllocator(space);
 		
 		if(oldType == CP_BODY_TYPE_STATIC){
 			// TODO This is probably not necessary
@@ -184,8 +188,8 @@ cpBodySetType(cpBody *body, cpBodyType type)
 		cpArray *fromArray = cpSpaceArrayForBodyType(space, oldType);
 		cpArray *toArray = cpSpaceArrayForBodyType(space, type);
 		if(fromArray != toArray){
-			cpArrayDeleteObj(fromArray, body);
-			cpArrayPush(toArray, body);
+			cpSpaceDeleteBody(fromArray, body);
+			cpSpacePushBody(toArray, body);
 		}
 		
 		// Move the body's shapes to the correct spatial index.
@@ -197,6 +201,8 @@ cpBodySetType(cpBody *body, cpBodyType type)
 				cpSpatialIndexInsert(toIndex, shape, shape->hashid);
 			}
 		}
+		
+		cpSetAllocator(allocator);
 	}
 }
 
@@ -365,6 +371,13 @@ SetAngle(cpBody *body, cpFloat a)
 	return a;
 }
 
+void
+cpBodySetIntegratedTransform(cpBody *body, cpVect p, cpFloat a)
+{
+	body->p = p;
+	SetTransform(body, p, SetAngle(body, a));
+}
+
 cpVect
 cpBodyGetPosition(const cpBody *body)
 {
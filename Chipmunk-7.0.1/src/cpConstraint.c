@@ -42,6 +42,7 @@ cpConstraintInit(cpConstraint *constraint, const cpConstraintClass *klass, cpBod
 	constraint->a = a;
 	constraint->b = b;
 	constraint->space = NULL;
+	constraint->spaceIndex = -1;
 	
 	constraint->next_a = NULL;
 	constraint->next_b = NULL;
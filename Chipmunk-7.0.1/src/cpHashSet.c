@@ -121,25 +121,41 @@ recycleBin(cpHashSet *set, cpHashSetBin *bin)
 	bin->elt = NULL;
 }
 
+static void
+growBinPool(cpHashSet *set)
+{
+	int count = CP_BUFFER_BYTES/sizeof(cpHashSetBin);
+	cpAssertHard(count, "Internal Error: Buffer size is too small.");
+	
+	cpHashSetBin *buffer = (cpHashSetBin *)cpcalloc(1, CP_BUFFER_BYTES);
+	cpArrayPush(set->allocatedBuffers, buffer);
+	
+	for(int i=0; i<count; i++) recycleBin(set, buffer + i);
+}
+
 static cpHashSetBin *
 getUnusedBin(cpHashSet *set)
 {
+	// Pool is exhausted, make more
+	if(!set->pooledBins) growBinPool(set);
+	
 	cpHashSetBin *bin = set->pooledBins;
+	set->pooledBins = bin->next;
+	return bin;
+}
+
+void
+cpHashSetReserve(cpHashSet *set, int count)
+{
+	// Inserting the count'th element must neither resize the table nor run out of bins.
+	while(set->size <= (unsigned int)count) cpHashSetResize(set);
 	
-	if(bin){
-		set->pooledBins = bin->next;
-		return bin;
-	} else {
-		// Pool is exhausted, make more
-		int count = CP_BUFFER_BYTES/sizeof(cpHashSetBin);
-		cpAssertHard(count, "Internal Error: Buffer size is too small.");
-		
-		cpHashSetBin *buffer = (cpHashSetBin *)cpcalloc(1, CP_BUFFER_BYTES);
-		cpArrayPush(set->allocatedBuffers, buffer);
-		
-		// push all but the first one, return it instead
-		for(int i=1; i<count; i++) recycleBin(set, buffer + i);
-		return buffer;
+	int pooled = 0;
+	for(cpHashSetBin *bin = set->pooledBins; bin; bin = bin->next) pooled++;
+	
+	while(set->entries + pooled < (unsigned int)count){
+		growBinPool(set);
+		pooled += CP_BUFFER_BYTES/sizeof(cpHashSetBin);
 	}
 }
 
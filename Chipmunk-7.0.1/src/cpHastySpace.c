@@ -4,13 +4,24 @@
 #include <stdlib.h>
 #include <stdio.h>
 
+#include <stdint.h>
+#include <string.h>
 #include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
 //#include <sys/param.h >
+#ifdef __APPLE__
 #include <sys/sysctl.h>
+#endif
 
 #include "chipmunk/chipmunk_private.h"
 #include "chipmunk/cpHastySpace.h"
 
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
 
 //MARK: ARM NEON Solver
 
@@ -172,321 +183,1779 @@ cpArbiterApplyImpulse_NEON(cpArbiter *arb)
 
 #endif
 
-//MARK: PThreads
+//MARK: x86 SIMD Solver
 
-// Right now using more than 2 threads probably wont help your performance any.
-// If you are using a ridiculous number of iterations it could help though.
-#define MAX_THREADS 2
+// Structure of arrays copy of the colored arbiters, packed during the prestep.
+// Rows of one color share no dynamic bodies, so the solver runs 2 (SSE2) or 4 (AVX2) arbiters at a time.
+// The accumulated impulses stay here during the solve and are copied back to the contacts afterwards.
+struct ContactSlot {
+	cpFloat *r1x, *r1y, *r2x, *r2y;
+	cpFloat *nMass, *tMass, *bias, *bounce;
+	cpFloat *jBias, *jnAcc, *jtAcc;
+};
 
-struct ThreadContext {
-	pthread_t thread;
-	cpHastySpace *space;
-	unsigned long thread_num;
+struct ContactRows {
+	int capacity;
+	cpBody **a, **b;
+	int *count;
+	
+	cpFloat *data;
+	cpFloat *nx, *ny, *svx, *svy, *u;
+	struct ContactSlot slot[CP_MAX_CONTACTS_PER_ARBITER];
 };
 
-typedef	void (*cpHastySpaceWorkFunction)(cpSpace *space, unsigned long worker, unsigned long worker_count);
+typedef void (*ContactKernel)(struct ContactRows *rows, int begin, int end);
 
-struct cpHastySpace {
-	cpSpace space;
-	
-	// Number of worker threads (including the main thread)
-	unsigned long num_threads;
+// Pivot joints packed the same way, the prestep has already clamped their bias to maxBias.
+struct PivotRows {
+	int capacity;
+	cpBody **a, **b;
 	
-	// Number of worker threads currently executing. (also including the main thread)
-	unsigned long num_working;
-	
-	// Number of constraints (plus contacts) that must exist per step to start the worker threads.
-	unsigned long constraint_count_threshold;
-	
-	pthread_mutex_t mutex;
-	pthread_cond_t cond_work, cond_resume;
-	
-	// Work function to invoke.
-	cpHastySpaceWorkFunction work;
-	
-	struct ThreadContext workers[MAX_THREADS - 1];
+	cpFloat *data;
+	cpFloat *r1x, *r1y, *r2x, *r2y;
+	cpFloat *ka, *kb, *kc, *kd;
+	cpFloat *biasx, *biasy;
+	cpFloat *jx, *jy, *jMax;
 };
 
-static void *
-WorkerThreadLoop(struct ThreadContext *context)
+typedef void (*PivotKernel)(struct PivotRows *rows, int begin, int end);
+
+// Lanes of the widest kernel.
+#define SIMD_LANES 4
+
+// Replaces data with one block holding all of the arrays.
+static cpFloat *
+ResizeRowArrays(cpFloat *data, cpFloat **fields[], int count, int capacity)
 {
-	cpHastySpace *hasty = context->space;
+	// Offset the arrays by a cache line from a multiple of the page size so they don't alias in L1.
+	int stride = ((capacity + 511) & ~511) + 8;
 	
-	unsigned long thread = context->thread_num;
-	unsigned long num_threads = hasty->num_threads;
-	
-	for(;;){
-		pthread_mutex_lock(&hasty->mutex); {
-			if(--hasty->num_working == 0){
-				pthread_cond_signal(&hasty->cond_resume);
-			}
-			
-			pthread_cond_wait(&hasty->cond_work, &hasty->mutex);
-		} pthread_mutex_unlock(&hasty->mutex);
-		
-		cpHastySpaceWorkFunction func = hasty->work;
-		if(func){
-			hasty->work(&hasty->space, thread, num_threads);
-		} else {
-			break;
-		}
-	}
+	cpfree(data);
+	data = (cpFloat *)cpcalloc(count*stride, sizeof(cpFloat));
+	for(int i=0; i<count; i++) *fields[i] = data + i*stride;
 	
-	return NULL;
+	return data;
 }
 
 static void
-RunWorkers(cpHastySpace *hasty, cpHastySpaceWorkFunction func)
+ResizeContactRows(struct ContactRows *rows, int capacity)
 {
-	hasty->num_working = hasty->num_threads - 1;
-	hasty->work = func;
-	
-	if(hasty->num_working > 0){
-		pthread_mutex_lock(&hasty->mutex); {
-			pthread_cond_broadcast(&hasty->cond_work);
-		} pthread_mutex_unlock(&hasty->mutex);
-		
-		func((cpSpace *)hasty, 0, hasty->num_threads);
-			
-		pthread_mutex_lock(&hasty->mutex); {
-			if(hasty->num_working > 0){
-				pthread_cond_wait(&hasty->cond_resume, &hasty->mutex);
-			}
-		} pthread_mutex_unlock(&hasty->mutex);
-	} else {
-		func((cpSpace *)hasty, 0, hasty->num_threads);
+	cpFloat **fields[5 + 11*CP_MAX_CONTACTS_PER_ARBITER] = {&rows->nx, &rows->ny, &rows->svx, &rows->svy, &rows->u};
+	int count = 5;
+	for(int s=0; s<CP_MAX_CONTACTS_PER_ARBITER; s++){
+		struct ContactSlot *slot = rows->slot + s;
+		cpFloat **slotFields[] = {&slot->r1x, &slot->r1y, &slot->r2x, &slot->r2y, &slot->nMass, &slot->tMass, &slot->bias, &slot->bounce, &slot->jBias, &slot->jnAcc, &slot->jtAcc};
+		for(int i=0; i<11; i++) fields[count++] = slotFields[i];
 	}
 	
-	hasty->work = NULL;
+	rows->capacity = capacity;
+	rows->a = (cpBody **)cprealloc(rows->a, capacity*sizeof(cpBody *));
+	rows->b = (cpBody **)cprealloc(rows->b, capacity*sizeof(cpBody *));
+	rows->count = (int *)cprealloc(rows->count, capacity*sizeof(int));
+	rows->data = ResizeRowArrays(rows->data, fields, count, capacity);
 }
 
 static void
-Solver(cpSpace *space, unsigned long worker, unsigned long worker_count)
+ResizePivotRows(struct PivotRows *rows, int capacity)
 {
-	cpArray *constraints = space->constraints;
-	cpArray *arbiters = space->arbiters;
-	
-	cpFloat dt = space->curr_dt;
-	unsigned long iterations = (space->iterations + worker_count - 1)/worker_count;
+	cpFloat **fields[] = {&rows->r1x, &rows->r1y, &rows->r2x, &rows->r2y, &rows->ka, &rows->kb, &rows->kc, &rows->kd, &rows->biasx, &rows->biasy, &rows->jx, &rows->jy, &rows->jMax};
 	
-	for(unsigned long i=0; i<iterations; i++){
-		for(int j=0; j<arbiters->num; j++){
-			cpArbiter *arb = (cpArbiter *)arbiters->arr[j];
-			#ifdef __ARM_NEON__
-				cpArbiterApplyImpulse_NEON(arb);
-			#else
-				cpArbiterApplyImpulse(arb);
-			#endif
-		}
-			
-		for(int j=0; j<constraints->num; j++){
-			cpConstraint *constraint = (cpConstraint *)constraints->arr[j];
-			constraint->klass->applyImpulse(constraint, dt);
-		}
-	}
+	rows->capacity = capacity;
+	rows->a = (cpBody **)cprealloc(rows->a, capacity*sizeof(cpBody *));
+	rows->b = (cpBody **)cprealloc(rows->b, capacity*sizeof(cpBody *));
+	rows->data = ResizeRowArrays(rows->data, fields, sizeof(fields)/sizeof(*fields), capacity);
 }
 
-//MARK: Thread Management Functions
+static void
+FreeContactRows(struct ContactRows *rows)
+{
+	cpfree(rows->a);
+	cpfree(rows->b);
+	cpfree(rows->count);
+	cpfree(rows->data);
+}
 
 static void
-HaltThreads(cpHastySpace *hasty)
+FreePivotRows(struct PivotRows *rows)
+{
+	cpfree(rows->a);
+	cpfree(rows->b);
+	cpfree(rows->data);
+}
+
+static void
+PackContactRow(struct ContactRows *rows, int i, cpArbiter *arb)
 {
-	pthread_mutex_t *mutex = &hasty->mutex;
-	pthread_mutex_lock(mutex); {
-		hasty->work = NULL; // NULL work function means break and exit
-		pthread_cond_broadcast(&hasty->cond_work);
-	} pthread_mutex_unlock(mutex);
+	rows->a[i] = arb->body_a;
+	rows->b[i] = arb->body_b;
+	rows->count[i] = arb->count;
+	rows->nx[i] = arb->n.x; rows->ny[i] = arb->n.y;
+	rows->svx[i] = arb->surface_vr.x; rows->svy[i] = arb->surface_vr.y;
+	rows->u[i] = arb->u;
 	
-	for(unsigned long i=0; i<(hasty->num_threads-1); i++){
-		pthread_join(hasty->workers[i].thread, NULL);
+	for(int s=0; s<CP_MAX_CONTACTS_PER_ARBITER; s++){
+		struct ContactSlot *slot = rows->slot + s;
+		
+		// Unused slots are zeroed so the SIMD lanes that solve them stay finite.
+		struct cpContact empty = {}, *con = (s < arb->count ? arb->contacts + s : &empty);
+		slot->r1x[i] = con->r1.x; slot->r1y[i] = con->r1.y;
+		slot->r2x[i] = con->r2.x; slot->r2y[i] = con->r2.y;
+		slot->nMass[i] = con->nMass; slot->tMass[i] = con->tMass;
+		slot->bias[i] = con->bias; slot->bounce[i] = con->bounce;
+		slot->jBias[i] = con->jBias; slot->jnAcc[i] = con->jnAcc; slot->jtAcc[i] = con->jtAcc;
 	}
 }
 
-void
-cpHastySpaceSetThreads(cpSpace *space, unsigned long threads)
+static void
+UnpackContactRow(struct ContactRows *rows, int i, cpArbiter *arb)
 {
-#if TARGET_IPHONE_SIMULATOR == 1
-	// Individual values appear to be written non-atomically when compiled as debug for the simulator.
-	// No idea why, so threads are disabled.
-	threads = 1;
-#endif	
-	
-	cpHastySpace *hasty = (cpHastySpace *)space;
-	HaltThreads(hasty);
-	
-#ifdef __APPLE__
-	if(threads == 0){
-		size_t size = sizeof(threads);
-		sysctlbyname("hw.ncpu", &threads, &size, NULL, 0);
+	for(int s=0; s<arb->count; s++){
+		struct ContactSlot *slot = rows->slot + s;
+		struct cpContact *con = arb->contacts + s;
+		con->jBias = slot->jBias[i];
+		con->jnAcc = slot->jnAcc[i];
+		con->jtAcc = slot->jtAcc[i];
 	}
-#else
-	if(threads == 0) threads = 1;
-#endif
-	
-	hasty->num_threads = (threads < MAX_THREADS ? threads : MAX_THREADS);
-	hasty->num_working = hasty->num_threads - 1;
-	
-	// Create the worker threads and wait for them to signal ready.
-	if(hasty->num_working > 0){
-		pthread_mutex_lock(&hasty->mutex);
-		for(unsigned long i=0; i<(hasty->num_threads-1); i++){
-			hasty->workers[i].space = hasty;
-			hasty->workers[i].thread_num = i + 1;
+}
+
+// cpArbiterApplyImpulse() on a packed row.
+static void
+SolveContactsScalar(struct ContactRows *rows, int begin, int end)
+{
+	for(int i=begin; i<end; i++){
+		cpBody *a = rows->a[i];
+		cpBody *b = rows->b[i];
+		cpVect n = cpv(rows->nx[i], rows->ny[i]);
+		cpVect surface_vr = cpv(rows->svx[i], rows->svy[i]);
+		cpFloat friction = rows->u[i];
+		
+		for(int s=0; s<rows->count[i]; s++){
+			struct ContactSlot *slot = rows->slot + s;
+			cpFloat nMass = slot->nMass[i];
+			cpVect r1 = cpv(slot->r1x[i], slot->r1y[i]);
+			cpVect r2 = cpv(slot->r2x[i], slot->r2y[i]);
+			
+			cpVect vb1 = cpvadd(a->v_bias, cpvmult(cpvperp(r1), a->w_bias));
+			cpVect vb2 = cpvadd(b->v_bias, cpvmult(cpvperp(r2), b->w_bias));
+			cpVect vr = cpvadd(relative_velocity(a, b, r1, r2), surface_vr);
+			
+			cpFloat vbn = cpvdot(cpvsub(vb2, vb1), n);
+			cpFloat vrn = cpvdot(vr, n);
+			cpFloat vrt = cpvdot(vr, cpvperp(n));
 			
-			pthread_create(&hasty->workers[i].thread, NULL, (void *)WorkerThreadLoop, &hasty->workers[i]);
+			cpFloat jbn = (slot->bias[i] - vbn)*nMass;
+			cpFloat jbnOld = slot->jBias[i];
+			cpFloat jBias = slot->jBias[i] = cpfmax(jbnOld + jbn, 0.0f);
+			
+			cpFloat jn = -(slot->bounce[i] + vrn)*nMass;
+			cpFloat jnOld = slot->jnAcc[i];
+			cpFloat jnAcc = slot->jnAcc[i] = cpfmax(jnOld + jn, 0.0f);
+			
+			cpFloat jtMax = friction*jnAcc;
+			cpFloat jt = -vrt*slot->tMass[i];
+			cpFloat jtOld = slot->jtAcc[i];
+			cpFloat jtAcc = slot->jtAcc[i] = cpfclamp(jtOld + jt, -jtMax, jtMax);
+			
+			apply_bias_impulses(a, b, r1, r2, cpvmult(n, jBias - jbnOld));
+			apply_impulses(a, b, r1, r2, cpvrotate(n, cpv(jnAcc - jnOld, jtAcc - jtOld)));
 		}
-		
-		pthread_cond_wait(&hasty->cond_resume, &hasty->mutex);
-		pthread_mutex_unlock(&hasty->mutex);
 	}
 }
 
-unsigned long
-cpHastySpaceGetThreads(cpSpace *space)
+static void
+PackPivotRow(struct PivotRows *rows, int i, cpPivotJoint *joint, cpFloat dt)
 {
-	return ((cpHastySpace *)space)->num_threads;
+	rows->a[i] = joint->constraint.a;
+	rows->b[i] = joint->constraint.b;
+	rows->r1x[i] = joint->r1.x; rows->r1y[i] = joint->r1.y;
+	rows->r2x[i] = joint->r2.x; rows->r2y[i] = joint->r2.y;
+	rows->ka[i] = joint->k.a; rows->kb[i] = joint->k.b;
+	rows->kc[i] = joint->k.c; rows->kd[i] = joint->k.d;
+	rows->biasx[i] = joint->bias.x; rows->biasy[i] = joint->bias.y;
+	rows->jx[i] = joint->jAcc.x; rows->jy[i] = joint->jAcc.y;
+	rows->jMax[i] = joint->constraint.maxForce*dt;
 }
 
-//MARK: Overriden cpSpace Functions.
-
-cpSpace *
-cpHastySpaceNew(void)
+static void
+UnpackPivotRow(struct PivotRows *rows, int i, cpPivotJoint *joint)
 {
-	cpHastySpace *hasty = (cpHastySpace *)cpcalloc(1, sizeof(cpHastySpace));
-	cpSpaceInit((cpSpace *)hasty);
-	
-	pthread_mutex_init(&hasty->mutex, NULL);
-	pthread_cond_init(&hasty->cond_work, NULL);
-	pthread_cond_init(&hasty->cond_resume, NULL);
-	
-	// TODO magic number, should test this more thoroughly.
-	hasty->constraint_count_threshold = 50;
-	
-	// Default to 1 thread for determinism.
-	hasty->num_threads = 1;
-	cpHastySpaceSetThreads((cpSpace *)hasty, 1);
+	joint->jAcc = cpv(rows->jx[i], rows->jy[i]);
+}
 
-	return (cpSpace *)hasty;
+// The applyImpulse() of cpPivotJoint.c on a packed row.
+static void
+SolvePivotsScalar(struct PivotRows *rows, int begin, int end)
+{
+	for(int i=begin; i<end; i++){
+		cpBody *a = rows->a[i];
+		cpBody *b = rows->b[i];
+		cpVect r1 = cpv(rows->r1x[i], rows->r1y[i]);
+		cpVect r2 = cpv(rows->r2x[i], rows->r2y[i]);
+		cpMat2x2 k = cpMat2x2New(rows->ka[i], rows->kb[i], rows->kc[i], rows->kd[i]);
+		
+		// compute relative velocity
+		cpVect vr = relative_velocity(a, b, r1, r2);
+		
+		// compute normal impulse
+		cpVect j = cpMat2x2Transform(k, cpvsub(cpv(rows->biasx[i], rows->biasy[i]), vr));
+		cpVect jOld = cpv(rows->jx[i], rows->jy[i]);
+		cpVect jAcc = cpvclamp(cpvadd(jOld, j), rows->jMax[i]);
+		rows->jx[i] = jAcc.x; rows->jy[i] = jAcc.y;
+		
+		// apply impulse
+		apply_impulses(a, b, r1, r2, cpvsub(jAcc, jOld));
+	}
 }
 
-void
-cpHastySpaceFree(cpSpace *space)
+#if CP_USE_DOUBLES && defined(__SSE2__)
+
+// The kernels below do the same operations in the same order as the scalar ones, a lane per row.
+// A lane's second contact is blended away when its arbiter only has one.
+
+#define GATHER2(__bodies, __field) _mm_set_pd(__bodies[1]->__field, __bodies[0]->__field)
+#define SCATTER2(__bodies, __field, __v) {cpFloat __t[2]; _mm_storeu_pd(__t, __v); __bodies[0]->__field = __t[0]; __bodies[1]->__field = __t[1];}
+#define BLEND2(__mask, __new, __old) _mm_or_pd(_mm_and_pd(__mask, __new), _mm_andnot_pd(__mask, __old))
+
+static void
+SolveContactsSSE2(struct ContactRows *rows, int begin, int end)
 {
-	cpHastySpace *hasty = (cpHastySpace *)space;
-	
-	HaltThreads(hasty);
+	const __m128d zero = _mm_setzero_pd(), sign = _mm_set1_pd(-0.0);
 	
-	pthread_mutex_destroy(&hasty->mutex);
-	pthread_cond_destroy(&hasty->cond_work);
-	pthread_cond_destroy(&hasty->cond_resume);
+	int i = begin;
+	for(; i + 2 <= end; i += 2){
+		cpBody **A = rows->a + i, **B = rows->b + i;
+		__m128d nx = _mm_loadu_pd(rows->nx + i), ny = _mm_loadu_pd(rows->ny + i);
+		__m128d svx = _mm_loadu_pd(rows->svx + i), svy = _mm_loadu_pd(rows->svy + i);
+		__m128d u = _mm_loadu_pd(rows->u + i);
+		
+		__m128d avx = GATHER2(A, v.x), avy = GATHER2(A, v.y), aw = GATHER2(A, w);
+		__m128d abx = GATHER2(A, v_bias.x), aby = GATHER2(A, v_bias.y), abw = GATHER2(A, w_bias);
+		__m128d am = GATHER2(A, m_inv), ai = GATHER2(A, i_inv);
+		__m128d bvx = GATHER2(B, v.x), bvy = GATHER2(B, v.y), bw = GATHER2(B, w);
+		__m128d bbx = GATHER2(B, v_bias.x), bby = GATHER2(B, v_bias.y), bbw = GATHER2(B, w_bias);
+		__m128d bm = GATHER2(B, m_inv), bi = GATHER2(B, i_inv);
+		
+		__m128d counts = _mm_cvtepi32_pd(_mm_loadl_epi64((__m128i *)(rows->count + i)));
+		
+		for(int s=0; s<CP_MAX_CONTACTS_PER_ARBITER; s++){
+			__m128d mask = _mm_cmpgt_pd(counts, _mm_set1_pd(s));
+			if(_mm_movemask_pd(mask) == 0) break;
+			
+			struct ContactSlot *slot = rows->slot + s;
+			__m128d r1x = _mm_loadu_pd(slot->r1x + i), r1y = _mm_loadu_pd(slot->r1y + i);
+			__m128d r2x = _mm_loadu_pd(slot->r2x + i), r2y = _mm_loadu_pd(slot->r2y + i);
+			__m128d nMass = _mm_loadu_pd(slot->nMass + i);
+			
+			__m128d vb1x = _mm_add_pd(abx, _mm_mul_pd(_mm_xor_pd(r1y, sign), abw)), vb1y = _mm_add_pd(aby, _mm_mul_pd(r1x, abw));
+			__m128d vb2x = _mm_add_pd(bbx, _mm_mul_pd(_mm_xor_pd(r2y, sign), bbw)), vb2y = _mm_add_pd(bby, _mm_mul_pd(r2x, bbw));
+			__m128d v1x = _mm_add_pd(avx, _mm_mul_pd(_mm_xor_pd(r1y, sign), aw)), v1y = _mm_add_pd(avy, _mm_mul_pd(r1x, aw));
+			__m128d v2x = _mm_add_pd(bvx, _mm_mul_pd(_mm_xor_pd(r2y, sign), bw)), v2y = _mm_add_pd(bvy, _mm_mul_pd(r2x, bw));
+			__m128d vrx = _mm_add_pd(_mm_sub_pd(v2x, v1x), svx), vry = _mm_add_pd(_mm_sub_pd(v2y, v1y), svy);
+			
+			__m128d vbn = _mm_add_pd(_mm_mul_pd(_mm_sub_pd(vb2x, vb1x), nx), _mm_mul_pd(_mm_sub_pd(vb2y, vb1y), ny));
+			__m128d vrn = _mm_add_pd(_mm_mul_pd(vrx, nx), _mm_mul_pd(vry, ny));
+			__m128d vrt = _mm_add_pd(_mm_mul_pd(vrx, _mm_xor_pd(ny, sign)), _mm_mul_pd(vry, nx));
+			
+			__m128d jbn = _mm_mul_pd(_mm_sub_pd(_mm_loadu_pd(slot->bias + i), vbn), nMass);
+			__m128d jbnOld = _mm_loadu_pd(slot->jBias + i);
+			__m128d jBias = _mm_max_pd(_mm_add_pd(jbnOld, jbn), zero);
+			
+			__m128d jn = _mm_mul_pd(_mm_xor_pd(_mm_add_pd(_mm_loadu_pd(slot->bounce + i), vrn), sign), nMass);
+			__m128d jnOld = _mm_loadu_pd(slot->jnAcc + i);
+			__m128d jnAcc = _mm_max_pd(_mm_add_pd(jnOld, jn), zero);
+			
+			__m128d jtMax = _mm_mul_pd(u, jnAcc);
+			__m128d jt = _mm_mul_pd(_mm_xor_pd(vrt, sign), _mm_loadu_pd(slot->tMass + i));
+			__m128d jtOld = _mm_loadu_pd(slot->jtAcc + i);
+			__m128d jtAcc = _mm_min_pd(_mm_max_pd(_mm_add_pd(jtOld, jt), _mm_xor_pd(jtMax, sign)), jtMax);
+			
+			_mm_storeu_pd(slot->jBias + i, jBias);
+			_mm_storeu_pd(slot->jnAcc + i, jnAcc);
+			_mm_storeu_pd(slot->jtAcc + i, jtAcc);
+			
+			__m128d jbA = _mm_sub_pd(jBias, jbnOld);
+			__m128d jbx = _mm_mul_pd(nx, jbA), jby = _mm_mul_pd(ny, jbA);
+			__m128d njbx = _mm_xor_pd(jbx, sign), njby = _mm_xor_pd(jby, sign);
+			
+			__m128d jnA = _mm_sub_pd(jnAcc, jnOld), jtA = _mm_sub_pd(jtAcc, jtOld);
+			__m128d jx = _mm_sub_pd(_mm_mul_pd(nx, jnA), _mm_mul_pd(ny, jtA));
+			__m128d jy = _mm_add_pd(_mm_mul_pd(nx, jtA), _mm_mul_pd(ny, jnA));
+			__m128d njx = _mm_xor_pd(jx, sign), njy = _mm_xor_pd(jy, sign);
+			
+			abx = BLEND2(mask, _mm_add_pd(abx, _mm_mul_pd(njbx, am)), abx);
+			aby = BLEND2(mask, _mm_add_pd(aby, _mm_mul_pd(njby, am)), aby);
+			abw = BLEND2(mask, _mm_add_pd(abw, _mm_mul_pd(ai, _mm_sub_pd(_mm_mul_pd(r1x, njby), _mm_mul_pd(r1y, njbx)))), abw);
+			bbx = BLEND2(mask, _mm_add_pd(bbx, _mm_mul_pd(jbx, bm)), bbx);
+			bby = BLEND2(mask, _mm_add_pd(bby, _mm_mul_pd(jby, bm)), bby);
+			bbw = BLEND2(mask, _mm_add_pd(bbw, _mm_mul_pd(bi, _mm_sub_pd(_mm_mul_pd(r2x, jby), _mm_mul_pd(r2y, jbx)))), bbw);
+			
+			avx = BLEND2(mask, _mm_add_pd(avx, _mm_mul_pd(njx, am)), avx);
+			avy = BLEND2(mask, _mm_add_pd(avy, _mm_mul_pd(njy, am)), avy);
+			aw = BLEND2(mask, _mm_add_pd(aw, _mm_mul_pd(ai, _mm_sub_pd(_mm_mul_pd(r1x, njy), _mm_mul_pd(r1y, njx)))), aw);
+			bvx = BLEND2(mask, _mm_add_pd(bvx, _mm_mul_pd(jx, bm)), bvx);
+			bvy = BLEND2(mask, _mm_add_pd(bvy, _mm_mul_pd(jy, bm)), bvy);
+			bw = BLEND2(mask, _mm_add_pd(bw, _mm_mul_pd(bi, _mm_sub_pd(_mm_mul_pd(r2x, jy), _mm_mul_pd(r2y, jx)))), bw);
+		}
+		
+		SCATTER2(A, v_bias.x, abx); SCATTER2(A, v_bias.y, aby); SCATTER2(A, w_bias, abw);
+		SCATTER2(B, v_bias.x, bbx); SCATTER2(B, v_bias.y, bby); SCATTER2(B, w_bias, bbw);
+		SCATTER2(A, v.x, avx); SCATTER2(A, v.y, avy); SCATTER2(A, w, aw);
+		SCATTER2(B, v.x, bvx); SCATTER2(B, v.y, bvy); SCATTER2(B, w, bw);
+	}
 	
-	cpSpaceFree(space);
+	SolveContactsScalar(rows, i, end);
 }
 
-void
-cpHastySpaceStep(cpSpace *space, cpFloat dt)
+#define GATHER4(__bodies, __field) _mm256_set_pd(__bodies[3]->__field, __bodies[2]->__field, __bodies[1]->__field, __bodies[0]->__field)
+#define SCATTER4(__bodies, __field, __v) {cpFloat __t[4]; _mm256_storeu_pd(__t, __v); for(int __l=0; __l<4; __l++) __bodies[__l]->__field = __t[__l];}
+
+__attribute__((target("avx2"))) static void
+SolveContactsAVX2(struct ContactRows *rows, int begin, int end)
 {
-	// don't step if the timestep is 0!
-	if(dt == 0.0f) return;
-	
-	space->stamp++;
+	const __m256d zero = _mm256_setzero_pd(), sign = _mm256_set1_pd(-0.0);
 	
-	cpFloat prev_dt = space->curr_dt;
-	space->curr_dt = dt;
+	int i = begin;
+	for(; i + 4 <= end; i += 4){
+		cpBody **A = rows->a + i, **B = rows->b + i;
+		__m256d nx = _mm256_loadu_pd(rows->nx + i), ny = _mm256_loadu_pd(rows->ny + i);
+		__m256d svx = _mm256_loadu_pd(rows->svx + i), svy = _mm256_loadu_pd(rows->svy + i);
+		__m256d u = _mm256_loadu_pd(rows->u + i);
 		
-	cpArray *bodies = space->dynamicBodies;
-	cpArray *constraints = space->constraints;
-	cpArray *arbiters = space->arbiters;
-	
-	// Reset and empty the arbiter list.
-	for(int i=0; i<arbiters->num; i++){
-		cpArbiter *arb = (cpArbiter *)arbiters->arr[i];
-		arb->state = CP_ARBITER_STATE_NORMAL;
+		__m256d avx = GATHER4(A, v.x), avy = GATHER4(A, v.y), aw = GATHER4(A, w);
+		__m256d abx = GATHER4(A, v_bias.x), aby = GATHER4(A, v_bias.y), abw = GATHER4(A, w_bias);
+		__m256d am = GATHER4(A, m_inv), ai = GATHER4(A, i_inv);
+		__m256d bvx = GATHER4(B, v.x), bvy = GATHER4(B, v.y), bw = GATHER4(B, w);
+		__m256d bbx = GATHER4(B, v_bias.x), bby = GATHER4(B, v_bias.y), bbw = GATHER4(B, w_bias);
+		__m256d bm = GATHER4(B, m_inv), bi = GATHER4(B, i_inv);
 		
-		// If both bodies are awake, unthread the arbiter from the contact graph.
-		if(!cpBodyIsSleeping(arb->body_a) && !cpBodyIsSleeping(arb->body_b)){
-			cpArbiterUnthread(arb);
+		__m256d counts = _mm256_cvtepi32_pd(_mm_loadu_si128((__m128i *)(rows->count + i)));
+		
+		for(int s=0; s<CP_MAX_CONTACTS_PER_ARBITER; s++){
+			__m256d mask = _mm256_cmp_pd(counts, _mm256_set1_pd(s), _CMP_GT_OQ);
+			if(_mm256_movemask_pd(mask) == 0) break;
+			
+			struct ContactSlot *slot = rows->slot + s;
+			__m256d r1x = _mm256_loadu_pd(slot->r1x + i), r1y = _mm256_loadu_pd(slot->r1y + i);
+			__m256d r2x = _mm256_loadu_pd(slot->r2x + i), r2y = _mm256_loadu_pd(slot->r2y + i);
+			__m256d nMass = _mm256_loadu_pd(slot->nMass + i);
+			
+			__m256d vb1x = _mm256_add_pd(abx, _mm256_mul_pd(_mm256_xor_pd(r1y, sign), abw)), vb1y = _mm256_add_pd(aby, _mm256_mul_pd(r1x, abw));
+			__m256d vb2x = _mm256_add_pd(bbx, _mm256_mul_pd(_mm256_xor_pd(r2y, sign), bbw)), vb2y = _mm256_add_pd(bby, _mm256_mul_pd(r2x, bbw));
+			__m256d v1x = _mm256_add_pd(avx, _mm256_mul_pd(_mm256_xor_pd(r1y, sign), aw)), v1y = _mm256_add_pd(avy, _mm256_mul_pd(r1x, aw));
+			__m256d v2x = _mm256_add_pd(bvx, _mm256_mul_pd(_mm256_xor_pd(r2y, sign), bw)), v2y = _mm256_add_pd(bvy, _mm256_mul_pd(r2x, bw));
+			__m256d vrx = _mm256_add_pd(_mm256_sub_pd(v2x, v1x), svx), vry = _mm256_add_pd(_mm256_sub_pd(v2y, v1y), svy);
+			
+			__m256d vbn = _mm256_add_pd(_mm256_mul_pd(_mm256_sub_pd(vb2x, vb1x), nx), _mm256_mul_pd(_mm256_sub_pd(vb2y, vb1y), ny));
+			__m256d vrn = _mm256_add_pd(_mm256_mul_pd(vrx, nx), _mm256_mul_pd(vry, ny));
+			__m256d vrt = _mm256_add_pd(_mm256_mul_pd(vrx, _mm256_xor_pd(ny, sign)), _mm256_mul_pd(vry, nx));
+			
+			__m256d jbn = _mm256_mul_pd(_mm256_sub_pd(_mm256_loadu_pd(slot->bias + i), vbn), nMass);
+			__m256d jbnOld = _mm256_loadu_pd(slot->jBias + i);
+			__m256d jBias = _mm256_max_pd(_mm256_add_pd(jbnOld, jbn), zero);
+			
+			__m256d jn = _mm256_mul_pd(_mm256_xor_pd(_mm256_add_pd(_mm256_loadu_pd(slot->bounce + i), vrn), sign), nMass);
+			__m256d jnOld = _mm256_loadu_pd(slot->jnAcc + i);
+			__m256d jnAcc = _mm256_max_pd(_mm256_add_pd(jnOld, jn), zero);
+			
+			__m256d jtMax = _mm256_mul_pd(u, jnAcc);
+			__m256d jt = _mm256_mul_pd(_mm256_xor_pd(vrt, sign), _mm256_loadu_pd(slot->tMass + i));
+			__m256d jtOld = _mm256_loadu_pd(slot->jtAcc + i);
+			__m256d jtAcc = _mm256_min_pd(_mm256_max_pd(_mm256_add_pd(jtOld, jt), _mm256_xor_pd(jtMax, sign)), jtMax);
+			
+			_mm256_storeu_pd(slot->jBias + i, jBias);
+			_mm256_storeu_pd(slot->jnAcc + i, jnAcc);
+			_mm256_storeu_pd(slot->jtAcc + i, jtAcc);
+			
+			__m256d jbA = _mm256_sub_pd(jBias, jbnOld);
+			__m256d jbx = _mm256_mul_pd(nx, jbA), jby = _mm256_mul_pd(ny, jbA);
+			__m256d njbx = _mm256_xor_pd(jbx, sign), njby = _mm256_xor_pd(jby, sign);
+			
+			__m256d jnA = _mm256_sub_pd(jnAcc, jnOld), jtA = _mm256_sub_pd(jtAcc, jtOld);
+			__m256d jx = _mm256_sub_pd(_mm256_mul_pd(nx, jnA), _mm256_mul_pd(ny, jtA));
+			__m256d jy = _mm256_add_pd(_mm256_mul_pd(nx, jtA), _mm256_mul_pd(ny, jnA));
+			__m256d njx = _mm256_xor_pd(jx, sign), njy = _mm256_xor_pd(jy, sign);
+			
+			abx = _mm256_blendv_pd(abx, _mm256_add_pd(abx, _mm256_mul_pd(njbx, am)), mask);
+			aby = _mm256_blendv_pd(aby, _mm256_add_pd(aby, _mm256_mul_pd(njby, am)), mask);
+			abw = _mm256_blendv_pd(abw, _mm256_add_pd(abw, _mm256_mul_pd(ai, _mm256_sub_pd(_mm256_mul_pd(r1x, njby), _mm256_mul_pd(r1y, njbx)))), mask);
+			bbx = _mm256_blendv_pd(bbx, _mm256_add_pd(bbx, _mm256_mul_pd(jbx, bm)), mask);
+			bby = _mm256_blendv_pd(bby, _mm256_add_pd(bby, _mm256_mul_pd(jby, bm)), mask);
+			bbw = _mm256_blendv_pd(bbw, _mm256_add_pd(bbw, _mm256_mul_pd(bi, _mm256_sub_pd(_mm256_mul_pd(r2x, jby), _mm256_mul_pd(r2y, jbx)))), mask);
+			
+			avx = _mm256_blendv_pd(avx, _mm256_add_pd(avx, _mm256_mul_pd(njx, am)), mask);
+			avy = _mm256_blendv_pd(avy, _mm256_add_pd(avy, _mm256_mul_pd(njy, am)), mask);
+			aw = _mm256_blendv_pd(aw, _mm256_add_pd(aw, _mm256_mul_pd(ai, _mm256_sub_pd(_mm256_mul_pd(r1x, njy), _mm256_mul_pd(r1y, njx)))), mask);
+			bvx = _mm256_blendv_pd(bvx, _mm256_add_pd(bvx, _mm256_mul_pd(jx, bm)), mask);
+			bvy = _mm256_blendv_pd(bvy, _mm256_add_pd(bvy, _mm256_mul_pd(jy, bm)), mask);
+			bw = _mm256_blendv_pd(bw, _mm256_add_pd(bw, _mm256_mul_pd(bi, _mm256_sub_pd(_mm256_mul_pd(r2x, jy), _mm256_mul_pd(r2y, jx)))), mask);
 		}
+		
+		SCATTER4(A, v_bias.x, abx); SCATTER4(A, v_bias.y, aby); SCATTER4(A, w_bias, abw);
+		SCATTER4(B, v_bias.x, bbx); SCATTER4(B, v_bias.y, bby); SCATTER4(B, w_bias, bbw);
+		SCATTER4(A, v.x, avx); SCATTER4(A, v.y, avy); SCATTER4(A, w, aw);
+		SCATTER4(B, v.x, bvx); SCATTER4(B, v.y, bvy); SCATTER4(B, w, bw);
 	}
-	arbiters->num = 0;
+	
+	// The remainder runs legacy SSE code, avoid the transition penalty.
+	_mm256_zeroupper();
+	SolveContactsSSE2(rows, i, end);
+}
 
-	cpSpaceLock(space); {
-		// Integrate positions
-		for(int i=0; i<bodies->num; i++){
-			cpBody *body = (cpBody *)bodies->arr[i];
-			body->position_func(body, dt);
-		}
-		
-		// Find colliding pairs.
-		cpSpacePushFreshContactBuffer(space);
-		cpSpatialIndexEach(space->dynamicShapes, (cpSpatialIndexIteratorFunc)cpShapeUpdateFunc, NULL);
-		cpSpatialIndexReindexQuery(space->dynamicShapes, (cpSpatialIndexQueryFunc)cpSpaceCollideShapes, space);
-	} cpSpaceUnlock(space, cpFalse);
+static void
+SolvePivotsSSE2(struct PivotRows *rows, int begin, int end)
+{
+	const __m128d sign = _mm_set1_pd(-0.0), min = _mm_set1_pd(CPFLOAT_MIN);
 	
-	// Rebuild the contact graph (and detect sleeping components if sleeping is enabled)
-	cpSpaceProcessComponents(space, dt);
+	int i = begin;
+	for(; i + 2 <= end; i += 2){
+		cpBody **A = rows->a + i, **B = rows->b + i;
+		__m128d avx = GATHER2(A, v.x), avy = GATHER2(A, v.y), aw = GATHER2(A, w);
+		__m128d am = GATHER2(A, m_inv), ai = GATHER2(A, i_inv);
+		__m128d bvx = GATHER2(B, v.x), bvy = GATHER2(B, v.y), bw = GATHER2(B, w);
+		__m128d bm = GATHER2(B, m_inv), bi = GATHER2(B, i_inv);
+		
+		__m128d r1x = _mm_loadu_pd(rows->r1x + i), r1y = _mm_loadu_pd(rows->r1y + i);
+		__m128d r2x = _mm_loadu_pd(rows->r2x + i), r2y = _mm_loadu_pd(rows->r2y + i);
+		
+		__m128d v1x = _mm_add_pd(avx, _mm_mul_pd(_mm_xor_pd(r1y, sign), aw)), v1y = _mm_add_pd(avy, _mm_mul_pd(r1x, aw));
+		__m128d v2x = _mm_add_pd(bvx, _mm_mul_pd(_mm_xor_pd(r2y, sign), bw)), v2y = _mm_add_pd(bvy, _mm_mul_pd(r2x, bw));
+		__m128d dx = _mm_sub_pd(_mm_loadu_pd(rows->biasx + i), _mm_sub_pd(v2x, v1x));
+		__m128d dy = _mm_sub_pd(_mm_loadu_pd(rows->biasy + i), _mm_sub_pd(v2y, v1y));
+		
+		__m128d jx = _mm_add_pd(_mm_mul_pd(dx, _mm_loadu_pd(rows->ka + i)), _mm_mul_pd(dy, _mm_loadu_pd(rows->kb + i)));
+		__m128d jy = _mm_add_pd(_mm_mul_pd(dx, _mm_loadu_pd(rows->kc + i)), _mm_mul_pd(dy, _mm_loadu_pd(rows->kd + i)));
+		__m128d jOldx = _mm_loadu_pd(rows->jx + i), jOldy = _mm_loadu_pd(rows->jy + i);
+		__m128d sx = _mm_add_pd(jOldx, jx), sy = _mm_add_pd(jOldy, jy);
+		
+		// cpvclamp() to the max impulse.
+		__m128d jMax = _mm_loadu_pd(rows->jMax + i);
+		__m128d dot = _mm_add_pd(_mm_mul_pd(sx, sx), _mm_mul_pd(sy, sy));
+		__m128d mask = _mm_cmpgt_pd(dot, _mm_mul_pd(jMax, jMax));
+		__m128d inv = _mm_div_pd(_mm_set1_pd(1.0), _mm_add_pd(_mm_sqrt_pd(dot), min));
+		__m128d jAccx = BLEND2(mask, _mm_mul_pd(_mm_mul_pd(sx, inv), jMax), sx);
+		__m128d jAccy = BLEND2(mask, _mm_mul_pd(_mm_mul_pd(sy, inv), jMax), sy);
+		_mm_storeu_pd(rows->jx + i, jAccx);
+		_mm_storeu_pd(rows->jy + i, jAccy);
+		
+		jx = _mm_sub_pd(jAccx, jOldx), jy = _mm_sub_pd(jAccy, jOldy);
+		__m128d njx = _mm_xor_pd(jx, sign), njy = _mm_xor_pd(jy, sign);
+		
+		avx = _mm_add_pd(avx, _mm_mul_pd(njx, am));
+		avy = _mm_add_pd(avy, _mm_mul_pd(njy, am));
+		aw = _mm_add_pd(aw, _mm_mul_pd(ai, _mm_sub_pd(_mm_mul_pd(r1x, njy), _mm_mul_pd(r1y, njx))));
+		bvx = _mm_add_pd(bvx, _mm_mul_pd(jx, bm));
+		bvy = _mm_add_pd(bvy, _mm_mul_pd(jy, bm));
+		bw = _mm_add_pd(bw, _mm_mul_pd(bi, _mm_sub_pd(_mm_mul_pd(r2x, jy), _mm_mul_pd(r2y, jx))));
+		
+		SCATTER2(A, v.x, avx); SCATTER2(A, v.y, avy); SCATTER2(A, w, aw);
+		SCATTER2(B, v.x, bvx); SCATTER2(B, v.y, bvy); SCATTER2(B, w, bw);
+	}
 	
-	cpSpaceLock(space); {
-		// Clear out old cached arbiters and call separate callbacks
-		cpHashSetFilter(space->cachedArbiters, (cpHashSetFilterFunc)cpSpaceArbiterSetFilter, space);
-
-		// Prestep the arbiters and constraints.
-		cpFloat slop = space->collisionSlop;
-		cpFloat biasCoef = 1.0f - cpfpow(space->collisionBias, dt);
-		for(int i=0; i<arbiters->num; i++){
-			cpArbiterPreStep((cpArbiter *)arbiters->arr[i], dt, slop, biasCoef);
-		}
+	SolvePivotsScalar(rows, i, end);
+}
 
-		for(int i=0; i<constraints->num; i++){
-			cpConstraint *constraint = (cpConstraint *)constraints->arr[i];
-			
-			cpConstraintPreSolveFunc preSolve = constraint->preSolve;
-			if(preSolve) preSolve(constraint, space);
-			
-			constraint->klass->preStep(constraint, dt);
-		}
+__attribute__((target("avx2"))) static void
+SolvePivotsAVX2(struct PivotRows *rows, int begin, int end)
+{
+	const __m256d sign = _mm256_set1_pd(-0.0), min = _mm256_set1_pd(CPFLOAT_MIN);
 	
-		// Integrate velocities.
-		cpFloat damping = cpfpow(space->damping, dt);
-		cpVect gravity = space->gravity;
-		for(int i=0; i<bodies->num; i++){
-			cpBody *body = (cpBody *)bodies->arr[i];
-			body->velocity_func(body, gravity, damping, dt);
-		}
+	int i = begin;
+	for(; i + 4 <= end; i += 4){
+		cpBody **A = rows->a + i, **B = rows->b + i;
+		__m256d avx = GATHER4(A, v.x), avy = GATHER4(A, v.y), aw = GATHER4(A, w);
+		__m256d am = GATHER4(A, m_inv), ai = GATHER4(A, i_inv);
+		__m256d bvx = GATHER4(B, v.x), bvy = GATHER4(B, v.y), bw = GATHER4(B, w);
+		__m256d bm = GATHER4(B, m_inv), bi = GATHER4(B, i_inv);
 		
-		// Apply cached impulses
-		cpFloat dt_coef = (prev_dt == 0.0f ? 0.0f : dt/prev_dt);
-		for(int i=0; i<arbiters->num; i++){
-			cpArbiterApplyCachedImpulse((cpArbiter *)arbiters->arr[i], dt_coef);
-		}
+		__m256d r1x = _mm256_loadu_pd(rows->r1x + i), r1y = _mm256_loadu_pd(rows->r1y + i);
+		__m256d r2x = _mm256_loadu_pd(rows->r2x + i), r2y = _mm256_loadu_pd(rows->r2y + i);
 		
-		for(int i=0; i<constraints->num; i++){
-			cpConstraint *constraint = (cpConstraint *)constraints->arr[i];
-			constraint->klass->applyCachedImpulse(constraint, dt_coef);
-		}
+		__m256d v1x = _mm256_add_pd(avx, _mm256_mul_pd(_mm256_xor_pd(r1y, sign), aw)), v1y = _mm256_add_pd(avy, _mm256_mul_pd(r1x, aw));
+		__m256d v2x = _mm256_add_pd(bvx, _mm256_mul_pd(_mm256_xor_pd(r2y, sign), bw)), v2y = _mm256_add_pd(bvy, _mm256_mul_pd(r2x, bw));
+		__m256d dx = _mm256_sub_pd(_mm256_loadu_pd(rows->biasx + i), _mm256_sub_pd(v2x, v1x));
+		__m256d dy = _mm256_sub_pd(_mm256_loadu_pd(rows->biasy + i), _mm256_sub_pd(v2y, v1y));
 		
-		// Run the impulse solver.
-		cpHastySpace *hasty = (cpHastySpace *)space;
-		if((unsigned long)(arbiters->num + constraints->num) > hasty->constraint_count_threshold){
-			RunWorkers(hasty, Solver);
-		} else {
-			Solver(space, 0, 1);
-		}
+		__m256d jx = _mm256_add_pd(_mm256_mul_pd(dx, _mm256_loadu_pd(rows->ka + i)), _mm256_mul_pd(dy, _mm256_loadu_pd(rows->kb + i)));
+		__m256d jy = _mm256_add_pd(_mm256_mul_pd(dx, _mm256_loadu_pd(rows->kc + i)), _mm256_mul_pd(dy, _mm256_loadu_pd(rows->kd + i)));
+		__m256d jOldx = _mm256_loadu_pd(rows->jx + i), jOldy = _mm256_loadu_pd(rows->jy + i);
+		__m256d sx = _mm256_add_pd(jOldx, jx), sy = _mm256_add_pd(jOldy, jy);
 		
-		// Run the constraint post-solve callbacks
-		for(int i=0; i<constraints->num; i++){
-			cpConstraint *constraint = (cpConstraint *)constraints->arr[i];
-			
-			cpConstraintPostSolveFunc postSolve = constraint->postSolve;
-			if(postSolve) postSolve(constraint, space);
-		}
+		// cpvclamp() to the max impulse.
+		__m256d jMax = _mm256_loadu_pd(rows->jMax + i);
+		__m256d dot = _mm256_add_pd(_mm256_mul_pd(sx, sx), _mm256_mul_pd(sy, sy));
+		__m256d mask = _mm256_cmp_pd(dot, _mm256_mul_pd(jMax, jMax), _CMP_GT_OQ);
+		__m256d inv = _mm256_div_pd(_mm256_set1_pd(1.0), _mm256_add_pd(_mm256_sqrt_pd(dot), min));
+		__m256d jAccx = _mm256_blendv_pd(sx, _mm256_mul_pd(_mm256_mul_pd(sx, inv), jMax), mask);
+		__m256d jAccy = _mm256_blendv_pd(sy, _mm256_mul_pd(_mm256_mul_pd(sy, inv), jMax), mask);
+		_mm256_storeu_pd(rows->jx + i, jAccx);
+		_mm256_storeu_pd(rows->jy + i, jAccy);
 		
-		// run the post-solve callbacks
-		for(int i=0; i<arbiters->num; i++){
-			cpArbiter *arb = (cpArbiter *) arbiters->arr[i];
-			
-			cpCollisionHandler *handler = arb->handler;
-			handler->postSolveFunc(arb, space, handler->userData);
-		}
+		jx = _mm256_sub_pd(jAccx, jOldx), jy = _mm256_sub_pd(jAccy, jOldy);
+		__m256d njx = _mm256_xor_pd(jx, sign), njy = _mm256_xor_pd(jy, sign);
+		
+		avx = _mm256_add_pd(avx, _mm256_mul_pd(njx, am));
+		avy = _mm256_add_pd(avy, _mm256_mul_pd(njy, am));
+		aw = _mm256_add_pd(aw, _mm256_mul_pd(ai, _mm256_sub_pd(_mm256_mul_pd(r1x, njy), _mm256_mul_pd(r1y, njx))));
+		bvx = _mm256_add_pd(bvx, _mm256_mul_pd(jx, bm));
+		bvy = _mm256_add_pd(bvy, _mm256_mul_pd(jy, bm));
+		bw = _mm256_add_pd(bw, _mm256_mul_pd(bi, _mm256_sub_pd(_mm256_mul_pd(r2x, jy), _mm256_mul_pd(r2y, jx))));
+		
+		SCATTER4(A, v.x, avx); SCATTER4(A, v.y, avy); SCATTER4(A, w, aw);
+		SCATTER4(B, v.x, bvx); SCATTER4(B, v.y, bvy); SCATTER4(B, w, bw);
+	}
+	
+	// The remainder runs legacy SSE code, avoid the transition penalty.
+	_mm256_zeroupper();
+	SolvePivotsSSE2(rows, i, end);
+}
+
+#endif
+
+// Picked by SelectKernels(), NULL when there is no SIMD kernel and the rows are solved in place.
+static ContactKernel contactKernel = NULL;
+static PivotKernel pivotKernel = NULL;
+
+//MARK: PThreads
+
+// Arbiters and constraints are colored so that no two rows of the same color share a dynamic body.
+// Every color is split across the threads, any rows that don't fit in a color are solved by one thread.
+#define MAX_COLORS 64
+#define SERIAL_COLOR MAX_COLORS
+
+// Spins before a waiting thread parks or yields its core.
+// Only used when there is a core per thread, otherwise the spinning thread delays the one it waits for.
+#define SPIN_COUNT 4000
+
+// Work range of a worker packed as (begin << 32 | end) so it can be popped and stolen with one CAS.
+struct WorkRange {
+	uint64_t range;
+	char padding[64 - sizeof(uint64_t)];
+};
+
+// Candidate pair from the broadphase, the narrowphase fills in the info and contacts.
+struct NarrowPhasePair {
+	cpShape *a, *b;
+	cpCollisionID id;
+	struct cpCollisionInfo info;
+	struct cpContact contacts[CP_MAX_CONTACTS_PER_ARBITER];
+};
+
+// Bodies are integrated in tiles small enough to stay in L1.
+#define BATCH_SIZE 64
+
+// Structure of arrays copy of a tile of bodies that use the default integrators.
+struct BodyBatch {
+	cpBody *body[BATCH_SIZE];
+	cpFloat px[BATCH_SIZE], py[BATCH_SIZE], a[BATCH_SIZE];
+	cpFloat vx[BATCH_SIZE], vy[BATCH_SIZE], w[BATCH_SIZE];
+	cpFloat vbx[BATCH_SIZE], vby[BATCH_SIZE], wb[BATCH_SIZE];
+	cpFloat fx[BATCH_SIZE], fy[BATCH_SIZE], t[BATCH_SIZE];
+	cpFloat m_inv[BATCH_SIZE], i_inv[BATCH_SIZE];
+};
+
+struct ThreadContext {
+	pthread_t thread;
+	cpHastySpace *space;
+	unsigned long thread_num;
+	unsigned long generation;
+};
+
+typedef	void (*cpHastySpaceWorkFunction)(cpSpace *space, unsigned long worker, unsigned long worker_count);
+typedef void (*cpHastySpaceRangeFunction)(cpSpace *space, int begin, int end, void *data);
+
+// What the workers run for one job_generation.
+struct Job {
+	// Work function to invoke, NULL tells the workers to exit.
+	cpHastySpaceWorkFunction func;
+	const char *name;
+	// num_active when the job was published, workers with a higher thread_num sit it out.
+	unsigned long count;
+};
+
+struct cpHastySpace {
+	cpSpace space;
+	
+	// Number of threads in the pool (including the main thread)
+	unsigned long num_threads;
+	
+	// Number of threads that take part in the step. (also including the main thread)
+	unsigned long num_active;
+	
+	// Number of constraints (plus contacts) that must exist per step to start the worker threads.
+	unsigned long constraint_count_threshold;
+	
+	// SPIN_COUNT, or 0 when there are more threads than cores.
+	int spin_count;
+	
+	// Workers spin on job_generation for a while after each job, then park on cond_work.
+	pthread_mutex_t mutex;
+	pthread_cond_t cond_work;
+	unsigned long num_parked;
+	unsigned long job_generation;
+	unsigned long num_done;
+	
+	// The job of generation g is in jobs[g & 1], so the next one can be written while a late worker still reads it.
+	struct Job jobs[2];
+	
+	cpHastySpaceWorkHook work_hook;
+	void *work_hook_data;
+	
+	// Parallel for loop run by the work function.
+	cpHastySpaceRangeFunction range_func;
+	void *range_data;
+	int range_grain;
+	struct WorkRange *ranges;
+	
+	struct ThreadContext *workers;
+	
+	// Spin barrier used between colors while solving.
+	unsigned long barrier_count;
+	unsigned long barrier_generation;
+	
+	// Solver rows sorted by color, rebuilt every step.
+	cpArbiter **arbiter_rows;
+	cpConstraint **constraint_rows;
+	unsigned char *row_colors;
+	int row_capacity;
+	int arbiter_color_start[MAX_COLORS + 2];
+	int constraint_color_start[MAX_COLORS + 2];
+	
+	// Colors in use by each dynamic body, indexed by its slot in space->dynamicBodies.
+	uint64_t *body_colors;
+	int body_capacity;
+	
+	// Shapes of the dynamic spatial index gathered for the BB update.
+	cpShape **shapes;
+	int shape_capacity;
+	
+	// Broadphase pairs in query order, each worker writes the contacts of the pairs it collides.
+	struct NarrowPhasePair *pairs;
+	int pair_count, pair_capacity;
+	
+	cpFloat dt_coef;
+	cpHastySpaceTimings timings;
+	
+	cpBool batch_integration;
+	
+	cpBool batch_contacts;
+	struct ContactRows contacts;
+	
+	cpBool batch_joints;
+	struct PivotRows pivots;
+	int pivot_color_count[MAX_COLORS + 1];
+};
+
+static inline void
+Pause(void)
+{
+#if defined(__i386__) || defined(__x86_64__)
+	__builtin_ia32_pause();
+#endif
+}
+
+static inline double
+PhaseTime(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+static inline void
+WorkHook(cpHastySpace *hasty, const char *name, unsigned long thread, cpBool begin)
+{
+	cpHastySpaceWorkHook hook = hasty->work_hook;
+	if(hook) hook(name, thread, begin, hasty->work_hook_data);
+}
+
+static void *
+WorkerThreadLoop(struct ThreadContext *context)
+{
+	cpHastySpace *hasty = context->space;
+	unsigned long thread = context->thread_num;
+	unsigned long generation = context->generation;
+	
+	for(;;){
+		// Jobs come back to back within a step, so spin before parking.
+		for(int spins = 0; spins < __atomic_load_n(&hasty->spin_count, __ATOMIC_RELAXED) && __atomic_load_n(&hasty->job_generation, __ATOMIC_ACQUIRE) == generation; spins++) Pause();
+		
+		if(__atomic_load_n(&hasty->job_generation, __ATOMIC_ACQUIRE) == generation){
+			pthread_mutex_lock(&hasty->mutex); {
+				__atomic_add_fetch(&hasty->num_parked, 1, __ATOMIC_SEQ_CST);
+				while(__atomic_load_n(&hasty->job_generation, __ATOMIC_SEQ_CST) == generation){
+					pthread_cond_wait(&hasty->cond_work, &hasty->mutex);
+				}
+				__atomic_sub_fetch(&hasty->num_parked, 1, __ATOMIC_SEQ_CST);
+			} pthread_mutex_unlock(&hasty->mutex);
+		}
+		
+		// Sequentially consistent like the stores in WakeWorkers(), the slot is only whole while job_generation stays put.
+		unsigned long next = __atomic_load_n(&hasty->job_generation, __ATOMIC_SEQ_CST);
+		struct Job *job = &hasty->jobs[next & 1];
+		cpHastySpaceWorkFunction func = __atomic_load_n(&job->func, __ATOMIC_SEQ_CST);
+		const char *name = __atomic_load_n(&job->name, __ATOMIC_SEQ_CST);
+		unsigned long worker_count = __atomic_load_n(&job->count, __ATOMIC_SEQ_CST);
+		
+		// A worker that sat the job out can be this late. If a newer job came out meanwhile the slot may be
+		// half rewritten, read again. The job that was missed didn't count this thread, nothing waits on it.
+		if(__atomic_load_n(&hasty->job_generation, __ATOMIC_SEQ_CST) != next) continue;
+		generation = next;
+		
+		if(!func) break;
+		
+		if(thread < worker_count){
+			WorkHook(hasty, name, thread, cpTrue);
+			func(&hasty->space, thread, worker_count);
+			WorkHook(hasty, name, thread, cpFalse);
+			__atomic_add_fetch(&hasty->num_done, 1, __ATOMIC_RELEASE);
+		}
+	}
+	
+	return NULL;
+}
+
+// Publishes the job as the next generation. Only the main thread writes jobs and job_generation.
+static void
+WakeWorkers(cpHastySpace *hasty, cpHastySpaceWorkFunction func, const char *name, unsigned long count)
+{
+	struct Job *job = &hasty->jobs[(hasty->job_generation + 1) & 1];
+	__atomic_store_n(&job->func, func, __ATOMIC_SEQ_CST);
+	__atomic_store_n(&job->name, name, __ATOMIC_SEQ_CST);
+	__atomic_store_n(&job->count, count, __ATOMIC_SEQ_CST);
+	
+	__atomic_add_fetch(&hasty->job_generation, 1, __ATOMIC_SEQ_CST);
+	
+	if(__atomic_load_n(&hasty->num_parked, __ATOMIC_SEQ_CST) > 0){
+		pthread_mutex_lock(&hasty->mutex); {
+			pthread_cond_broadcast(&hasty->cond_work);
+		} pthread_mutex_unlock(&hasty->mutex);
+	}
+}
+
+// Runs func on the main thread and the active workers and returns when all of them are done.
+static void
+RunWorkers(cpHastySpace *hasty, const char *name, cpHastySpaceWorkFunction func)
+{
+	unsigned long worker_count = hasty->num_active;
+	
+	if(worker_count > 1){
+		hasty->num_done = 0;
+		WakeWorkers(hasty, func, name, worker_count);
+		
+		WorkHook(hasty, name, 0, cpTrue);
+		func((cpSpace *)hasty, 0, worker_count);
+		WorkHook(hasty, name, 0, cpFalse);
+		
+		double wait = PhaseTime();
+		for(unsigned long spins = 0; __atomic_load_n(&hasty->num_done, __ATOMIC_ACQUIRE) < worker_count - 1; spins++){
+			if(spins < (unsigned long)hasty->spin_count) Pause(); else sched_yield();
+		}
+		hasty->timings.wait += PhaseTime() - wait;
+	} else {
+		WorkHook(hasty, name, 0, cpTrue);
+		func((cpSpace *)hasty, 0, 1);
+		WorkHook(hasty, name, 0, cpFalse);
+	}
+}
+
+static inline cpBool
+PopRange(struct WorkRange *slot, int grain, int *begin, int *end)
+{
+	uint64_t range = __atomic_load_n(&slot->range, __ATOMIC_RELAXED);
+	for(;;){
+		uint32_t b = (uint32_t)(range >> 32), e = (uint32_t)range;
+		if(b >= e) return cpFalse;
+		
+		uint32_t split = (e - b > (uint32_t)grain ? b + grain : e);
+		if(__atomic_compare_exchange_n(&slot->range, &range, (uint64_t)split << 32 | e, cpTrue, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)){
+			(*begin) = b, (*end) = split;
+			return cpTrue;
+		}
+	}
+}
+
+static inline cpBool
+StealRange(struct WorkRange *slot, int grain, uint64_t *stolen)
+{
+	uint64_t range = __atomic_load_n(&slot->range, __ATOMIC_RELAXED);
+	for(;;){
+		uint32_t b = (uint32_t)(range >> 32), e = (uint32_t)range;
+		if(e - b <= (uint32_t)grain || b >= e) return cpFalse;
+		
+		// Take the back half, the owner keeps popping from the front.
+		uint32_t split = b + (e - b)/2;
+		if(__atomic_compare_exchange_n(&slot->range, &range, (uint64_t)b << 32 | split, cpTrue, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)){
+			(*stolen) = (uint64_t)split << 32 | e;
+			return cpTrue;
+		}
+	}
+}
+
+static void
+ParallelForWorker(cpSpace *space, unsigned long worker, unsigned long worker_count)
+{
+	cpHastySpace *hasty = (cpHastySpace *)space;
+	struct WorkRange *own = hasty->ranges + worker;
+	int grain = hasty->range_grain;
+	
+	for(;;){
+		int begin, end;
+		while(PopRange(own, grain, &begin, &end)) hasty->range_func(space, begin, end, hasty->range_data);
+		
+		// Out of work, steal half of what another worker has left.
+		uint64_t stolen;
+		cpBool found = cpFalse;
+		for(unsigned long i=1; i<worker_count && !found; i++){
+			found = StealRange(hasty->ranges + (worker + i)%worker_count, grain, &stolen);
+		}
+		
+		if(!found) break;
+		__atomic_store_n(&own->range, stolen, __ATOMIC_RELEASE);
+	}
+}
+
+// Calls func over [0, count) in chunks of grain items, spread over the active threads.
+static void
+ParallelFor(cpHastySpace *hasty, const char *name, int count, int grain, cpHastySpaceRangeFunction func, void *data)
+{
+	unsigned long worker_count = hasty->num_active;
+	if(worker_count == 1 || count <= grain){
+		if(count > 0){
+			WorkHook(hasty, name, 0, cpTrue);
+			func((cpSpace *)hasty, 0, count, data);
+			WorkHook(hasty, name, 0, cpFalse);
+		}
+		return;
+	}
+	
+	hasty->range_func = func;
+	hasty->range_data = data;
+	hasty->range_grain = grain;
+	
+	for(unsigned long i=0; i<worker_count; i++){
+		uint64_t begin = count*i/worker_count, end = count*(i + 1)/worker_count;
+		hasty->ranges[i].range = begin << 32 | end;
+	}
+	
+	RunWorkers(hasty, name, ParallelForWorker);
+}
+
+static void
+Barrier(cpHastySpace *hasty, unsigned long worker_count)
+{
+	if(worker_count == 1) return;
+	
+	unsigned long generation = __atomic_load_n(&hasty->barrier_generation, __ATOMIC_ACQUIRE);
+	if(__atomic_add_fetch(&hasty->barrier_count, 1, __ATOMIC_ACQ_REL) == worker_count){
+		__atomic_store_n(&hasty->barrier_count, 0, __ATOMIC_RELAXED);
+		__atomic_add_fetch(&hasty->barrier_generation, 1, __ATOMIC_RELEASE);
+	} else {
+		// Colors are short, so spin for a while before giving the core away.
+		for(unsigned long spins = 0; __atomic_load_n(&hasty->barrier_generation, __ATOMIC_ACQUIRE) == generation; spins++){
+			if(spins < (unsigned long)__atomic_load_n(&hasty->spin_count, __ATOMIC_RELAXED)) Pause(); else sched_yield();
+		}
+	}
+}
+
+// Every color taken, ColorRow() returns SERIAL_COLOR before it would write to it.
+static uint64_t AllColors = ~(uint64_t)0;
+
+static inline uint64_t *
+BodyColors(cpHastySpace *hasty, cpBody *body)
+{
+	// Static and kinematic bodies have infinite mass. The solver writes their unchanged velocity back,
+	// so they can be shared by rows of the same color.
+	if(cpBodyGetType(body) != CP_BODY_TYPE_DYNAMIC) return NULL;
+	
+	// A joint can be attached to a dynamic body that isn't in the space (or is asleep),
+	// it has no slot in body_colors so its rows are solved serially.
+	if(body->spaceIndex < 0) return &AllColors;
+	
+	return hasty->body_colors + body->spaceIndex;
+}
+
+static unsigned char
+ColorRow(cpHastySpace *hasty, cpBody *a, cpBody *b)
+{
+	uint64_t *colorsA = BodyColors(hasty, a);
+	uint64_t *colorsB = BodyColors(hasty, b);
+	uint64_t used = (colorsA ? *colorsA : 0) | (colorsB ? *colorsB : 0);
+	if(used == ~(uint64_t)0) return SERIAL_COLOR;
+	
+	int color = __builtin_ctzll(~used);
+	uint64_t bit = (uint64_t)1 << color;
+	if(colorsA) *colorsA |= bit;
+	if(colorsB) *colorsB |= bit;
+	
+	return (unsigned char)color;
+}
+
+// Greedy coloring in array order, then a counting sort of the rows by color.
+// The result only depends on the order of the arbiters and constraints, not on the thread count.
+static void
+ResizeRows(cpHastySpace *hasty, int capacity)
+{
+	hasty->row_capacity = capacity;
+	hasty->arbiter_rows = (cpArbiter **)cprealloc(hasty->arbiter_rows, capacity*sizeof(cpArbiter *));
+	hasty->constraint_rows = (cpConstraint **)cprealloc(hasty->constraint_rows, capacity*sizeof(cpConstraint *));
+	hasty->row_colors = (unsigned char *)cprealloc(hasty->row_colors, 2*capacity);
+}
+
+static void
+ColorRows(cpHastySpace *hasty)
+{
+	cpSpace *space = (cpSpace *)hasty;
+	cpArray *arbiters = space->arbiters;
+	cpArray *constraints = space->constraints;
+	int bodyCount = space->dynamicBodies->num;
+	
+	if(bodyCount > hasty->body_capacity){
+		hasty->body_capacity = bodyCount*2;
+		hasty->body_colors = (uint64_t *)cprealloc(hasty->body_colors, hasty->body_capacity*sizeof(uint64_t));
+	}
+	memset(hasty->body_colors, 0, bodyCount*sizeof(uint64_t));
+	
+	int rowCount = (arbiters->num > constraints->num ? arbiters->num : constraints->num);
+	if(rowCount > hasty->row_capacity) ResizeRows(hasty, rowCount*2);
+	
+	unsigned char *arbiterColors = hasty->row_colors;
+	unsigned char *constraintColors = hasty->row_colors + hasty->row_capacity;
+	int *arbiterStart = hasty->arbiter_color_start;
+	int *constraintStart = hasty->constraint_color_start;
+	memset(arbiterStart, 0, sizeof(hasty->arbiter_color_start));
+	memset(constraintStart, 0, sizeof(hasty->constraint_color_start));
+	
+	// Contacts are colored first, joints fill in the remaining colors.
+	for(int i=0; i<arbiters->num; i++){
+		cpArbiter *arb = (cpArbiter *)arbiters->arr[i];
+		unsigned char color = ColorRow(hasty, arb->body_a, arb->body_b);
+		arbiterColors[i] = color;
+		arbiterStart[color + 1]++;
+	}
+	
+	for(int i=0; i<constraints->num; i++){
+		cpConstraint *constraint = (cpConstraint *)constraints->arr[i];
+		unsigned char color = ColorRow(hasty, constraint->a, constraint->b);
+		constraintColors[i] = color;
+		constraintStart[color + 1]++;
+	}
+	
+	for(int c=0; c<=SERIAL_COLOR; c++){
+		arbiterStart[c + 1] += arbiterStart[c];
+		constraintStart[c + 1] += constraintStart[c];
+	}
+	
+	// Use the end of each range as the insertion cursor, it ends up back at the start.
+	int cursor[MAX_COLORS + 1];
+	
+	memcpy(cursor, arbiterStart, sizeof(cursor));
+	for(int i=0; i<arbiters->num; i++) hasty->arbiter_rows[cursor[arbiterColors[i]]++] = (cpArbiter *)arbiters->arr[i];
+	
+	// Pivot joints go first in each color so they can be solved in batches.
+	memcpy(cursor, constraintStart, sizeof(cursor));
+	for(int i=0; i<constraints->num; i++){
+		cpConstraint *constraint = (cpConstraint *)constraints->arr[i];
+		if(cpConstraintIsPivotJoint(constraint)) hasty->constraint_rows[cursor[constraintColors[i]]++] = constraint;
+	}
+	
+	for(int c=0; c<=SERIAL_COLOR; c++) hasty->pivot_color_count[c] = cursor[c] - constraintStart[c];
+	
+	for(int i=0; i<constraints->num; i++){
+		cpConstraint *constraint = (cpConstraint *)constraints->arr[i];
+		if(!cpConstraintIsPivotJoint(constraint)) hasty->constraint_rows[cursor[constraintColors[i]]++] = constraint;
+	}
+}
+
+// Moves a split point inside a packed range down to a multiple of the lanes.
+// Rows then fall into the same lanes for any thread count, the scalar remainder rounds differently.
+static inline int
+AlignSplit(int i, int start, int count)
+{
+	return (start < i && i < start + count ? start + ((i - start) & ~(SIMD_LANES - 1)) : i);
+}
+
+static inline void
+SolveRows(cpHastySpace *hasty, int color, unsigned long worker, unsigned long worker_count, cpFloat dt)
+{
+	int arbiterStart = hasty->arbiter_color_start[color];
+	int arbiterCount = hasty->arbiter_color_start[color + 1] - arbiterStart;
+	int constraintStart = hasty->constraint_color_start[color];
+	int constraintCount = hasty->constraint_color_start[color + 1] - constraintStart;
+	
+	// Split the color evenly, the arbiters come first.
+	int count = arbiterCount + constraintCount;
+	int begin = (int)((long)count*worker/worker_count);
+	int end = (int)((long)count*(worker + 1)/worker_count);
+	
+	if(hasty->batch_contacts){
+		begin = AlignSplit(begin, 0, arbiterCount);
+		end = AlignSplit(end, 0, arbiterCount);
+	}
+	
+	int pivotCount = (hasty->batch_joints ? hasty->pivot_color_count[color] : 0);
+	if(pivotCount){
+		begin = AlignSplit(begin, arbiterCount, pivotCount);
+		end = AlignSplit(end, arbiterCount, pivotCount);
+	}
+	
+	if(hasty->batch_contacts){
+		int arbiterEnd = (end < arbiterCount ? end : arbiterCount);
+		if(begin < arbiterEnd){
+			// Rows of the serial color can share bodies, so they are solved one at a time.
+			ContactKernel kernel = (color == SERIAL_COLOR ? SolveContactsScalar : contactKernel);
+			kernel(&hasty->contacts, arbiterStart + begin, arbiterStart + arbiterEnd);
+		}
+	} else {
+		for(int i=begin; i<end && i<arbiterCount; i++){
+			cpArbiter *arb = hasty->arbiter_rows[arbiterStart + i];
+			#ifdef __ARM_NEON__
+				cpArbiterApplyImpulse_NEON(arb);
+			#else
+				cpArbiterApplyImpulse(arb);
+			#endif
+		}
+	}
+	
+	int constraintBegin = (begin > arbiterCount ? begin : arbiterCount) - arbiterCount;
+	int constraintEnd = end - arbiterCount;
+	
+	int pivotEnd = (constraintEnd < pivotCount ? constraintEnd : pivotCount);
+	if(constraintBegin < pivotEnd){
+		PivotKernel kernel = (color == SERIAL_COLOR ? SolvePivotsScalar : pivotKernel);
+		kernel(&hasty->pivots, constraintStart + constraintBegin, constraintStart + pivotEnd);
+	}
+	
+	for(int i=(constraintBegin > pivotCount ? constraintBegin : pivotCount); i<constraintEnd; i++){
+		cpConstraint *constraint = hasty->constraint_rows[constraintStart + i];
+		constraint->klass->applyImpulse(constraint, dt);
+	}
+}
+
+static inline void
+ApplyCachedRows(cpHastySpace *hasty, int color, unsigned long worker, unsigned long worker_count)
+{
+	int arbiterStart = hasty->arbiter_color_start[color];
+	int arbiterCount = hasty->arbiter_color_start[color + 1] - arbiterStart;
+	int constraintStart = hasty->constraint_color_start[color];
+	int constraintCount = hasty->constraint_color_start[color + 1] - constraintStart;
+	cpFloat dt_coef = hasty->dt_coef;
+	
+	int count = arbiterCount + constraintCount;
+	int begin = (int)((long)count*worker/worker_count);
+	int end = (int)((long)count*(worker + 1)/worker_count);
+	
+	for(int i=begin; i<end && i<arbiterCount; i++){
+		cpArbiterApplyCachedImpulse(hasty->arbiter_rows[arbiterStart + i], dt_coef);
+	}
+	
+	for(int i=(begin > arbiterCount ? begin : arbiterCount); i<end; i++){
+		cpConstraint *constraint = hasty->constraint_rows[constraintStart + i - arbiterCount];
+		constraint->klass->applyCachedImpulse(constraint, dt_coef);
+	}
+}
+
+static inline cpBool
+ColorIsEmpty(cpHastySpace *hasty, int color)
+{
+	return (
+		hasty->arbiter_color_start[color] == hasty->arbiter_color_start[color + 1] &&
+		hasty->constraint_color_start[color] == hasty->constraint_color_start[color + 1]
+	);
+}
+
+static void
+Solver(cpSpace *space, unsigned long worker, unsigned long worker_count)
+{
+	cpHastySpace *hasty = (cpHastySpace *)space;
+	cpFloat dt = space->curr_dt;
+	
+	// Warm start with the cached impulses, this writes to the bodies too so it follows the colors.
+	for(int color=0; color<=SERIAL_COLOR; color++){
+		if(ColorIsEmpty(hasty, color)) continue;
+		
+		if(color < SERIAL_COLOR){
+			ApplyCachedRows(hasty, color, worker, worker_count);
+		} else if(worker == 0){
+			ApplyCachedRows(hasty, color, 0, 1);
+		}
+		Barrier(hasty, worker_count);
+	}
+	
+	for(int i=0; i<space->iterations; i++){
+		for(int color=0; color<MAX_COLORS; color++){
+			if(hasty->arbiter_color_start[color] == hasty->arbiter_color_start[SERIAL_COLOR] && hasty->constraint_color_start[color] == hasty->constraint_color_start[SERIAL_COLOR]) break;
+			
+			SolveRows(hasty, color, worker, worker_count, dt);
+			Barrier(hasty, worker_count);
+		}
+		
+		if(!ColorIsEmpty(hasty, SERIAL_COLOR)){
+			if(worker == 0) SolveRows(hasty, SERIAL_COLOR, 0, 1, dt);
+			Barrier(hasty, worker_count);
+		}
+	}
+	
+	if(hasty->batch_contacts){
+		int count = space->arbiters->num;
+		int begin = (int)((long)count*worker/worker_count);
+		int end = (int)((long)count*(worker + 1)/worker_count);
+		for(int i=begin; i<end; i++) UnpackContactRow(&hasty->contacts, i, hasty->arbiter_rows[i]);
+	}
+	
+	if(hasty->batch_joints){
+		int count = space->constraints->num;
+		int begin = (int)((long)count*worker/worker_count);
+		int end = (int)((long)count*(worker + 1)/worker_count);
+		for(int i=begin; i<end; i++){
+			cpConstraint *constraint = hasty->constraint_rows[i];
+			if(cpConstraintIsPivotJoint(constraint)) UnpackPivotRow(&hasty->pivots, i, (cpPivotJoint *)constraint);
+		}
+	}
+}
+
+//MARK: Batched Integration
+
+// Same operations in the same order as cpBodyUpdateVelocity() and cpBodyUpdatePosition().
+typedef void (*VelocityKernel)(struct BodyBatch *m, int begin, int end, cpVect g, cpFloat damping, cpFloat dt);
+typedef void (*PositionKernel)(struct BodyBatch *m, int begin, int end, cpFloat dt);
+
+static void
+IntegrateVelocityScalar(struct BodyBatch *m, int begin, int end, cpVect g, cpFloat damping, cpFloat dt)
+{
+	for(int i=begin; i<end; i++){
+		m->vx[i] = m->vx[i]*damping + (g.x + m->fx[i]*m->m_inv[i])*dt;
+		m->vy[i] = m->vy[i]*damping + (g.y + m->fy[i]*m->m_inv[i])*dt;
+		m->w[i] = m->w[i]*damping + m->t[i]*m->i_inv[i]*dt;
+	}
+}
+
+static void
+IntegratePositionScalar(struct BodyBatch *m, int begin, int end, cpFloat dt)
+{
+	for(int i=begin; i<end; i++){
+		m->px[i] = m->px[i] + (m->vx[i] + m->vbx[i])*dt;
+		m->py[i] = m->py[i] + (m->vy[i] + m->vby[i])*dt;
+		m->a[i] = m->a[i] + (m->w[i] + m->wb[i])*dt;
+	}
+}
+
+#if CP_USE_DOUBLES && defined(__SSE2__)
+
+static void
+IntegrateVelocitySSE2(struct BodyBatch *m, int begin, int end, cpVect g, cpFloat damping, cpFloat dt)
+{
+	__m128d gx = _mm_set1_pd(g.x), gy = _mm_set1_pd(g.y);
+	__m128d d = _mm_set1_pd(damping), h = _mm_set1_pd(dt);
+	
+	int i = begin;
+	for(; i + 2 <= end; i += 2){
+		__m128d m_inv = _mm_loadu_pd(m->m_inv + i);
+		__m128d vx = _mm_add_pd(_mm_mul_pd(_mm_loadu_pd(m->vx + i), d), _mm_mul_pd(_mm_add_pd(gx, _mm_mul_pd(_mm_loadu_pd(m->fx + i), m_inv)), h));
+		__m128d vy = _mm_add_pd(_mm_mul_pd(_mm_loadu_pd(m->vy + i), d), _mm_mul_pd(_mm_add_pd(gy, _mm_mul_pd(_mm_loadu_pd(m->fy + i), m_inv)), h));
+		__m128d w = _mm_add_pd(_mm_mul_pd(_mm_loadu_pd(m->w + i), d), _mm_mul_pd(_mm_mul_pd(_mm_loadu_pd(m->t + i), _mm_loadu_pd(m->i_inv + i)), h));
+		_mm_storeu_pd(m->vx + i, vx);
+		_mm_storeu_pd(m->vy + i, vy);
+		_mm_storeu_pd(m->w + i, w);
+	}
+	
+	IntegrateVelocityScalar(m, i, end, g, damping, dt);
+}
+
+static void
+IntegratePositionSSE2(struct BodyBatch *m, int begin, int end, cpFloat dt)
+{
+	__m128d h = _mm_set1_pd(dt);
+	
+	int i = begin;
+	for(; i + 2 <= end; i += 2){
+		_mm_storeu_pd(m->px + i, _mm_add_pd(_mm_loadu_pd(m->px + i), _mm_mul_pd(_mm_add_pd(_mm_loadu_pd(m->vx + i), _mm_loadu_pd(m->vbx + i)), h)));
+		_mm_storeu_pd(m->py + i, _mm_add_pd(_mm_loadu_pd(m->py + i), _mm_mul_pd(_mm_add_pd(_mm_loadu_pd(m->vy + i), _mm_loadu_pd(m->vby + i)), h)));
+		_mm_storeu_pd(m->a + i, _mm_add_pd(_mm_loadu_pd(m->a + i), _mm_mul_pd(_mm_add_pd(_mm_loadu_pd(m->w + i), _mm_loadu_pd(m->wb + i)), h)));
+	}
+	
+	IntegratePositionScalar(m, i, end, dt);
+}
+
+__attribute__((target("avx2"))) static void
+IntegrateVelocityAVX2(struct BodyBatch *m, int begin, int end, cpVect g, cpFloat damping, cpFloat dt)
+{
+	__m256d gx = _mm256_set1_pd(g.x), gy = _mm256_set1_pd(g.y);
+	__m256d d = _mm256_set1_pd(damping), h = _mm256_set1_pd(dt);
+	
+	int i = begin;
+	for(; i + 4 <= end; i += 4){
+		__m256d m_inv = _mm256_loadu_pd(m->m_inv + i);
+		__m256d vx = _mm256_add_pd(_mm256_mul_pd(_mm256_loadu_pd(m->vx + i), d), _mm256_mul_pd(_mm256_add_pd(gx, _mm256_mul_pd(_mm256_loadu_pd(m->fx + i), m_inv)), h));
+		__m256d vy = _mm256_add_pd(_mm256_mul_pd(_mm256_loadu_pd(m->vy + i), d), _mm256_mul_pd(_mm256_add_pd(gy, _mm256_mul_pd(_mm256_loadu_pd(m->fy + i), m_inv)), h));
+		__m256d w = _mm256_add_pd(_mm256_mul_pd(_mm256_loadu_pd(m->w + i), d), _mm256_mul_pd(_mm256_mul_pd(_mm256_loadu_pd(m->t + i), _mm256_loadu_pd(m->i_inv + i)), h));
+		_mm256_storeu_pd(m->vx + i, vx);
+		_mm256_storeu_pd(m->vy + i, vy);
+		_mm256_storeu_pd(m->w + i, w);
+	}
+	
+	// The remainder runs legacy SSE code, avoid the transition penalty.
+	_mm256_zeroupper();
+	IntegrateVelocitySSE2(m, i, end, g, damping, dt);
+}
+
+__attribute__((target("avx2"))) static void
+IntegratePositionAVX2(struct BodyBatch *m, int begin, int end, cpFloat dt)
+{
+	__m256d h = _mm256_set1_pd(dt);
+	
+	int i = begin;
+	for(; i + 4 <= end; i += 4){
+		_mm256_storeu_pd(m->px + i, _mm256_add_pd(_mm256_loadu_pd(m->px + i), _mm256_mul_pd(_mm256_add_pd(_mm256_loadu_pd(m->vx + i), _mm256_loadu_pd(m->vbx + i)), h)));
+		_mm256_storeu_pd(m->py + i, _mm256_add_pd(_mm256_loadu_pd(m->py + i), _mm256_mul_pd(_mm256_add_pd(_mm256_loadu_pd(m->vy + i), _mm256_loadu_pd(m->vby + i)), h)));
+		_mm256_storeu_pd(m->a + i, _mm256_add_pd(_mm256_loadu_pd(m->a + i), _mm256_mul_pd(_mm256_add_pd(_mm256_loadu_pd(m->w + i), _mm256_loadu_pd(m->wb + i)), h)));
+	}
+	
+	// The remainder runs legacy SSE code, avoid the transition penalty.
+	_mm256_zeroupper();
+	IntegratePositionSSE2(m, i, end, dt);
+}
+
+#endif
+
+static VelocityKernel velocityKernel = IntegrateVelocityScalar;
+static PositionKernel positionKernel = IntegratePositionScalar;
+
+static void
+SelectKernels(void)
+{
+#if CP_USE_DOUBLES && defined(__SSE2__)
+	velocityKernel = IntegrateVelocitySSE2;
+	positionKernel = IntegratePositionSSE2;
+	contactKernel = SolveContactsSSE2;
+	pivotKernel = SolvePivotsSSE2;
+	
+	if(__builtin_cpu_supports("avx2")){
+		velocityKernel = IntegrateVelocityAVX2;
+		positionKernel = IntegratePositionAVX2;
+		contactKernel = SolveContactsAVX2;
+		pivotKernel = SolvePivotsAVX2;
+	}
+#endif
+}
+
+//MARK: Parallel Step Phases
+
+static void
+IntegratePositions(cpSpace *space, int begin, int end, void *data)
+{
+	cpHastySpace *hasty = (cpHastySpace *)space;
+	cpFloat dt = space->curr_dt;
+	cpBody **bodies = (cpBody **)space->dynamicBodies->arr;
+	
+	if(!hasty->batch_integration){
+		for(int i=begin; i<end; i++) bodies[i]->position_func(bodies[i], dt);
+		return;
+	}
+	
+	struct BodyBatch batch, *m = &batch;
+	for(int i=begin; i<end;){
+		// Gather the bodies with the default integrator, call the rest.
+		int count = 0;
+		for(; i<end && count<BATCH_SIZE; i++){
+			cpBody *body = bodies[i];
+			if(body->position_func != cpBodyUpdatePosition){
+				body->position_func(body, dt);
+				continue;
+			}
+			
+			int j = count++;
+			m->body[j] = body;
+			m->px[j] = body->p.x; m->py[j] = body->p.y; m->a[j] = body->a;
+			m->vx[j] = body->v.x; m->vy[j] = body->v.y; m->w[j] = body->w;
+			m->vbx[j] = body->v_bias.x; m->vby[j] = body->v_bias.y; m->wb[j] = body->w_bias;
+		}
+		
+		positionKernel(m, 0, count, dt);
+		
+		for(int j=0; j<count; j++){
+			cpBody *body = m->body[j];
+			cpBodySetIntegratedTransform(body, cpv(m->px[j], m->py[j]), m->a[j]);
+			body->v_bias = cpvzero;
+			body->w_bias = 0.0f;
+		}
+	}
+}
+
+static void
+PushShape(cpShape *shape, cpShape ***cursor)
+{
+	*((*cursor)++) = shape;
+}
+
+static void
+UpdateShapes(cpSpace *space, int begin, int end, void *data)
+{
+	cpShape **shapes = (cpShape **)data;
+	for(int i=begin; i<end; i++) cpShapeUpdateFunc(shapes[i], NULL);
+}
+
+static cpCollisionID
+CollectPair(cpShape *a, cpShape *b, cpCollisionID id, cpHastySpace *hasty)
+{
+	cpSpaceStepCount((cpSpace *)hasty, candidatePairs, 1);
+	if(cpSpaceShapeQueryReject(a, b)) return id;
+	
+	if(hasty->pair_count == hasty->pair_capacity){
+		hasty->pair_capacity = (hasty->pair_capacity ? hasty->pair_capacity*2 : 256);
+		hasty->pairs = (struct NarrowPhasePair *)cprealloc(hasty->pairs, hasty->pair_capacity*sizeof(struct NarrowPhasePair));
+	}
+	
+	struct NarrowPhasePair *pair = hasty->pairs + hasty->pair_count++;
+	pair->a = a;
+	pair->b = b;
+	pair->id = id;
+	
+	// The new id can't be returned to the index from here, it's kept on the arbiter instead.
+	return id;
+}
+
+static void
+CollidePairs(cpSpace *space, int begin, int end, void *data)
+{
+	struct NarrowPhasePair *pairs = (struct NarrowPhasePair *)data;
+	
+	for(int i=begin; i<end; i++){
+		struct NarrowPhasePair *pair = pairs + i;
+		
+		// Nothing is inserted into the arbiter set until the merge, so it's safe to read here.
+		const cpShape *shape_pair[] = {pair->a, pair->b};
+		cpHashValue arbHashID = CP_HASH_PAIR(pair->a->hashid, pair->b->hashid);
+		cpArbiter *arb = (cpArbiter *)cpHashSetFind(space->cachedArbiters, arbHashID, shape_pair);
+		
+		pair->info = cpCollide(pair->a, pair->b, (arb ? arb->id : pair->id), pair->contacts);
+	}
+}
+
+// Moves the contacts into the space's contact buffer and updates the arbiters in broadphase order.
+// This runs the begin and preSolve callbacks, so it stays on the calling thread.
+static void
+MergePairs(cpHastySpace *hasty)
+{
+	cpSpace *space = (cpSpace *)hasty;
+	
+	for(int i=0; i<hasty->pair_count; i++){
+		struct cpCollisionInfo info = hasty->pairs[i].info;
+		if(info.count == 0) continue;
+		
+		info.arr = cpContactBufferGetArray(space);
+		memcpy(info.arr, hasty->pairs[i].contacts, info.count*sizeof(struct cpContact));
+		cpSpacePushContacts(space, info.count);
+		
+		cpSpaceHandleCollision(space, &info);
+	}
+}
+
+// Runs over the colored rows so the packed contacts line up with them.
+static void
+PreStepArbiters(cpSpace *space, int begin, int end, void *data)
+{
+	cpHastySpace *hasty = (cpHastySpace *)space;
+	cpFloat dt = space->curr_dt;
+	cpFloat slop = space->collisionSlop;
+	cpFloat biasCoef = 1.0f - cpfpow(space->collisionBias, dt);
+	cpArbiter **arbiters = hasty->arbiter_rows;
+	for(int i=begin; i<end; i++){
+		cpArbiterPreStep(arbiters[i], dt, slop, biasCoef);
+		if(hasty->batch_contacts) PackContactRow(&hasty->contacts, i, arbiters[i]);
+	}
+}
+
+// Also runs over the colored rows, the pivot joints are packed after their preStep() clamped the bias.
+static void
+PreStepConstraints(cpSpace *space, int begin, int end, void *data)
+{
+	cpHastySpace *hasty = (cpHastySpace *)space;
+	cpFloat dt = space->curr_dt;
+	cpConstraint **constraints = hasty->constraint_rows;
+	for(int i=begin; i<end; i++){
+		cpConstraint *constraint = constraints[i];
+		constraint->klass->preStep(constraint, dt);
+		if(hasty->batch_joints && cpConstraintIsPivotJoint(constraint)) PackPivotRow(&hasty->pivots, i, (cpPivotJoint *)constraint, dt);
+	}
+}
+
+static void
+IntegrateVelocities(cpSpace *space, int begin, int end, void *data)
+{
+	cpHastySpace *hasty = (cpHastySpace *)space;
+	cpFloat dt = space->curr_dt;
+	cpFloat damping = cpfpow(space->damping, dt);
+	cpVect gravity = space->gravity;
+	cpBody **bodies = (cpBody **)space->dynamicBodies->arr;
+	
+	if(!hasty->batch_integration){
+		for(int i=begin; i<end; i++) bodies[i]->velocity_func(bodies[i], gravity, damping, dt);
+		return;
+	}
+	
+	struct BodyBatch batch, *m = &batch;
+	for(int i=begin; i<end;){
+		int count = 0;
+		for(; i<end && count<BATCH_SIZE; i++){
+			cpBody *body = bodies[i];
+			if(body->velocity_func != cpBodyUpdateVelocity){
+				body->velocity_func(body, gravity, damping, dt);
+				continue;
+			}
+			
+			// The default integrator skips kinematic bodies.
+			if(cpBodyGetType(body) == CP_BODY_TYPE_KINEMATIC) continue;
+			cpAssertSoft(body->m > 0.0f && body->i > 0.0f, "Body's mass and moment must be positive to simulate. (Mass: %f Moment: %f)", body->m, body->i);
+			
+			int j = count++;
+			m->body[j] = body;
+			m->vx[j] = body->v.x; m->vy[j] = body->v.y; m->w[j] = body->w;
+			m->fx[j] = body->f.x; m->fy[j] = body->f.y; m->t[j] = body->t;
+			m->m_inv[j] = body->m_inv; m->i_inv[j] = body->i_inv;
+		}
+		
+		velocityKernel(m, 0, count, gravity, damping, dt);
+		
+		for(int j=0; j<count; j++){
+			cpBody *body = m->body[j];
+			body->v = cpv(m->vx[j], m->vy[j]);
+			body->w = m->w[j];
+			
+			// Reset forces.
+			body->f = cpvzero;
+			body->t = 0.0f;
+		}
+	}
+}
+
+//MARK: Thread Management Functions
+
+static unsigned long
+CPUCount(void)
+{
+#ifdef __APPLE__
+	unsigned long cpus = 1;
+	size_t size = sizeof(cpus);
+	sysctlbyname("hw.ncpu", &cpus, &size, NULL, 0);
+	return cpus;
+#else
+	long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	return (cpus > 0 ? (unsigned long)cpus : 1);
+#endif
+}
+
+static void
+HaltThreads(cpHastySpace *hasty)
+{
+	WakeWorkers(hasty, NULL, NULL, 0); // NULL work function means break and exit
+	
+	for(unsigned long i=0; i<(hasty->num_threads-1); i++){
+		pthread_join(hasty->workers[i].thread, NULL);
+	}
+	
+	cpfree(hasty->workers);
+	hasty->workers = NULL;
+	
+	cpfree(hasty->ranges);
+	hasty->ranges = NULL;
+	
+	hasty->num_threads = 1;
+}
+
+void
+cpHastySpaceSetThreads(cpSpace *space, unsigned long threads)
+{
+#if TARGET_IPHONE_SIMULATOR == 1
+	// Individual values appear to be written non-atomically when compiled as debug for the simulator.
+	// No idea why, so threads are disabled.
+	threads = 1;
+#endif	
+	
+	cpHastySpace *hasty = (cpHastySpace *)space;
+	
+	unsigned long cpus = CPUCount();
+	if(threads == 0) threads = cpus;
+	
+	// The pool only grows, using fewer threads just leaves the rest parked.
+	hasty->num_active = threads;
+	// Idle workers read spin_count while they wait for the next job.
+	__atomic_store_n(&hasty->spin_count, (threads <= cpus ? SPIN_COUNT : 0), __ATOMIC_RELAXED);
+	if(threads <= hasty->num_threads) return;
+	
+	cpAllocator *allocator = cpSpaceUseAllocator(space);
+	HaltThreads(hasty);
+	hasty->num_threads = threads;
+	hasty->ranges = (struct WorkRange *)cpcalloc(threads, sizeof(struct WorkRange));
+	hasty->workers = (struct ThreadContext *)cpcalloc(threads - 1, sizeof(struct ThreadContext));
+	cpSetAllocator(allocator);
+	
+	for(unsigned long i=0; i<(threads-1); i++){
+		hasty->workers[i].space = hasty;
+		hasty->workers[i].thread_num = i + 1;
+		hasty->workers[i].generation = hasty->job_generation;
+		
+		pthread_create(&hasty->workers[i].thread, NULL, (void *)WorkerThreadLoop, &hasty->workers[i]);
+	}
+}
+
+unsigned long
+cpHastySpaceGetThreads(cpSpace *space)
+{
+	return ((cpHastySpace *)space)->num_active;
+}
+
+void
+cpHastySpaceSetBatchContacts(cpSpace *space, cpBool enabled)
+{
+	((cpHastySpace *)space)->batch_contacts = (enabled && contactKernel != NULL);
+}
+
+void
+cpHastySpaceSetBatchJoints(cpSpace *space, cpBool enabled)
+{
+	((cpHastySpace *)space)->batch_joints = (enabled && pivotKernel != NULL);
+}
+
+void
+cpHastySpaceSetBatchIntegration(cpSpace *space, cpBool enabled)
+{
+	((cpHastySpace *)space)->batch_integration = enabled;
+}
+
+void
+cpHastySpaceReserve(cpSpace *space, int pairs, int contacts, int joints)
+{
+	cpAllocator *allocator = cpSpaceUseAllocator(space);
+	
+	cpHastySpace *hasty = (cpHastySpace *)space;
+	cpSpaceReserve(space, pairs, contacts, joints);
+	
+	if(pairs > hasty->pair_capacity){
+		hasty->pair_capacity = pairs;
+		hasty->pairs = (struct NarrowPhasePair *)cprealloc(hasty->pairs, hasty->pair_capacity*sizeof(struct NarrowPhasePair));
+	}
+	
+	int constraintCount = space->constraints->num + joints;
+	int rowCount = (pairs > constraintCount ? pairs : constraintCount);
+	if(rowCount > hasty->row_capacity) ResizeRows(hasty, rowCount);
+	if(hasty->batch_contacts && hasty->contacts.capacity < hasty->row_capacity) ResizeContactRows(&hasty->contacts, hasty->row_capacity);
+	if(hasty->batch_joints && hasty->pivots.capacity < hasty->row_capacity) ResizePivotRows(&hasty->pivots, hasty->row_capacity);
+	
+	cpSetAllocator(allocator);
+}
+
+void
+cpHastySpaceSetWorkHook(cpSpace *space, cpHastySpaceWorkHook hook, void *data)
+{
+	cpHastySpace *hasty = (cpHastySpace *)space;
+	hasty->work_hook = hook;
+	hasty->work_hook_data = data;
+}
+
+cpHastySpaceTimings
+cpHastySpaceGetTimings(cpSpace *space)
+{
+	return ((cpHastySpace *)space)->timings;
+}
+
+//MARK: Overriden cpSpace Functions.
+
+cpSpace *
+cpHastySpaceNew(void)
+{
+	cpHastySpace *hasty = (cpHastySpace *)cpcalloc(1, sizeof(cpHastySpace));
+	cpSpaceInit((cpSpace *)hasty);
+	
+	pthread_mutex_init(&hasty->mutex, NULL);
+	pthread_cond_init(&hasty->cond_work, NULL);
+	
+	// TODO magic number, should test this more thoroughly.
+	hasty->constraint_count_threshold = 50;
+	
+	SelectKernels();
+	hasty->batch_integration = cpFalse;
+	hasty->batch_contacts = (contactKernel != NULL);
+	hasty->batch_joints = (pivotKernel != NULL);
+	
+	// Default to 1 thread.
+	hasty->num_threads = 1;
+	cpHastySpaceSetThreads((cpSpace *)hasty, 1);
+
+	return (cpSpace *)hasty;
+}
+
+void
+cpHastySpaceFree(cpSpace *space)
+{
+	cpAllocator *allocator = cpSpaceUseAllocator(space);
+	
+	cpHastySpace *hasty = (cpHastySpace *)space;
+	
+	HaltThreads(hasty);
+	
+	pthread_mutex_destroy(&hasty->mutex);
+	pthread_cond_destroy(&hasty->cond_work);
+	
+	cpfree(hasty->arbiter_rows);
+	cpfree(hasty->constraint_rows);
+	cpfree(hasty->row_colors);
+	cpfree(hasty->body_colors);
+	cpfree(hasty->shapes);
+	cpfree(hasty->pairs);
+	FreeContactRows(&hasty->contacts);
+	FreePivotRows(&hasty->pivots);
+	
+	cpSpaceFree(space);
+	
+	cpSetAllocator(allocator);
+}
+
+void
+cpHastySpaceStep(cpSpace *space, cpFloat dt)
+{
+	// don't step if the timestep is 0!
+	if(dt == 0.0f) return;
+	
+	cpHastySpace *hasty = (cpHastySpace *)space;
+	cpHastySpaceTimings *timings = &hasty->timings;
+	double start = PhaseTime(), time = start, now;
+	timings->wait = 0.0f;
+	cpAllocator *allocator = cpSpaceUseAllocator(space);
+	cpAllocStats allocs = cpGetAllocStats();
+	cpSpaceBeginStepStats(space);
+	
+	space->stamp++;
+	
+	cpFloat prev_dt = space->curr_dt;
+	space->curr_dt = dt;
+		
+	cpArray *bodies = space->dynamicBodies;
+	cpArray *constraints = space->constraints;
+	cpArray *arbiters = space->arbiters;
+	
+	// Reset and empty the arbiter list.
+	for(int i=0; i<arbiters->num; i++){
+		cpArbiter *arb = (cpArbiter *)arbiters->arr[i];
+		arb->state = CP_ARBITER_STATE_NORMAL;
+		
+		// If both bodies are awake, unthread the arbiter from the contact graph.
+		if(!cpBodyIsSleeping(arb->body_a) && !cpBodyIsSleeping(arb->body_b)){
+			cpArbiterUnthread(arb);
+		}
+	}
+	arbiters->num = 0;
+	cpSpaceStepPhase(space, resetArbiters);
+
+	cpSpaceLock(space); {
+		// Integrate positions
+		ParallelFor(hasty, "IntegratePositions", bodies->num, 64, IntegratePositions, NULL);
+		now = PhaseTime(); timings->integratePositions = now - time; time = now;
+		cpSpaceStepPhase(space, integratePositions);
+		
+		// Update the shape BBs, the spatial index can't be walked in parallel so gather the shapes first.
+		int shapeCount = cpSpatialIndexCount(space->dynamicShapes);
+		if(shapeCount > hasty->shape_capacity){
+			hasty->shape_capacity = shapeCount*2;
+			hasty->shapes = (cpShape **)cprealloc(hasty->shapes, hasty->shape_capacity*sizeof(cpShape *));
+		}
+		
+		cpShape **cursor = hasty->shapes;
+		cpSpatialIndexEach(space->dynamicShapes, (cpSpatialIndexIteratorFunc)PushShape, &cursor);
+		ParallelFor(hasty, "UpdateShapes", shapeCount, 64, UpdateShapes, hasty->shapes);
+		now = PhaseTime(); timings->updateBBs = now - time; time = now;
+		cpSpaceStepPhase(space, updateBBs);
+		
+		// Find colliding pairs.
+		hasty->pair_count = 0;
+		cpSpatialIndexReindexQuery(space->dynamicShapes, (cpSpatialIndexQueryFunc)CollectPair, hasty);
+		now = PhaseTime(); timings->broadphase = now - time; time = now;
+		cpSpaceStepPhase(space, broadphase);
+		cpSpaceStepCount(space, collideCalls, hasty->pair_count);
+		
+		ParallelFor(hasty, "CollidePairs", hasty->pair_count, 32, CollidePairs, hasty->pairs);
+		now = PhaseTime(); timings->narrowphase = now - time; time = now;
+		
+		cpSpacePushFreshContactBuffer(space);
+		MergePairs(hasty);
+		now = PhaseTime(); timings->mergeContacts = now - time; time = now;
+		cpSpaceStepPhase(space, narrowphase);
+	} cpSpaceUnlock(space, cpFalse);
+	
+	// Rebuild the contact graph (and detect sleeping components if sleeping is enabled)
+	cpSpaceProcessComponents(space, dt);
+	now = PhaseTime(); timings->processComponents = now - time; time = now;
+	cpSpaceStepPhase(space, processComponents);
+	
+	cpSpaceLock(space); {
+		// Clear out old cached arbiters and call separate callbacks
+		cpHashSetFilter(space->cachedArbiters, (cpHashSetFilterFunc)cpSpaceArbiterSetFilter, space);
+		cpSpaceFilterAdhesionImpulses(space);
+		cpSpaceStepPhase(space, filterArbiters);
+
+		// Callbacks can touch anything, so they run here before the parallel prestep.
+		for(int i=0; i<constraints->num; i++){
+			cpConstraint *constraint = (cpConstraint *)constraints->arr[i];
+			
+			cpConstraintPreSolveFunc preSolve = constraint->preSolve;
+			if(preSolve) preSolve(constraint, space);
+		}
+		
+		// The rows don't change from here on, color them before the prestep packs the contacts.
+		ColorRows(hasty);
+		if(hasty->batch_contacts && hasty->contacts.capacity < hasty->row_capacity){
+			ResizeContactRows(&hasty->contacts, hasty->row_capacity);
+		}
+		if(hasty->batch_joints && hasty->pivots.capacity < hasty->row_capacity){
+			ResizePivotRows(&hasty->pivots, hasty->row_capacity);
+		}
+		
+		// Prestep the arbiters and constraints.
+		ParallelFor(hasty, "PreStepArbiters", arbiters->num, 64, PreStepArbiters, NULL);
+		ParallelFor(hasty, "PreStepConstraints", constraints->num, 64, PreStepConstraints, NULL);
+		now = PhaseTime(); timings->preStep = now - time; time = now;
+		cpSpaceStepPhase(space, preStep);
+	
+		// Integrate velocities.
+		ParallelFor(hasty, "IntegrateVelocities", bodies->num, 64, IntegrateVelocities, NULL);
+		now = PhaseTime(); timings->integrateVelocities = now - time; time = now;
+		cpSpaceStepPhase(space, integrateVelocities);
+		
+		// Apply cached impulses and run the impulse solver.
+		hasty->dt_coef = (prev_dt == 0.0f ? 0.0f : dt/prev_dt);
+		
+		if((unsigned long)(arbiters->num + constraints->num) > hasty->constraint_count_threshold){
+			RunWorkers(hasty, "Solver", Solver);
+		} else {
+			WorkHook(hasty, "Solver", 0, cpTrue);
+			Solver(space, 0, 1);
+			WorkHook(hasty, "Solver", 0, cpFalse);
+		}
+		now = PhaseTime(); timings->solve = now - time; time = now;
+		cpSpaceStepPhase(space, solve);
+		
+		// Run the constraint post-solve callbacks
+		for(int i=0; i<constraints->num; i++){
+			cpConstraint *constraint = (cpConstraint *)constraints->arr[i];
+			
+			cpConstraintPostSolveFunc postSolve = constraint->postSolve;
+			if(postSolve) postSolve(constraint, space);
+		}
+		
+		// run the post-solve callbacks
+		for(int i=0; i<arbiters->num; i++){
+			cpArbiter *arb = (cpArbiter *) arbiters->arr[i];
+			
+			cpCollisionHandler *handler = arb->handler;
+			handler->postSolveFunc(arb, space, handler->userData);
+		}
+		
+		cpSpaceStepCount(space, postStepCallbacks, space->postStepCallbacks->num);
 	} cpSpaceUnlock(space, cpTrue);
+	
+	now = PhaseTime(); timings->postSolve = now - time;
+	timings->step = now - start;
+	cpSpaceStepPhase(space, postSolve);
+	cpSpaceEndStepStats(space);
+	space->stepAllocStats = cpAllocStatsSince(allocs);
+	cpSetAllocator(allocator);
 }
@@ -47,6 +47,10 @@ cpShapeInit(cpShape *shape, const cpShapeClass *klass, cpBody *body, struct cpSh
 	shape->filter.categories = CP_ALL_CATEGORIES;
 	shape->filter.mask = CP_ALL_CATEGORIES;
 	
+	shape->skin = 0.0f;
+	shape->adhesion = 0.0f;
+	shape->adhesionGroup = CP_NO_GROUP;
+	
 	shape->userData = NULL;
 	
 	shape->space = NULL;
@@ -207,6 +211,47 @@ cpShapeSetFilter(cpShape *shape, cpShapeFilter filter)
 	shape->filter = filter;
 }
 
+cpFloat
+cpShapeGetSkin(const cpShape *shape)
+{
+	return shape->skin;
+}
+
+void
+cpShapeSetSkin(cpShape *shape, cpFloat skin)
+{
+	cpAssertHard(skin >= 0.0f, "Skin must be positive.");
+	cpBodyActivate(shape->body);
+	shape->skin = skin;
+}
+
+cpFloat
+cpShapeGetAdhesion(const cpShape *shape)
+{
+	return shape->adhesion;
+}
+
+void
+cpShapeSetAdhesion(cpShape *shape, cpFloat adhesion)
+{
+	cpAssertHard(adhesion >= 0.0f, "Adhesion must be positive.");
+	cpBodyActivate(shape->body);
+	shape->adhesion = adhesion;
+}
+
+cpGroup
+cpShapeGetAdhesionGroup(const cpShape *shape)
+{
+	return shape->adhesionGroup;
+}
+
+void
+cpShapeSetAdhesionGroup(cpShape *shape, cpGroup group)
+{
+	cpBodyActivate(shape->body);
+	shape->adhesionGroup = group;
+}
+
 cpBB
 cpShapeCacheBB(cpShape *shape)
 {
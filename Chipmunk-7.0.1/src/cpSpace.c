@@ -36,9 +36,25 @@ arbiterSetEql(cpShape **shapes, cpArbiter *arb)
 	return ((a == arb->a && b == arb->b) || (b == arb->a && a == arb->b));
 }
 
+// Equal function for adhesionImpulses.
+static cpBool
+adhesionImpulseSetEql(cpHashValue *ids, cpAdhesionImpulse *impulse)
+{
+	cpHashValue a = ids[0];
+	cpHashValue b = ids[1];
+	
+	return ((a == impulse->a && b == impulse->b) || (b == impulse->a && a == impulse->b));
+}
+
 //MARK: Collision Handler Set HelperFunctions
 
 // Equals function for collisionHandlers.
+static cpBool
+postStepCallbackSetEql(void *key, cpPostStepCallback *callback)
+{
+	return (key == callback->key);
+}
+
 static cpBool
 handlerSetEql(cpCollisionHandler *check, cpCollisionHandler *pair)
 {
@@ -141,6 +157,7 @@ cpSpaceInit(cpSpace *space)
 	space->stamp = 0;
 	
 	space->shapeIDCounter = 0;
+	space->bodyIDCounter = 0;
 	space->staticShapes = cpBBTreeNew((cpSpatialIndexBBFunc)cpShapeGetBB, NULL);
 	space->dynamicShapes = cpBBTreeNew((cpSpatialIndexBBFunc)cpShapeGetBB, space->staticShapes);
 	cpBBTreeSetVelocityFunc(space->dynamicShapes, (cpBBTreeVelocityFunc)ShapeVelocityFunc);
@@ -167,9 +184,27 @@ cpSpaceInit(cpSpace *space)
 	memcpy(&space->defaultHandler, &cpCollisionHandlerDoNothing, sizeof(cpCollisionHandler));
 	space->collisionHandlers = cpHashSetNew(0, (cpHashSetEqlFunc)handlerSetEql);
 	
+	space->adhesionJoinFunc = NULL;
+	space->adhesionSeparateFunc = NULL;
+	space->adhesionData = NULL;
+	space->adhesionPersistence = 30;
+	space->pooledAdhesionJoints = cpArrayNew(0);
+	space->adhesionImpulses = cpHashSetNew(0, (cpHashSetEqlFunc)adhesionImpulseSetEql);
+	space->pooledAdhesionImpulses = cpArrayNew(0);
+	space->adhesionFilterStamp = 0;
+	
 	space->postStepCallbacks = cpArrayNew(0);
+	space->postStepCallbackSet = cpHashSetNew(0, (cpHashSetEqlFunc)postStepCallbackSetEql);
+	space->pooledPostStepCallbacks = cpArrayNew(0);
 	space->skipPostStep = cpFalse;
 	
+	// Everything the space allocates later comes from the same allocator.
+	space->allocator = cpGetAllocator();
+	cpAllocStats noAllocs = {0, 0, 0};
+	space->stepAllocStats = noAllocs;
+	cpSpaceStepStats noStats = {0};
+	space->stepStats = noStats;
+	
 	cpBody *staticBody = cpBodyInit(&space->_staticBody, 0.0f, 0.0f);
 	cpBodySetType(staticBody, CP_BODY_TYPE_STATIC);
 	cpSpaceSetStaticBody(space, staticBody);
@@ -188,6 +223,8 @@ static void cpBodyActivateWrap(cpBody *body, void *unused){cpBodyActivate(body);
 void
 cpSpaceDestroy(cpSpace *space)
 {
+	cpAllocator *allocator = cpSpaceUseAllocator(space);
+	
 	cpSpaceEachBody(space, (cpSpaceBodyIteratorFunc)cpBodyActivateWrap, NULL);
 	
 	cpSpatialIndexFree(space->staticShapes);
@@ -202,6 +239,11 @@ cpSpaceDestroy(cpSpace *space)
 	
 	cpHashSetFree(space->cachedArbiters);
 	
+	// The adhesion joints and impulses themselves live in the allocatedBuffers.
+	cpArrayFree(space->pooledAdhesionJoints);
+	cpHashSetFree(space->adhesionImpulses);
+	cpArrayFree(space->pooledAdhesionImpulses);
+	
 	cpArrayFree(space->arbiters);
 	cpArrayFree(space->pooledArbiters);
 	
@@ -210,21 +252,25 @@ cpSpaceDestroy(cpSpace *space)
 		cpArrayFree(space->allocatedBuffers);
 	}
 	
-	if(space->postStepCallbacks){
-		cpArrayFreeEach(space->postStepCallbacks, cpfree);
-		cpArrayFree(space->postStepCallbacks);
-	}
+	// The callbacks themselves live in the allocatedBuffers.
+	cpArrayFree(space->postStepCallbacks);
+	cpHashSetFree(space->postStepCallbackSet);
+	cpArrayFree(space->pooledPostStepCallbacks);
 	
 	if(space->collisionHandlers) cpHashSetEach(space->collisionHandlers, FreeWrap, NULL);
 	cpHashSetFree(space->collisionHandlers);
+	
+	cpSetAllocator(allocator);
 }
 
 void
 cpSpaceFree(cpSpace *space)
 {
 	if(space){
+		cpAllocator *allocator = cpSpaceUseAllocator(space);
 		cpSpaceDestroy(space);
 		cpfree(space);
+		cpSetAllocator(allocator);
 	}
 }
 
@@ -335,6 +381,36 @@ cpSpaceSetCollisionPersistence(cpSpace *space, cpTimestamp collisionPersistence)
 	space->collisionPersistence = collisionPersistence;
 }
 
+cpTimestamp
+cpSpaceGetAdhesionPersistence(const cpSpace *space)
+{
+	return space->adhesionPersistence;
+}
+
+void
+cpSpaceSetAdhesionPersistence(cpSpace *space, cpTimestamp adhesionPersistence)
+{
+	space->adhesionPersistence = adhesionPersistence;
+}
+
+cpAllocator *
+cpSpaceGetAllocator(const cpSpace *space)
+{
+	return space->allocator;
+}
+
+cpAllocStats
+cpSpaceGetStepAllocStats(const cpSpace *space)
+{
+	return space->stepAllocStats;
+}
+
+cpSpaceStepStats
+cpSpaceGetStepStats(const cpSpace *space)
+{
+	return space->stepStats;
+}
+
 cpDataPointer
 cpSpaceGetUserData(const cpSpace *space)
 {
@@ -369,6 +445,7 @@ cpSpaceSetStaticBody(cpSpace *space, cpBody *body)
 	
 	space->staticBody = body;
 	body->space = space;
+	body->hashid = space->bodyIDCounter++;
 }
 
 cpBool
@@ -397,19 +474,37 @@ cpCollisionHandler *cpSpaceAddDefaultCollisionHandler(cpSpace *space)
 
 cpCollisionHandler *cpSpaceAddCollisionHandler(cpSpace *space, cpCollisionType a, cpCollisionType b)
 {
+	cpAllocator *allocator = cpSpaceUseAllocator(space);
+	
 	cpHashValue hash = CP_HASH_PAIR(a, b);
 	cpCollisionHandler handler = {a, b, DefaultBegin, DefaultPreSolve, DefaultPostSolve, DefaultSeparate, NULL};
-	return (cpCollisionHandler*)cpHashSetInsert(space->collisionHandlers, hash, &handler, (cpHashSetTransFunc)handlerSetTrans, NULL);
+	cpCollisionHandler *result = (cpCollisionHandler*)cpHashSetInsert(space->collisionHandlers, hash, &handler, (cpHashSetTransFunc)handlerSetTrans, NULL);
+	
+	cpSetAllocator(allocator);
+	return result;
 }
 
 cpCollisionHandler *
 cpSpaceAddWildcardHandler(cpSpace *space, cpCollisionType type)
 {
+	cpAllocator *allocator = cpSpaceUseAllocator(space);
+	
 	cpSpaceUseWildcardDefaultHandler(space);
 	
 	cpHashValue hash = CP_HASH_PAIR(type, CP_WILDCARD_COLLISION_TYPE);
 	cpCollisionHandler handler = {type, CP_WILDCARD_COLLISION_TYPE, AlwaysCollide, AlwaysCollide, DoNothing, DoNothing, NULL};
-	return (cpCollisionHandler*)cpHashSetInsert(space->collisionHandlers, hash, &handler, (cpHashSetTransFunc)handlerSetTrans, NULL);
+	cpCollisionHandler *result = (cpCollisionHandler*)cpHashSetInsert(space->collisionHandlers, hash, &handler, (cpHashSetTransFunc)handlerSetTrans, NULL);
+	
+	cpSetAllocator(allocator);
+	return result;
+}
+
+void
+cpSpaceSetAdhesionFuncs(cpSpace *space, cpAdhesionFunc joinFunc, cpAdhesionFunc separateFunc, cpDataPointer userData)
+{
+	space->adhesionJoinFunc = joinFunc;
+	space->adhesionSeparateFunc = separateFunc;
+	space->adhesionData = userData;
 }
 
 
@@ -417,6 +512,8 @@ cpSpaceAddWildcardHandler(cpSpace *space, cpCollisionType type)
 cpShape *
 cpSpaceAddShape(cpSpace *space, cpShape *shape)
 {
+	cpAllocator *allocator = cpSpaceUseAllocator(space);
+	
 	cpBody *body = shape->body;
 	
 	cpAssertHard(shape->space != space, "You have already added this shape to this space. You must not add it a second time.");
@@ -432,26 +529,33 @@ cpSpaceAddShape(cpSpace *space, cpShape *shape)
 	cpShapeUpdate(shape, body->transform);
 	cpSpatialIndexInsert(isStatic ? space->staticShapes : space->dynamicShapes, shape, shape->hashid);
 	shape->space = space;
-		
+	
+	cpSetAllocator(allocator);
 	return shape;
 }
 
 cpBody *
 cpSpaceAddBody(cpSpace *space, cpBody *body)
 {
+	cpAllocator *allocator = cpSpaceUseAllocator(space);
+	
 	cpAssertHard(body->space != space, "You have already added this body to this space. You must not add it a second time.");
 	cpAssertHard(!body->space, "You have already added this body to another space. You cannot add it to a second.");
 	cpAssertSpaceUnlocked(space);
 	
-	cpArrayPush(cpSpaceArrayForBodyType(space, cpBodyGetType(body)), body);
+	cpSpacePushBody(cpSpaceArrayForBodyType(space, cpBodyGetType(body)), body);
 	body->space = space;
+	body->hashid = space->bodyIDCounter++;
 	
+	cpSetAllocator(allocator);
 	return body;
 }
 
 cpConstraint *
 cpSpaceAddConstraint(cpSpace *space, cpConstraint *constraint)
 {
+	cpAllocator *allocator = cpSpaceUseAllocator(space);
+	
 	cpAssertHard(constraint->space != space, "You have already added this constraint to this space. You must not add it a second time.");
 	cpAssertHard(!constraint->space, "You have already added this constraint to another space. You cannot add it to a second.");
 	cpAssertSpaceUnlocked(space);
@@ -462,86 +566,117 @@ cpSpaceAddConstraint(cpSpace *space, cpConstraint *constraint)
 	
 	cpBodyActivate(a);
 	cpBodyActivate(b);
-	cpArrayPush(space->constraints, constraint);
+	cpSpacePushConstraint(space->constraints, constraint);
 	
 	// Push onto the heads of the bodies' constraint lists
 	constraint->next_a = a->constraintList; a->constraintList = constraint;
 	constraint->next_b = b->constraintList; b->constraintList = constraint;
 	constraint->space = space;
 	
+	cpSetAllocator(allocator);
 	return constraint;
 }
 
-struct arbiterFilterContext {
-	cpSpace *space;
-	cpBody *body;
-	cpShape *shape;
-};
-
-static cpBool
-cachedArbitersFilter(cpArbiter *arb, struct arbiterFilterContext *context)
+// Invalidates the cached arbiters of the body, or only those of the filter shape if it's not NULL.
+// Only the body's own cached arbiter list is walked, not the whole cachedArbiters set.
+static void
+cpSpaceFilterBodyArbiters(cpSpace *space, cpBody *body, cpShape *filter)
 {
-	cpShape *shape = context->shape;
-	cpBody *body = context->body;
-	
-	
-	// Match on the filter shape, or if it's NULL the filter body
-	if(
-		(body == arb->body_a && (shape == arb->a || shape == NULL)) ||
-		(body == arb->body_b && (shape == arb->b || shape == NULL))
-	){
-		// Call separate when removing shapes.
-		if(shape && arb->state != CP_ARBITER_STATE_CACHED){
-			// Invalidate the arbiter since one of the shapes was removed.
-			arb->state = CP_ARBITER_STATE_INVALIDATED;
+	cpArbiter *arb = body->cachedArbiterList;
+	while(arb){
+		cpArbiter *next = cpArbiterCacheThreadForBody(arb, body)->next;
+		
+		if(filter == NULL || filter == arb->a || filter == arb->b){
+			// Call separate when removing shapes.
+			if(filter && arb->state != CP_ARBITER_STATE_CACHED){
+				// Invalidate the arbiter since one of the shapes was removed.
+				arb->state = CP_ARBITER_STATE_INVALIDATED;
+				
+				cpCollisionHandler *handler = arb->handler;
+				handler->separateFunc(arb, space, handler->userData);
+			}
 			
-			cpCollisionHandler *handler = arb->handler;
-			handler->separateFunc(arb, context->space, handler->userData);
+			cpSpaceReleaseAdhesion(space, arb);
+			cpArbiterUnthread(arb);
+			cpSpaceUncacheArbiter(space, arb);
+			cpArrayPush(space->pooledArbiters, arb);
 		}
 		
-		cpArbiterUnthread(arb);
-		cpArrayDeleteObj(context->space->arbiters, arb);
-		cpArrayPush(context->space->pooledArbiters, arb);
-		
-		return cpFalse;
+		arb = next;
 	}
-	
-	return cpTrue;
 }
 
 void
 cpSpaceFilterArbiters(cpSpace *space, cpBody *body, cpShape *filter)
 {
 	cpSpaceLock(space); {
-		struct arbiterFilterContext context = {space, body, filter};
-		cpHashSetFilter(space->cachedArbiters, (cpHashSetFilterFunc)cachedArbitersFilter, &context);
+		cpSpaceFilterBodyArbiters(space, body, filter);
 	} cpSpaceUnlock(space, cpTrue);
 }
 
-void
-cpSpaceRemoveShape(cpSpace *space, cpShape *shape)
+// Wake the body first, sleeping arbiters are only cached again once their body is active.
+static void
+cpSpaceActivateShapeBody(cpSpace *space, cpShape *shape)
 {
 	cpBody *body = shape->body;
 	cpAssertHard(cpSpaceContainsShape(space, shape), "Cannot remove a shape that was not added to the space. (Removed twice maybe?)");
-	cpAssertSpaceUnlocked(space);
 	
-	cpBool isStatic = (cpBodyGetType(body) == CP_BODY_TYPE_STATIC);
-	if(isStatic){
+	if(cpBodyGetType(body) == CP_BODY_TYPE_STATIC){
 		cpBodyActivateStatic(body, shape);
 	} else {
 		cpBodyActivate(body);
 	}
+}
 
+static void
+cpSpaceRemoveActiveShape(cpSpace *space, cpShape *shape)
+{
+	cpBody *body = shape->body;
+	cpBool isStatic = (cpBodyGetType(body) == CP_BODY_TYPE_STATIC);
+	
 	cpBodyRemoveShape(body, shape);
-	cpSpaceFilterArbiters(space, body, shape);
+	cpSpaceFilterBodyArbiters(space, body, shape);
 	cpSpatialIndexRemove(isStatic ? space->staticShapes : space->dynamicShapes, shape, shape->hashid);
 	shape->space = NULL;
 	shape->hashid = 0;
 }
 
+void
+cpSpaceRemoveShape(cpSpace *space, cpShape *shape)
+{
+	cpAllocator *allocator = cpSpaceUseAllocator(space);
+	
+	cpAssertSpaceUnlocked(space);
+	cpSpaceActivateShapeBody(space, shape);
+	
+	cpSpaceLock(space); {
+		cpSpaceRemoveActiveShape(space, shape);
+	} cpSpaceUnlock(space, cpTrue);
+	
+	cpSetAllocator(allocator);
+}
+
+void
+cpSpaceRemoveShapes(cpSpace *space, cpShape **shapes, int count)
+{
+	cpAllocator *allocator = cpSpaceUseAllocator(space);
+	
+	cpAssertSpaceUnlocked(space);
+	for(int i=0; i<count; i++) cpSpaceActivateShapeBody(space, shapes[i]);
+	
+	// Post-step callbacks queued by the separate callbacks run once, after the whole batch.
+	cpSpaceLock(space); {
+		for(int i=0; i<count; i++) cpSpaceRemoveActiveShape(space, shapes[i]);
+	} cpSpaceUnlock(space, cpTrue);
+	
+	cpSetAllocator(allocator);
+}
+
 void
 cpSpaceRemoveBody(cpSpace *space, cpBody *body)
 {
+	cpAllocator *allocator = cpSpaceUseAllocator(space);
+	
 	cpAssertHard(body != cpSpaceGetStaticBody(space), "Cannot remove the designated static body for the space.");
 	cpAssertHard(cpSpaceContainsBody(space, body), "Cannot remove a body that was not added to the space. (Removed twice maybe?)");
 //	cpAssertHard(body->shapeList == NULL, "Cannot remove a body from the space before removing the bodies attached to it.");
@@ -550,23 +685,29 @@ cpSpaceRemoveBody(cpSpace *space, cpBody *body)
 	
 	cpBodyActivate(body);
 //	cpSpaceFilterArbiters(space, body, NULL);
-	cpArrayDeleteObj(cpSpaceArrayForBodyType(space, cpBodyGetType(body)), body);
+	cpSpaceDeleteBody(cpSpaceArrayForBodyType(space, cpBodyGetType(body)), body);
 	body->space = NULL;
+	
+	cpSetAllocator(allocator);
 }
 
 void
 cpSpaceRemoveConstraint(cpSpace *space, cpConstraint *constraint)
 {
+	cpAllocator *allocator = cpSpaceUseAllocator(space);
+	
 	cpAssertHard(cpSpaceContainsConstraint(space, constraint), "Cannot remove a constraint that was not added to the space. (Removed twice maybe?)");
 	cpAssertSpaceUnlocked(space);
 	
 	cpBodyActivate(constraint->a);
 	cpBodyActivate(constraint->b);
-	cpArrayDeleteObj(space->constraints, constraint);
+	cpSpaceDeleteConstraint(space->constraints, constraint);
 	
 	cpBodyRemoveConstraint(constraint->a, constraint);
 	cpBodyRemoveConstraint(constraint->b, constraint);
 	constraint->space = NULL;
+	
+	cpSetAllocator(allocator);
 }
 
 cpBool cpSpaceContainsShape(cpSpace *space, cpShape *shape)
@@ -652,15 +793,21 @@ cpSpaceEachConstraint(cpSpace *space, cpSpaceConstraintIteratorFunc func, void *
 void 
 cpSpaceReindexStatic(cpSpace *space)
 {
+	cpAllocator *allocator = cpSpaceUseAllocator(space);
+	
 	cpAssertHard(!space->locked, "You cannot manually reindex objects while the space is locked. Wait until the current query or step is complete.");
 	
 	cpSpatialIndexEach(space->staticShapes, (cpSpatialIndexIteratorFunc)&cpShapeUpdateFunc, NULL);
 	cpSpatialIndexReindex(space->staticShapes);
+	
+	cpSetAllocator(allocator);
 }
 
 void
 cpSpaceReindexShape(cpSpace *space, cpShape *shape)
 {
+	cpAllocator *allocator = cpSpaceUseAllocator(space);
+	
 	cpAssertHard(!space->locked, "You cannot manually reindex objects while the space is locked. Wait until the current query or step is complete.");
 	
 	cpShapeCacheBB(shape);
@@ -668,6 +815,8 @@ cpSpaceReindexShape(cpSpace *space, cpShape *shape)
 	// attempt to rehash the shape in both hashes
 	cpSpatialIndexReindexObject(space->dynamicShapes, shape, shape->hashid);
 	cpSpatialIndexReindexObject(space->staticShapes, shape, shape->hashid);
+	
+	cpSetAllocator(allocator);
 }
 
 void
@@ -686,6 +835,8 @@ copyShapes(cpShape *shape, cpSpatialIndex *index)
 void
 cpSpaceUseSpatialHash(cpSpace *space, cpFloat dim, int count)
 {
+	cpAllocator *allocator = cpSpaceUseAllocator(space);
+	
 	cpSpatialIndex *staticShapes = cpSpaceHashNew(dim, count, (cpSpatialIndexBBFunc)cpShapeGetBB, NULL);
 	cpSpatialIndex *dynamicShapes = cpSpaceHashNew(dim, count, (cpSpatialIndexBBFunc)cpShapeGetBB, staticShapes);
 	
@@ -697,4 +848,26 @@ cpSpaceUseSpatialHash(cpSpace *space, cpFloat dim, int count)
 	
 	space->staticShapes = staticShapes;
 	space->dynamicShapes = dynamicShapes;
+	
+	cpSetAllocator(allocator);
+}
+
+void
+cpSpaceUseSpatialGrid(cpSpace *space, cpFloat dim)
+{
+	cpAllocator *allocator = cpSpaceUseAllocator(space);
+	
+	cpSpatialIndex *staticShapes = cpSpaceGridNew(dim, (cpSpatialIndexBBFunc)cpShapeGetBB, NULL);
+	cpSpatialIndex *dynamicShapes = cpSpaceGridNew(dim, (cpSpatialIndexBBFunc)cpShapeGetBB, staticShapes);
+	
+	cpSpatialIndexEach(space->staticShapes, (cpSpatialIndexIteratorFunc)copyShapes, staticShapes);
+	cpSpatialIndexEach(space->dynamicShapes, (cpSpatialIndexIteratorFunc)copyShapes, dynamicShapes);
+	
+	cpSpatialIndexFree(space->staticShapes);
+	cpSpatialIndexFree(space->dynamicShapes);
+	
+	space->staticShapes = staticShapes;
+	space->dynamicShapes = dynamicShapes;
+	
+	cpSetAllocator(allocator);
 }
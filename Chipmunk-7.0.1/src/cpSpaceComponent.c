@@ -28,6 +28,8 @@
 void
 cpSpaceActivateBody(cpSpace *space, cpBody *body)
 {
+	cpAllocator *allocator = cpSpaceUseAllocator(space);
+	
 	cpAssertHard(cpBodyGetType(body) == CP_BODY_TYPE_DYNAMIC, "Internal error: Attempting to activate a non-dynamic body.");
 		
 	if(space->locked){
@@ -35,7 +37,7 @@ cpSpaceActivateBody(cpSpace *space, cpBody *body)
 		if(!cpArrayContains(space->rousedBodies, body)) cpArrayPush(space->rousedBodies, body);
 	} else {
 		cpAssertSoft(body->sleeping.root == NULL && body->sleeping.next == NULL, "Internal error: Activating body non-NULL node pointers.");
-		cpArrayPush(space->dynamicBodies, body);
+		cpSpacePushBody(space->dynamicBodies, body);
 
 		CP_BODY_FOREACH_SHAPE(body, shape){
 			cpSpatialIndexRemove(space->staticShapes, shape, shape->hashid);
@@ -61,12 +63,13 @@ cpSpaceActivateBody(cpSpace *space, cpBody *body)
 				// Reinsert the arbiter into the arbiter cache
 				const cpShape *a = arb->a, *b = arb->b;
 				const cpShape *shape_pair[] = {a, b};
-				cpHashValue arbHashID = CP_HASH_PAIR((cpHashValue)a, (cpHashValue)b);
+				cpHashValue arbHashID = CP_HASH_PAIR(a->hashid, b->hashid);
 				cpHashSetInsert(space->cachedArbiters, arbHashID, shape_pair, NULL, arb);
+				cpArbiterCacheThread(arb);
 				
 				// Update the arbiter's state
 				arb->stamp = space->stamp;
-				cpArrayPush(space->arbiters, arb);
+				cpSpacePushArbiter(space, arb);
 				
 				cpfree(contacts);
 			}
@@ -74,17 +77,21 @@ cpSpaceActivateBody(cpSpace *space, cpBody *body)
 		
 		CP_BODY_FOREACH_CONSTRAINT(body, constraint){
 			cpBody *bodyA = constraint->a;
-			if(body == bodyA || cpBodyGetType(bodyA) == CP_BODY_TYPE_STATIC) cpArrayPush(space->constraints, constraint);
+			if(body == bodyA || cpBodyGetType(bodyA) == CP_BODY_TYPE_STATIC) cpSpacePushConstraint(space->constraints, constraint);
 		}
 	}
+	
+	cpSetAllocator(allocator);
 }
 
 static void
 cpSpaceDeactivateBody(cpSpace *space, cpBody *body)
 {
+	cpAllocator *allocator = cpSpaceUseAllocator(space);
+	
 	cpAssertHard(cpBodyGetType(body) == CP_BODY_TYPE_DYNAMIC, "Internal error: Attempting to deactivate a non-dynamic body.");
 	
-	cpArrayDeleteObj(space->dynamicBodies, body);
+	cpSpaceDeleteBody(space->dynamicBodies, body);
 	
 	CP_BODY_FOREACH_SHAPE(body, shape){
 		cpSpatialIndexRemove(space->dynamicShapes, shape, shape->hashid);
@@ -106,8 +113,10 @@ cpSpaceDeactivateBody(cpSpace *space, cpBody *body)
 		
 	CP_BODY_FOREACH_CONSTRAINT(body, constraint){
 		cpBody *bodyA = constraint->a;
-		if(body == bodyA || cpBodyGetType(bodyA) == CP_BODY_TYPE_STATIC) cpArrayDeleteObj(space->constraints, constraint);
+		if(body == bodyA || cpBodyGetType(bodyA) == CP_BODY_TYPE_STATIC) cpSpaceDeleteConstraint(space->constraints, constraint);
 	}
+	
+	cpSetAllocator(allocator);
 }
 
 static inline cpBody *
@@ -344,6 +353,4 @@ cpBodySleepWithGroup(cpBody *body, cpBody *group){
 		
 		cpArrayPush(space->sleepingComponents, body);
 	}
-	
-	cpArrayDeleteObj(space->dynamicBodies, body);
 }
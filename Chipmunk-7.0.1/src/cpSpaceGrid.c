@@ -0,0 +1,593 @@
+/* Copyright (c) 2013 Scott Lembcke and Howling Moon Software
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// Uniform grid spatial index.
+// Objects are kept in a flat array and binned into fixed size cells every reindex.
+// The (cell key, object index) entries are radix sorted so each cell is a contiguous run,
+// there are no per object or per cell heap nodes.
+
+#include <string.h>
+
+#include "chipmunk/chipmunk_private.h"
+
+static inline cpSpatialIndexClass *Klass();
+
+// Objects that cover more cells than this are tested against everything instead of being binned.
+#define MAX_OBJECT_CELLS 256
+
+// Queries with a larger BB than this just test every object.
+#define MAX_QUERY_CELLS 1024
+
+//MARK: Basic Structures
+
+typedef struct GridObject {
+	void *obj;
+	cpHashValue hashid;
+	cpBB bb;
+	// Last query that visited this object, so objects in several cells are only reported once.
+	cpTimestamp stamp;
+	// Covers too many cells to bin, it's in the large list instead.
+	cpBool large;
+} GridObject;
+
+struct cpSpaceGrid {
+	cpSpatialIndex spatialIndex;
+
+	cpFloat celldim;
+
+	int num, max;
+	GridObject *objects;
+
+	// Open addressed hashid -> object index table, -1 marks an empty slot.
+	int *table;
+	int tableMask;
+
+	// Sorted (key << 32 | object index) entries, and the scratch buffer for the radix sort.
+	int numEntries, maxEntries;
+	uint64_t *entries, *sortBuffer;
+
+	// Indexes of objects too big to bin.
+	int numLarge, maxLarge;
+	int *large;
+
+	// Objects were added, removed or moved since the entries were built.
+	cpBool dirty;
+	cpTimestamp stamp;
+};
+
+static inline int
+floor_int(cpFloat f)
+{
+	int i = (int)f;
+	return (f < 0.0f && f != i ? i - 1 : i);
+}
+
+// Number of cells covered by a BB, done in floating point so huge or infinite BBs don't overflow.
+static inline cpFloat
+CellCount(cpBB bb, cpFloat dim)
+{
+	cpFloat cells = (cpffloor(bb.r/dim) - cpffloor(bb.l/dim) + 1.0f)*(cpffloor(bb.t/dim) - cpffloor(bb.b/dim) + 1.0f);
+	return (cells == cells ? cells : INFINITY);
+}
+
+// Cells wrap every 65536 cells on each axis, far apart objects that share a key only cost a BB test.
+static inline uint32_t
+CellKey(int x, int y)
+{
+	return ((uint32_t)y & 0xFFFF) << 16 | ((uint32_t)x & 0xFFFF);
+}
+
+static inline uint32_t
+EntryKey(uint64_t entry)
+{
+	return (uint32_t)(entry >> 32);
+}
+
+static inline int
+EntryIndex(uint64_t entry)
+{
+	return (int)(uint32_t)entry;
+}
+
+//MARK: Object Table
+
+static inline int
+TableSlot(cpSpaceGrid *grid, cpHashValue hashid)
+{
+	int mask = grid->tableMask;
+	int slot = (int)((hashid*CP_HASH_COEF) & mask);
+
+	for(int index = grid->table[slot]; index >= 0 && grid->objects[index].hashid != hashid; index = grid->table[slot]){
+		slot = (slot + 1) & mask;
+	}
+
+	return slot;
+}
+
+static void
+TableRemoveSlot(cpSpaceGrid *grid, int slot)
+{
+	int *table = grid->table;
+	int mask = grid->tableMask;
+
+	// Backward shift deletion keeps the probe sequences intact without tombstones.
+	for(int next = (slot + 1) & mask; table[next] >= 0; next = (next + 1) & mask){
+		int home = (int)((grid->objects[table[next]].hashid*CP_HASH_COEF) & mask);
+		if(((next - home) & mask) >= ((next - slot) & mask)){
+			table[slot] = table[next];
+			slot = next;
+		}
+	}
+
+	table[slot] = -1;
+}
+
+static void
+TableResize(cpSpaceGrid *grid, int size)
+{
+	cpfree(grid->table);
+	grid->table = (int *)cpcalloc(size, sizeof(int));
+	grid->tableMask = size - 1;
+
+	for(int i=0; i<size; i++) grid->table[i] = -1;
+	for(int i=0; i<grid->num; i++) grid->table[TableSlot(grid, grid->objects[i].hashid)] = i;
+}
+
+//MARK: Memory Management Functions
+
+cpSpaceGrid *
+cpSpaceGridAlloc(void)
+{
+	return (cpSpaceGrid *)cpcalloc(1, sizeof(cpSpaceGrid));
+}
+
+cpSpatialIndex *
+cpSpaceGridInit(cpSpaceGrid *grid, cpFloat celldim, cpSpatialIndexBBFunc bbfunc, cpSpatialIndex *staticIndex)
+{
+	cpSpatialIndexInit((cpSpatialIndex *)grid, Klass(), bbfunc, staticIndex);
+
+	grid->celldim = celldim;
+
+	grid->num = 0;
+	grid->max = 32;
+	grid->objects = (GridObject *)cpcalloc(grid->max, sizeof(GridObject));
+	TableResize(grid, 64);
+
+	grid->dirty = cpTrue;
+	grid->stamp = 1;
+
+	return (cpSpatialIndex *)grid;
+}
+
+cpSpatialIndex *
+cpSpaceGridNew(cpFloat celldim, cpSpatialIndexBBFunc bbfunc, cpSpatialIndex *staticIndex)
+{
+	return cpSpaceGridInit(cpSpaceGridAlloc(), celldim, bbfunc, staticIndex);
+}
+
+static void
+cpSpaceGridDestroy(cpSpaceGrid *grid)
+{
+	cpfree(grid->objects);
+	cpfree(grid->table);
+	cpfree(grid->entries);
+	cpfree(grid->sortBuffer);
+	cpfree(grid->large);
+
+	grid->objects = NULL;
+	grid->table = NULL;
+	grid->entries = grid->sortBuffer = NULL;
+	grid->large = NULL;
+}
+
+//MARK: Misc
+
+static int
+cpSpaceGridCount(cpSpaceGrid *grid)
+{
+	return grid->num;
+}
+
+static void
+cpSpaceGridEach(cpSpaceGrid *grid, cpSpatialIndexIteratorFunc func, void *data)
+{
+	GridObject *objects = grid->objects;
+	for(int i=0, count=grid->num; i<count; i++) func(objects[i].obj, data);
+}
+
+static cpBool
+cpSpaceGridContains(cpSpaceGrid *grid, void *obj, cpHashValue hashid)
+{
+	int index = grid->table[TableSlot(grid, hashid)];
+	return (index >= 0 && grid->objects[index].obj == obj);
+}
+
+void
+cpSpaceGridResize(cpSpaceGrid *grid, cpFloat celldim)
+{
+	if(grid->spatialIndex.klass != Klass()){
+		cpAssertWarn(cpFalse, "Ignoring cpSpaceGridResize() call to non-cpSpaceGrid spatial index.");
+		return;
+	}
+
+	grid->celldim = celldim;
+	grid->dirty = cpTrue;
+}
+
+//MARK: Basic Operations
+
+static void
+cpSpaceGridInsert(cpSpaceGrid *grid, void *obj, cpHashValue hashid)
+{
+	cpAssertSoft(!cpSpaceGridContains(grid, obj, hashid), "Object is already in the spatial index.");
+
+	if(grid->num == grid->max){
+		grid->max *= 2;
+		grid->objects = (GridObject *)cprealloc(grid->objects, grid->max*sizeof(GridObject));
+	}
+
+	GridObject *object = grid->objects + grid->num;
+	object->obj = obj;
+	object->hashid = hashid;
+	object->bb = grid->spatialIndex.bbfunc(obj);
+	object->stamp = 0;
+	object->large = cpFalse;
+
+	grid->table[TableSlot(grid, hashid)] = grid->num;
+	grid->num++;
+
+	// Keep the table at most half full.
+	if(grid->num*2 > grid->tableMask + 1) TableResize(grid, (grid->tableMask + 1)*2);
+
+	grid->dirty = cpTrue;
+}
+
+static void
+cpSpaceGridRemove(cpSpaceGrid *grid, void *obj, cpHashValue hashid)
+{
+	int slot = TableSlot(grid, hashid);
+	int index = grid->table[slot];
+	if(index < 0 || grid->objects[index].obj != obj) return;
+
+	TableRemoveSlot(grid, slot);
+
+	// Move the last object into the hole.
+	int last = --grid->num;
+	if(index != last){
+		grid->objects[index] = grid->objects[last];
+		grid->table[TableSlot(grid, grid->objects[index].hashid)] = index;
+	}
+
+	grid->dirty = cpTrue;
+}
+
+//MARK: Reindexing Functions
+
+static inline void
+PushEntry(cpSpaceGrid *grid, uint32_t key, int index)
+{
+	if(grid->numEntries == grid->maxEntries){
+		grid->maxEntries = (grid->maxEntries ? grid->maxEntries*2 : 256);
+		grid->entries = (uint64_t *)cprealloc(grid->entries, grid->maxEntries*sizeof(uint64_t));
+		grid->sortBuffer = (uint64_t *)cprealloc(grid->sortBuffer, grid->maxEntries*sizeof(uint64_t));
+	}
+
+	grid->entries[grid->numEntries++] = (uint64_t)key << 32 | (uint32_t)index;
+}
+
+static inline void
+PushLarge(cpSpaceGrid *grid, int index)
+{
+	if(grid->numLarge == grid->maxLarge){
+		grid->maxLarge = (grid->maxLarge ? grid->maxLarge*2 : 16);
+		grid->large = (int *)cprealloc(grid->large, grid->maxLarge*sizeof(int));
+	}
+
+	grid->large[grid->numLarge++] = index;
+}
+
+// LSD radix sort on the key half of the entries, 8 bits per pass.
+// It's stable, so entries of the same cell stay in object order.
+static void
+SortEntries(cpSpaceGrid *grid)
+{
+	int count = grid->numEntries;
+	uint64_t *src = grid->entries, *dst = grid->sortBuffer;
+
+	int histogram[4][256];
+	memset(histogram, 0, sizeof(histogram));
+
+	for(int i=0; i<count; i++){
+		uint32_t key = EntryKey(src[i]);
+		for(int pass=0; pass<4; pass++) histogram[pass][(key >> (8*pass)) & 0xFF]++;
+	}
+
+	for(int pass=0; pass<4; pass++){
+		int *counts = histogram[pass];
+
+		// Every entry has the same digit, the pass would just copy.
+		if(counts[(EntryKey(src[0]) >> (8*pass)) & 0xFF] == count) continue;
+
+		for(int digit=0, sum=0; digit<256; digit++){
+			int n = counts[digit];
+			counts[digit] = sum;
+			sum += n;
+		}
+
+		for(int i=0; i<count; i++){
+			uint64_t entry = src[i];
+			dst[counts[(EntryKey(entry) >> (8*pass)) & 0xFF]++] = entry;
+		}
+
+		uint64_t *temp = src; src = dst; dst = temp;
+	}
+
+	grid->entries = src;
+	grid->sortBuffer = dst;
+}
+
+// Refreshes the BBs and rebuilds the sorted cell entries.
+static void
+Rebuild(cpSpaceGrid *grid)
+{
+	cpFloat dim = grid->celldim;
+	cpSpatialIndexBBFunc bbfunc = grid->spatialIndex.bbfunc;
+
+	grid->numEntries = 0;
+	grid->numLarge = 0;
+
+	for(int i=0; i<grid->num; i++){
+		GridObject *object = grid->objects + i;
+		cpBB bb = object->bb = bbfunc(object->obj);
+
+		object->large = (CellCount(bb, dim) > MAX_OBJECT_CELLS);
+		if(object->large){
+			PushLarge(grid, i);
+			continue;
+		}
+
+		int l = floor_int(bb.l/dim), r = floor_int(bb.r/dim);
+		int b = floor_int(bb.b/dim), t = floor_int(bb.t/dim);
+
+		for(int y=b; y<=t; y++){
+			for(int x=l; x<=r; x++) PushEntry(grid, CellKey(x, y), i);
+		}
+	}
+
+	if(grid->numEntries > 0) SortEntries(grid);
+	grid->dirty = cpFalse;
+}
+
+static void
+cpSpaceGridReindexObject(cpSpaceGrid *grid, void *obj, cpHashValue hashid)
+{
+	grid->dirty = cpTrue;
+}
+
+static void
+cpSpaceGridReindex(cpSpaceGrid *grid)
+{
+	Rebuild(grid);
+}
+
+//MARK: Query Functions
+
+// First entry with a key >= the given key.
+static inline int
+LowerBound(cpSpaceGrid *grid, uint32_t key)
+{
+	uint64_t *entries = grid->entries;
+	int lo = 0, hi = grid->numEntries;
+
+	while(lo < hi){
+		int mid = (lo + hi)/2;
+		if(EntryKey(entries[mid]) < key) lo = mid + 1; else hi = mid;
+	}
+
+	return lo;
+}
+
+static inline void
+QueryObject(cpSpaceGrid *grid, GridObject *object, void *obj, cpBB bb, cpSpatialIndexQueryFunc func, void *data)
+{
+	if(object->stamp != grid->stamp){
+		object->stamp = grid->stamp;
+		if(object->obj != obj && cpBBIntersects(bb, object->bb)) func(obj, object->obj, 0, data);
+	}
+}
+
+static void
+cpSpaceGridQuery(cpSpaceGrid *grid, void *obj, cpBB bb, cpSpatialIndexQueryFunc func, void *data)
+{
+	if(grid->dirty) Rebuild(grid);
+	grid->stamp++;
+
+	GridObject *objects = grid->objects;
+	cpFloat dim = grid->celldim;
+
+	if(CellCount(bb, dim) > MAX_QUERY_CELLS){
+		for(int i=0; i<grid->num; i++) QueryObject(grid, objects + i, obj, bb, func, data);
+		return;
+	}
+
+	int l = floor_int(bb.l/dim), r = floor_int(bb.r/dim);
+	int b = floor_int(bb.b/dim), t = floor_int(bb.t/dim);
+
+	for(int i=0; i<grid->numLarge; i++) QueryObject(grid, objects + grid->large[i], obj, bb, func, data);
+
+	uint64_t *entries = grid->entries;
+	int count = grid->numEntries;
+
+	for(int y=b; y<=t; y++){
+		for(int x=l; x<=r; x++){
+			uint32_t key = CellKey(x, y);
+			for(int i=LowerBound(grid, key); i<count && EntryKey(entries[i]) == key; i++){
+				QueryObject(grid, objects + EntryIndex(entries[i]), obj, bb, func, data);
+			}
+		}
+	}
+}
+
+static inline cpFloat
+SegmentQueryCell(cpSpaceGrid *grid, uint32_t key, void *obj, cpSpatialIndexSegmentQueryFunc func, void *data)
+{
+	uint64_t *entries = grid->entries;
+	int count = grid->numEntries;
+	cpFloat t = 1.0f;
+
+	for(int i=LowerBound(grid, key); i<count && EntryKey(entries[i]) == key; i++){
+		GridObject *object = grid->objects + EntryIndex(entries[i]);
+		if(object->stamp != grid->stamp){
+			object->stamp = grid->stamp;
+			t = cpfmin(t, func(obj, object->obj, data));
+		}
+	}
+
+	return t;
+}
+
+// Same grid walk as cpSpaceHash, modified from http://playtechs.blogspot.com/2007/03/raytracing-on-grid.html
+static void
+cpSpaceGridSegmentQuery(cpSpaceGrid *grid, void *obj, cpVect a, cpVect b, cpFloat t_exit, cpSpatialIndexSegmentQueryFunc func, void *data)
+{
+	if(grid->dirty) Rebuild(grid);
+	grid->stamp++;
+
+	for(int i=0; i<grid->numLarge; i++){
+		GridObject *object = grid->objects + grid->large[i];
+		object->stamp = grid->stamp;
+		t_exit = cpfmin(t_exit, func(obj, object->obj, data));
+	}
+
+	a = cpvmult(a, 1.0f/grid->celldim);
+	b = cpvmult(b, 1.0f/grid->celldim);
+
+	int cell_x = floor_int(a.x), cell_y = floor_int(a.y);
+
+	cpFloat t = 0;
+
+	int x_inc, y_inc;
+	cpFloat temp_v, temp_h;
+
+	if (b.x > a.x){
+		x_inc = 1;
+		temp_h = (cpffloor(a.x + 1.0f) - a.x);
+	} else {
+		x_inc = -1;
+		temp_h = (a.x - cpffloor(a.x));
+	}
+
+	if (b.y > a.y){
+		y_inc = 1;
+		temp_v = (cpffloor(a.y + 1.0f) - a.y);
+	} else {
+		y_inc = -1;
+		temp_v = (a.y - cpffloor(a.y));
+	}
+
+	cpFloat dx = cpfabs(b.x - a.x), dy = cpfabs(b.y - a.y);
+	cpFloat dt_dx = (dx ? 1.0f/dx : INFINITY), dt_dy = (dy ? 1.0f/dy : INFINITY);
+
+	// fix NANs in horizontal directions
+	cpFloat next_h = (temp_h ? temp_h*dt_dx : dt_dx);
+	cpFloat next_v = (temp_v ? temp_v*dt_dy : dt_dy);
+
+	while(t < t_exit){
+		t_exit = cpfmin(t_exit, SegmentQueryCell(grid, CellKey(cell_x, cell_y), obj, func, data));
+
+		if (next_v < next_h){
+			cell_y += y_inc;
+			t = next_v;
+			next_v += dt_dy;
+		} else {
+			cell_x += x_inc;
+			t = next_h;
+			next_h += dt_dx;
+		}
+	}
+}
+
+//MARK: Reindex/Query
+
+static void
+cpSpaceGridReindexQuery(cpSpaceGrid *grid, cpSpatialIndexQueryFunc func, void *data)
+{
+	Rebuild(grid);
+
+	GridObject *objects = grid->objects;
+	uint64_t *entries = grid->entries;
+	int count = grid->numEntries;
+	cpFloat dim = grid->celldim;
+
+	for(int start=0, end; start<count; start=end){
+		uint32_t key = EntryKey(entries[start]);
+		for(end = start + 1; end<count && EntryKey(entries[end]) == key; end++);
+
+		for(int i=start; i<end; i++){
+			GridObject *a = objects + EntryIndex(entries[i]);
+
+			for(int j=i+1; j<end; j++){
+				GridObject *b = objects + EntryIndex(entries[j]);
+				if(!cpBBIntersects(a->bb, b->bb)) continue;
+
+				// Pairs that share several cells are only reported from the cell holding the min corner of their overlap.
+				int x = floor_int(cpfmax(a->bb.l, b->bb.l)/dim);
+				int y = floor_int(cpfmax(a->bb.b, b->bb.b)/dim);
+				if(CellKey(x, y) == key) func(a->obj, b->obj, 0, data);
+			}
+		}
+	}
+
+	// Large objects against everything, including the other large objects once.
+	for(int i=0; i<grid->numLarge; i++){
+		int index = grid->large[i];
+		GridObject *a = objects + index;
+
+		for(int j=0; j<grid->num; j++){
+			GridObject *b = objects + j;
+			if(b->large && j <= index) continue;
+
+			if(cpBBIntersects(a->bb, b->bb)) func(a->obj, b->obj, 0, data);
+		}
+	}
+
+	cpSpatialIndexCollideStatic((cpSpatialIndex *)grid, grid->spatialIndex.staticIndex, func, data);
+}
+
+static cpSpatialIndexClass klass = {
+	(cpSpatialIndexDestroyImpl)cpSpaceGridDestroy,
+
+	(cpSpatialIndexCountImpl)cpSpaceGridCount,
+	(cpSpatialIndexEachImpl)cpSpaceGridEach,
+	(cpSpatialIndexContainsImpl)cpSpaceGridContains,
+
+	(cpSpatialIndexInsertImpl)cpSpaceGridInsert,
+	(cpSpatialIndexRemoveImpl)cpSpaceGridRemove,
+
+	(cpSpatialIndexReindexImpl)cpSpaceGridReindex,
+	(cpSpatialIndexReindexObjectImpl)cpSpaceGridReindexObject,
+	(cpSpatialIndexReindexQueryImpl)cpSpaceGridReindexQuery,
+
+	(cpSpatialIndexQueryImpl)cpSpaceGridQuery,
+	(cpSpatialIndexSegmentQueryImpl)cpSpaceGridSegmentQuery,
+};
+
+static inline cpSpatialIndexClass *Klass(){return &klass;}
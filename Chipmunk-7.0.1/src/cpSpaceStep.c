@@ -26,13 +26,24 @@
 cpPostStepCallback *
 cpSpaceGetPostStepCallback(cpSpace *space, void *key)
 {
-	cpArray *arr = space->postStepCallbacks;
-	for(int i=0; i<arr->num; i++){
-		cpPostStepCallback *callback = (cpPostStepCallback *)arr->arr[i];
-		if(callback && callback->key == key) return callback;
+	return (cpPostStepCallback *)cpHashSetFind(space->postStepCallbackSet, CP_POST_STEP_HASH(key), key);
+}
+
+static cpPostStepCallback *
+cpSpaceAllocPostStepCallback(cpSpace *space)
+{
+	if(space->pooledPostStepCallbacks->num == 0){
+		// callback pool is exhausted, make more
+		int count = CP_BUFFER_BYTES/sizeof(cpPostStepCallback);
+		cpAssertHard(count, "Internal Error: Buffer size too small.");
+		
+		cpPostStepCallback *buffer = (cpPostStepCallback *)cpcalloc(1, CP_BUFFER_BYTES);
+		cpArrayPush(space->allocatedBuffers, buffer);
+		
+		for(int i=0; i<count; i++) cpArrayPush(space->pooledPostStepCallbacks, buffer + i);
 	}
 	
-	return NULL;
+	return (cpPostStepCallback *)cpArrayPop(space->pooledPostStepCallbacks);
 }
 
 static void PostStepDoNothing(cpSpace *space, void *obj, void *data){}
@@ -44,13 +55,19 @@ cpSpaceAddPostStepCallback(cpSpace *space, cpPostStepFunc func, void *key, void
 		"Adding a post-step callback when the space is not locked is unnecessary. "
 		"Post-step callbacks will not called until the end of the next call to cpSpaceStep() or the next query.");
 	
-	if(!cpSpaceGetPostStepCallback(space, key)){
-		cpPostStepCallback *callback = (cpPostStepCallback *)cpcalloc(1, sizeof(cpPostStepCallback));
+	cpHashValue hash = CP_POST_STEP_HASH(key);
+	if(!cpHashSetFind(space->postStepCallbackSet, hash, key)){
+		cpAllocator *allocator = cpSpaceUseAllocator(space);
+		
+		cpPostStepCallback *callback = cpSpaceAllocPostStepCallback(space);
 		callback->func = (func ? func : PostStepDoNothing);
 		callback->key = key;
 		callback->data = data;
 		
+		cpHashSetInsert(space->postStepCallbackSet, hash, key, NULL, callback);
 		cpArrayPush(space->postStepCallbacks, callback);
+		
+		cpSetAllocator(allocator);
 		return cpTrue;
 	} else {
 		return cpFalse;
@@ -94,8 +111,10 @@ cpSpaceUnlock(cpSpace *space, cpBool runPostStep)
 				callback->func = NULL;
 				if(func) func(space, callback->key, callback->data);
 				
+				// The key can be registered again once its callback has run.
 				arr->arr[i] = NULL;
-				cpfree(callback);
+				cpHashSetRemove(space->postStepCallbackSet, CP_POST_STEP_HASH(callback->key), callback->key);
+				cpArrayPush(space->pooledPostStepCallbacks, callback);
 			}
 			
 			arr->num = 0;
@@ -184,21 +203,31 @@ cpSpacePopContacts(cpSpace *space, int count){
 
 //MARK: Collision Detection Functions
 
+static int
+cpSpaceGrowArbiterPool(cpSpace *space)
+{
+	int count = CP_BUFFER_BYTES/sizeof(cpArbiter);
+	cpAssertHard(count, "Internal Error: Buffer size too small.");
+	
+	cpArbiter *buffer = (cpArbiter *)cpcalloc(1, CP_BUFFER_BYTES);
+	cpArrayPush(space->allocatedBuffers, buffer);
+	
+	// Room for every item handed out so far, returning them to the pool never grows it.
+	cpArrayReserve(space->pooledArbiters, space->pooledArbiters->max + count);
+	for(int i=0; i<count; i++) cpArrayPush(space->pooledArbiters, buffer + i);
+	
+	return count;
+}
+
 static void *
 cpSpaceArbiterSetTrans(cpShape **shapes, cpSpace *space)
 {
-	if(space->pooledArbiters->num == 0){
-		// arbiter pool is exhausted, make more
-		int count = CP_BUFFER_BYTES/sizeof(cpArbiter);
-		cpAssertHard(count, "Internal Error: Buffer size too small.");
-		
-		cpArbiter *buffer = (cpArbiter *)cpcalloc(1, CP_BUFFER_BYTES);
-		cpArrayPush(space->allocatedBuffers, buffer);
-		
-		for(int i=0; i<count; i++) cpArrayPush(space->pooledArbiters, buffer + i);
-	}
+	// arbiter pool is exhausted, make more
+	if(space->pooledArbiters->num == 0) cpSpaceGrowArbiterPool(space);
 	
-	return cpArbiterInit((cpArbiter *)cpArrayPop(space->pooledArbiters), shapes[0], shapes[1]);
+	cpArbiter *arb = cpArbiterInit((cpArbiter *)cpArrayPop(space->pooledArbiters), shapes[0], shapes[1]);
+	cpArbiterCacheThread(arb);
+	return arb;
 }
 
 static inline cpBool
@@ -231,25 +260,239 @@ QueryReject(cpShape *a, cpShape *b)
 	);
 }
 
-// Callback from the spatial hash.
-cpCollisionID
-cpSpaceCollideShapes(cpShape *a, cpShape *b, cpCollisionID id, cpSpace *space)
+cpBool
+cpSpaceShapeQueryReject(cpShape *a, cpShape *b)
 {
-	// Reject any of the simple cases
-	if(QueryReject(a,b)) return id;
+	return QueryReject(a, b);
+}
+
+//MARK: Adhesion Functions
+
+static inline cpBool
+cpShapesAdhere(const cpShape *a, const cpShape *b)
+{
+	return (a->adhesion > 0.0f && b->adhesion > 0.0f && a->adhesionGroup == b->adhesionGroup);
+}
+
+// Joints come in buffers like the arbiters, so a blob fight reaching a new peak doesn't allocate for every joint.
+static int
+cpSpaceGrowAdhesionJointPool(cpSpace *space)
+{
+	int count = CP_BUFFER_BYTES/sizeof(cpPivotJoint);
+	cpAssertHard(count, "Internal Error: Buffer size too small.");
 	
-	// Narrow-phase collision detection.
-	struct cpCollisionInfo info = cpCollide(a, b, id, cpContactBufferGetArray(space));
+	cpPivotJoint *buffer = (cpPivotJoint *)cpcalloc(1, CP_BUFFER_BYTES);
+	cpArrayPush(space->allocatedBuffers, buffer);
+	
+	cpArrayReserve(space->pooledAdhesionJoints, space->pooledAdhesionJoints->max + count);
+	for(int i=0; i<count; i++) cpArrayPush(space->pooledAdhesionJoints, buffer + i);
+	
+	return count;
+}
+
+// Pins the arbiter's bodies together at the first contact once the shapes overlap.
+// Called from the collision pass, so the joint is added in place instead of from a post-step callback.
+static void
+cpSpaceAdhere(cpSpace *space, cpArbiter *arb)
+{
+	const cpShape *a = arb->a, *b = arb->b;
+	cpBody *body_a = arb->body_a, *body_b = arb->body_b;
+	
+	// The contacts are already sunk by the skins, undo that to measure the real overlap.
+	cpFloat skin = a->skin + b->skin;
+	cpFloat deepest = INFINITY;
+	for(int i=0; i<arb->count; i++){
+		struct cpContact *con = &arb->contacts[i];
+		cpVect delta = cpvsub(cpvadd(body_b->p, con->r2), cpvadd(body_a->p, con->r1));
+		deepest = cpfmin(deepest, cpvdot(delta, arb->n) - skin);
+	}
+	if(deepest > 0.0f) return;
+	
+	struct cpContact *con = &arb->contacts[0];
+	cpVect anchorA = cpBodyWorldToLocal(body_a, cpvadd(body_a->p, con->r1));
+	cpVect anchorB = cpBodyWorldToLocal(body_b, cpvadd(body_b->p, con->r2));
+	if(space->pooledAdhesionJoints->num == 0) cpSpaceGrowAdhesionJointPool(space);
+	cpPivotJoint *pivot = (cpPivotJoint *)cpArrayPop(space->pooledAdhesionJoints);
+	cpConstraint *joint = (cpConstraint *)cpPivotJointInit(pivot, body_a, body_b, anchorA, anchorB);
+	cpConstraintSetMaxForce(joint, cpfmin(a->adhesion, b->adhesion));
+	joint->userData = NULL;
+	
+	// Warm start from the last joint of these bodies if they only just came apart.
+	// Timed out impulses are only dropped every so often, so check the stamp here.
+	cpHashValue ids[] = {body_a->hashid, body_b->hashid};
+	cpAdhesionImpulse *impulse = (cpAdhesionImpulse *)cpHashSetRemove(space->adhesionImpulses, CP_HASH_PAIR(ids[0], ids[1]), ids);
+	if(impulse){
+		if(space->stamp - impulse->stamp <= space->adhesionPersistence){
+			pivot->jAcc = (impulse->a == ids[0] ? impulse->jAcc : cpvneg(impulse->jAcc));
+		}
+		
+		cpArrayPush(space->pooledAdhesionImpulses, impulse);
+	}
+	
+	// Same as cpSpaceAddConstraint(), the bodies are awake since they are colliding.
+	cpSpacePushConstraint(space->constraints, joint);
+	joint->next_a = body_a->constraintList; body_a->constraintList = joint;
+	joint->next_b = body_b->constraintList; body_b->constraintList = joint;
+	joint->space = space;
+	arb->joint = joint;
+	
+	if(space->adhesionJoinFunc) space->adhesionJoinFunc(space, joint, space->adhesionData);
+}
+
+static int
+cpSpaceGrowAdhesionImpulsePool(cpSpace *space)
+{
+	int count = CP_BUFFER_BYTES/sizeof(cpAdhesionImpulse);
+	cpAssertHard(count, "Internal Error: Buffer size too small.");
+	
+	cpAdhesionImpulse *buffer = (cpAdhesionImpulse *)cpcalloc(1, CP_BUFFER_BYTES);
+	cpArrayPush(space->allocatedBuffers, buffer);
+	
+	cpArrayReserve(space->pooledAdhesionImpulses, space->pooledAdhesionImpulses->max + count);
+	for(int i=0; i<count; i++) cpArrayPush(space->pooledAdhesionImpulses, buffer + i);
+	
+	return count;
+}
+
+static void *
+cpSpaceAdhesionImpulseSetTrans(cpHashValue *ids, cpSpace *space)
+{
+	// impulse pool is exhausted, make more
+	if(space->pooledAdhesionImpulses->num == 0) cpSpaceGrowAdhesionImpulsePool(space);
+	
+	cpAdhesionImpulse *impulse = (cpAdhesionImpulse *)cpArrayPop(space->pooledAdhesionImpulses);
+	impulse->a = ids[0];
+	impulse->b = ids[1];
+	return impulse;
+}
+
+// Removes the adhesion joint of a separated arbiter and returns it to the pool.
+// Only done outside of the solver, so it's taken out right away instead of being disabled until a post-step callback.
+void
+cpSpaceReleaseAdhesion(cpSpace *space, cpArbiter *arb)
+{
+	cpConstraint *joint = arb->joint;
+	if(joint == NULL) return;
+	
+	if(space->adhesionSeparateFunc) space->adhesionSeparateFunc(space, joint, space->adhesionData);
 	
-	if(info.count == 0) return info.id; // Shapes are not colliding.
-	cpSpacePushContacts(space, info.count);
+	cpSpaceDeleteConstraint(space->constraints, joint);
+	cpBodyRemoveConstraint(joint->a, joint);
+	cpBodyRemoveConstraint(joint->b, joint);
+	joint->space = NULL;
+	arb->joint = NULL;
+	
+	// Remember the impulse in case the bodies stick together again shortly.
+	// Not when a shape was removed, its contact won't come back.
+	if(arb->state != CP_ARBITER_STATE_INVALIDATED){
+		cpHashValue ids[] = {joint->a->hashid, joint->b->hashid};
+		cpAdhesionImpulse *impulse = (cpAdhesionImpulse *)cpHashSetInsert(space->adhesionImpulses, CP_HASH_PAIR(ids[0], ids[1]), ids, (cpHashSetTransFunc)cpSpaceAdhesionImpulseSetTrans, space);
+		impulse->a = ids[0];
+		impulse->b = ids[1];
+		impulse->jAcc = ((cpPivotJoint *)joint)->jAcc;
+		impulse->stamp = space->stamp;
+	}
+	
+	cpArrayPush(space->pooledAdhesionJoints, joint);
+}
+
+static cpBool
+AdhesionImpulseFilter(cpAdhesionImpulse *impulse, cpSpace *space)
+{
+	if(space->stamp - impulse->stamp <= space->adhesionPersistence) return cpTrue;
+	
+	cpArrayPush(space->pooledAdhesionImpulses, impulse);
+	return cpFalse;
+}
+
+// Drops the remembered impulses that timed out, those of removed bodies included.
+// Runs once every adhesionPersistence steps, so each impulse is visited at most twice.
+void
+cpSpaceFilterAdhesionImpulses(cpSpace *space)
+{
+	if(space->stamp - space->adhesionFilterStamp <= space->adhesionPersistence) return;
+	space->adhesionFilterStamp = space->stamp;
+	
+	if(cpHashSetCount(space->adhesionImpulses) == 0) return;
+	cpHashSetFilter(space->adhesionImpulses, (cpHashSetFilterFunc)AdhesionImpulseFilter, space);
+}
+
+static void
+CountAdhesionJoint(cpArbiter *arb, int *count)
+{
+	if(arb->joint) (*count)++;
+}
+
+void
+cpSpaceReserve(cpSpace *space, int arbiters, int contacts, int joints)
+{
+	cpAllocator *allocator = cpSpaceUseAllocator(space);
+	
+	cpAssertSpaceUnlocked(space);
+	
+	// Arbiters, both the ones in use and the pooled ones count.
+	int arbiterCount = space->pooledArbiters->num + cpHashSetCount(space->cachedArbiters);
+	while(arbiterCount < arbiters) arbiterCount += cpSpaceGrowArbiterPool(space);
+	cpHashSetReserve(space->cachedArbiters, arbiters);
+	cpArrayReserve(space->arbiters, arbiters);
+	// The tree also caches the pairs whose fattened bounding boxes only overlap.
+	cpBBTreeReservePairs(space->dynamicShapes, 2*arbiters);
+	
+	// The contact ring holds the buffers of the last collisionPersistence steps and the current one.
+	// Spare buffers get a stamp that is already old enough to be reused by the next step.
+	int perStep = contacts/(int)(CP_CONTACTS_BUFFER_SIZE - CP_MAX_CONTACTS_PER_ARBITER + 1) + 1;
+	int buffers = perStep*(int)(space->collisionPersistence + 1);
+	cpTimestamp spareStamp = space->stamp - space->collisionPersistence - 1;
+	
+	cpContactBufferHeader *head = space->contactBuffersHead;
+	int ringCount = 0;
+	if(head){
+		cpContactBufferHeader *buffer = head;
+		do { ringCount++; buffer = buffer->next; } while(buffer != head);
+	} else {
+		head = space->contactBuffersHead = cpContactBufferHeaderInit(cpSpaceAllocContactBuffer(space), spareStamp, NULL);
+		ringCount = 1;
+	}
+	
+	for(; ringCount < buffers; ringCount++){
+		head->next = cpContactBufferHeaderInit(cpSpaceAllocContactBuffer(space), spareStamp, head);
+	}
+	
+	// Adhesion joints and the impulses they leave behind.
+	int liveJoints = 0;
+	cpHashSetEach(space->cachedArbiters, (cpHashSetIteratorFunc)CountAdhesionJoint, &liveJoints);
+	
+	int jointCount = space->pooledAdhesionJoints->num + liveJoints;
+	while(jointCount < joints) jointCount += cpSpaceGrowAdhesionJointPool(space);
+	cpArrayReserve(space->constraints, space->constraints->num - liveJoints + joints);
+	
+	int impulseCount = space->pooledAdhesionImpulses->num + cpHashSetCount(space->adhesionImpulses);
+	while(impulseCount < joints) impulseCount += cpSpaceGrowAdhesionImpulsePool(space);
+	cpHashSetReserve(space->adhesionImpulses, joints);
+	
+	cpSetAllocator(allocator);
+}
+
+// Finds or creates the arbiter for colliding shapes and runs the begin and preSolve callbacks.
+// The contacts in info must already be pushed to the space's contact buffer.
+void
+cpSpaceHandleCollision(cpSpace *space, struct cpCollisionInfo *info)
+{
+	const cpShape *a = info->a, *b = info->b;
 	
 	// Get an arbiter from space->arbiterSet for the two shapes.
 	// This is where the persistant contact magic comes from.
-	const cpShape *shape_pair[] = {info.a, info.b};
-	cpHashValue arbHashID = CP_HASH_PAIR((cpHashValue)info.a, (cpHashValue)info.b);
+	// Hashed by the shape ids, not the pointers, so the set is filtered in the same order every run.
+	const cpShape *shape_pair[] = {a, b};
+	cpHashValue arbHashID = CP_HASH_PAIR(a->hashid, b->hashid);
 	cpArbiter *arb = (cpArbiter *)cpHashSetInsert(space->cachedArbiters, arbHashID, shape_pair, (cpHashSetTransFunc)cpSpaceArbiterSetTrans, space);
-	cpArbiterUpdate(arb, &info, space);
+	cpArbiterUpdate(arb, info, space);
+	
+	if(arb->state == CP_ARBITER_STATE_FIRST_COLLISION){
+		cpSpaceStepCount(space, newArbiters, 1);
+	} else {
+		cpSpaceStepCount(space, cachedArbiters, 1);
+	}
 	
 	cpCollisionHandler *handler = arb->handler;
 	
@@ -271,9 +514,10 @@ cpSpaceCollideShapes(cpShape *a, cpShape *b, cpCollisionID id, cpSpace *space)
 		// This includes collisions between two kinematic bodies, or a kinematic body and a static body.
 		!(a->body->m == INFINITY && b->body->m == INFINITY)
 	){
-		cpArrayPush(space->arbiters, arb);
+		cpSpacePushArbiter(space, arb);
+		if(arb->joint == NULL && cpShapesAdhere(a, b)) cpSpaceAdhere(space, arb);
 	} else {
-		cpSpacePopContacts(space, info.count);
+		cpSpacePopContacts(space, info->count);
 		
 		arb->contacts = NULL;
 		arb->count = 0;
@@ -285,6 +529,30 @@ cpSpaceCollideShapes(cpShape *a, cpShape *b, cpCollisionID id, cpSpace *space)
 	
 	// Time stamp the arbiter so we know it was used recently.
 	arb->stamp = space->stamp;
+}
+
+// Callback from the spatial hash.
+cpCollisionID
+cpSpaceCollideShapes(cpShape *a, cpShape *b, cpCollisionID id, cpSpace *space)
+{
+	cpSpaceStepCount(space, candidatePairs, 1);
+	
+	// Reject any of the simple cases
+	if(QueryReject(a,b)) return id;
+	
+	// The broadphase calls this in the middle of its query, the time up to here is broadphase time.
+	cpSpaceStepPhase(space, broadphase);
+	cpSpaceStepCount(space, collideCalls, 1);
+	
+	// Narrow-phase collision detection.
+	struct cpCollisionInfo info = cpCollide(a, b, id, cpContactBufferGetArray(space));
+	
+	if(info.count > 0){
+		cpSpacePushContacts(space, info.count);
+		cpSpaceHandleCollision(space, &info);
+	}
+	
+	cpSpaceStepPhase(space, narrowphase);
 	return info.id;
 }
 
@@ -311,13 +579,16 @@ cpSpaceArbiterSetFilter(cpArbiter *arb, cpSpace *space)
 		arb->state = CP_ARBITER_STATE_CACHED;
 		cpCollisionHandler *handler = arb->handler;
 		handler->separateFunc(arb, space, handler->userData);
+		cpSpaceReleaseAdhesion(space, arb);
 	}
 	
 	if(ticks >= space->collisionPersistence){
 		arb->contacts = NULL;
 		arb->count = 0;
 		
+		cpArbiterCacheUnthread(arb);
 		cpArrayPush(space->pooledArbiters, arb);
+		cpSpaceStepCount(space, removedArbiters, 1);
 		return cpFalse;
 	}
 	
@@ -338,6 +609,9 @@ cpSpaceStep(cpSpace *space, cpFloat dt)
 	// don't step if the timestep is 0!
 	if(dt == 0.0f) return;
 	
+	cpAllocator *allocator = cpSpaceUseAllocator(space);
+	cpAllocStats allocs = cpGetAllocStats();
+	cpSpaceBeginStepStats(space);
 	space->stamp++;
 	
 	cpFloat prev_dt = space->curr_dt;
@@ -358,6 +632,7 @@ cpSpaceStep(cpSpace *space, cpFloat dt)
 		}
 	}
 	arbiters->num = 0;
+	cpSpaceStepPhase(space, resetArbiters);
 
 	cpSpaceLock(space); {
 		// Integrate positions
@@ -365,19 +640,26 @@ cpSpaceStep(cpSpace *space, cpFloat dt)
 			cpBody *body = (cpBody *)bodies->arr[i];
 			body->position_func(body, dt);
 		}
+		cpSpaceStepPhase(space, integratePositions);
 		
 		// Find colliding pairs.
 		cpSpacePushFreshContactBuffer(space);
 		cpSpatialIndexEach(space->dynamicShapes, (cpSpatialIndexIteratorFunc)cpShapeUpdateFunc, NULL);
+		cpSpaceStepPhase(space, updateBBs);
+		
 		cpSpatialIndexReindexQuery(space->dynamicShapes, (cpSpatialIndexQueryFunc)cpSpaceCollideShapes, space);
+		cpSpaceStepPhase(space, broadphase);
 	} cpSpaceUnlock(space, cpFalse);
 	
 	// Rebuild the contact graph (and detect sleeping components if sleeping is enabled)
 	cpSpaceProcessComponents(space, dt);
+	cpSpaceStepPhase(space, processComponents);
 	
 	cpSpaceLock(space); {
 		// Clear out old cached arbiters and call separate callbacks
 		cpHashSetFilter(space->cachedArbiters, (cpHashSetFilterFunc)cpSpaceArbiterSetFilter, space);
+		cpSpaceFilterAdhesionImpulses(space);
+		cpSpaceStepPhase(space, filterArbiters);
 
 		// Prestep the arbiters and constraints.
 		cpFloat slop = space->collisionSlop;
@@ -394,6 +676,7 @@ cpSpaceStep(cpSpace *space, cpFloat dt)
 			
 			constraint->klass->preStep(constraint, dt);
 		}
+		cpSpaceStepPhase(space, preStep);
 	
 		// Integrate velocities.
 		cpFloat damping = cpfpow(space->damping, dt);
@@ -402,6 +685,7 @@ cpSpaceStep(cpSpace *space, cpFloat dt)
 			cpBody *body = (cpBody *)bodies->arr[i];
 			body->velocity_func(body, gravity, damping, dt);
 		}
+		cpSpaceStepPhase(space, integrateVelocities);
 		
 		// Apply cached impulses
 		cpFloat dt_coef = (prev_dt == 0.0f ? 0.0f : dt/prev_dt);
@@ -413,6 +697,7 @@ cpSpaceStep(cpSpace *space, cpFloat dt)
 			cpConstraint *constraint = (cpConstraint *)constraints->arr[i];
 			constraint->klass->applyCachedImpulse(constraint, dt_coef);
 		}
+		cpSpaceStepPhase(space, applyCachedImpulses);
 		
 		// Run the impulse solver.
 		for(int i=0; i<space->iterations; i++){
@@ -425,6 +710,7 @@ cpSpaceStep(cpSpace *space, cpFloat dt)
 				constraint->klass->applyImpulse(constraint, dt);
 			}
 		}
+		cpSpaceStepPhase(space, solve);
 		
 		// Run the constraint post-solve callbacks
 		for(int i=0; i<constraints->num; i++){
@@ -441,5 +727,12 @@ cpSpaceStep(cpSpace *space, cpFloat dt)
 			cpCollisionHandler *handler = arb->handler;
 			handler->postSolveFunc(arb, space, handler->userData);
 		}
+		
+		cpSpaceStepCount(space, postStepCallbacks, space->postStepCallbacks->num);
 	} cpSpaceUnlock(space, cpTrue);
+	cpSpaceStepPhase(space, postSolve);
+	cpSpaceEndStepStats(space);
+	
+	space->stepAllocStats = cpAllocStatsSince(allocs);
+	cpSetAllocator(allocator);
 }
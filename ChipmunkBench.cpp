@@ -0,0 +1,303 @@
+//
+// ChipmunkBench.cpp - Headless runner of the chipmunk demo benchmarks, without OpenGL
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "chipmunk/chipmunk.h"
+extern "C" {
+#include "chipmunk/cpHastySpace.h"
+}
+#include "ChipmunkDemo.h"
+
+
+// The demo sources are built with cpSpaceNew/Free/Step renamed to these (see CMakeLists.txt),
+// so the scenes run in whichever space the current configuration asks for.
+static bool s_hasty;
+static int s_threads;
+
+extern "C" cpSpace *BenchSpaceNew( void ) {
+    if( !s_hasty ) return cpSpaceNew();
+    cpSpace *space = cpHastySpaceNew();
+    cpHastySpaceSetThreads( space, s_threads );
+    return space;
+}
+
+extern "C" void BenchSpaceFree( cpSpace *space ) {
+    if( s_hasty ) cpHastySpaceFree( space ); else cpSpaceFree( space );
+}
+
+extern "C" void BenchSpaceStep( cpSpace *space, cpFloat dt ) {
+    if( s_hasty ) cpHastySpaceStep( space, dt ); else cpSpaceStep( space, dt );
+}
+
+// What ChipmunkDemo.c provides to the demos, minus the window.
+int ChipmunkDemoTicks = 0;
+double ChipmunkDemoTime;
+cpVect ChipmunkDemoKeyboard;
+cpVect ChipmunkDemoMouse;
+cpBool ChipmunkDemoRightClick = cpFalse;
+cpBool ChipmunkDemoRightDown = cpFalse;
+char const *ChipmunkDemoMessageString = NULL;
+
+#define GRABBABLE_MASK_BIT (1u<<31)
+cpShapeFilter GRAB_FILTER = {CP_NO_GROUP, GRABBABLE_MASK_BIT, GRABBABLE_MASK_BIT};
+cpShapeFilter NOT_GRABBABLE_FILTER = {CP_NO_GROUP, ~GRABBABLE_MASK_BIT, ~GRABBABLE_MASK_BIT};
+
+void ChipmunkDemoPrintString( char const *fmt, ... ) {}
+void ChipmunkDemoDefaultDrawImpl( cpSpace *space ) {}
+
+static void pushShape( cpShape *shape, std::vector<cpShape*> *shapes ) { shapes->push_back(shape); }
+static void pushConstraint( cpConstraint *constraint, std::vector<cpConstraint*> *constraints ) { constraints->push_back(constraint); }
+static void pushBody( cpBody *body, std::vector<cpBody*> *bodies ) { bodies->push_back(body); }
+
+// The space isn't stepping, so unlike the demo app's version this removes them right away.
+// Removing the shapes runs the separate callbacks, which can remove joints, so those are gathered after.
+void ChipmunkDemoFreeSpaceChildren( cpSpace *space ) {
+    std::vector<cpShape*> shapes;
+    cpSpaceEachShape( space, (cpSpaceShapeIteratorFunc)pushShape, &shapes );
+    for(size_t i=0;i<shapes.size();i++) { cpSpaceRemoveShape( space, shapes[i] ); cpShapeFree( shapes[i] ); }
+
+    std::vector<cpConstraint*> constraints;
+    cpSpaceEachConstraint( space, (cpSpaceConstraintIteratorFunc)pushConstraint, &constraints );
+    for(size_t i=0;i<constraints.size();i++) { cpSpaceRemoveConstraint( space, constraints[i] ); cpConstraintFree( constraints[i] ); }
+
+    std::vector<cpBody*> bodies;
+    cpSpaceEachBody( space, (cpSpaceBodyIteratorFunc)pushBody, &bodies );
+    for(size_t i=0;i<bodies.size();i++) { cpSpaceRemoveBody( space, bodies[i] ); cpBodyFree( bodies[i] ); }
+}
+
+extern ChipmunkDemo bench_list[];
+extern int bench_count;
+extern ChipmunkDemo PyramidStack, Tumble, Plink, Sticky;
+
+
+static void usage( const char *cmd ) {
+    fprintf( stderr,
+             "Usage: %s [-t steps] [-w warmup_steps] [-r reps] [-S space,hasty] [-j threads,...] [-i tree,hash,grid] [-d scene] [-s seed] [-o out.json] [-l]\n"
+             "  Runs the demo/Bench.c scenes and PyramidStack, Tumble, Plink and Sticky for every combination\n"
+             "  of stepper, hasty thread count and spatial index, and writes the step times as JSON.\n"
+             "  -S space is cpSpaceStep, hasty is cpHastySpaceStep with each -j thread count (0 uses all cores).\n"
+             "  -i tree is chipmunk's default bounding box tree, hash and grid are sized from the dynamic shapes.\n"
+             "  -d runs only the scenes whose name contains the text, it can be given more than once.\n"
+             "  -l lists the scenes.\n",
+             cmd );
+}
+
+static std::vector<std::string> splitList( const char *s ) {
+    std::vector<std::string> out;
+    std::string cur;
+    for(const char *p=s;;p++) {
+        if( *p == ',' || *p == '\0' ) {
+            if( !cur.empty() ) out.push_back(cur);
+            cur.clear();
+            if( *p == '\0' ) break;
+        } else {
+            cur += *p;
+        }
+    }
+    return out;
+}
+
+struct ShapeSizes
+{
+    int count;
+    double sum;
+};
+
+static void addShapeSize( cpShape *shape, ShapeSizes *sizes ) {
+    if( cpBodyGetType( cpShapeGetBody(shape) ) != CP_BODY_TYPE_DYNAMIC ) return;
+    cpBB bb = cpShapeGetBB( shape );
+    sizes->count++;
+    sizes->sum += std::max( bb.r - bb.l, bb.t - bb.b );
+}
+
+static void countBody( cpBody *body, int *count ) { (*count)++; }
+
+// Cells a bit larger than the average dynamic shape, hash tables about 10 times the shape count.
+static void useIndex( cpSpace *space, const std::string &index ) {
+    if( index == "tree" ) return;
+
+    ShapeSizes sizes = { 0, 0 };
+    cpSpaceEachShape( space, (cpSpaceShapeIteratorFunc)addShapeSize, &sizes );
+    double dim = sizes.count ? 1.25 * sizes.sum / sizes.count : 10.0;
+    if( index == "hash" ) {
+        cpSpaceUseSpatialHash( space, dim, 10 * std::max( sizes.count, 100 ) );
+    } else {
+        cpSpaceUseSpatialGrid( space, dim );
+    }
+}
+
+static double percentile( const std::vector<double> &sorted, double p ) {
+    size_t i = (size_t)( p * (sorted.size() - 1) + 0.5 );
+    return sorted[i];
+}
+
+struct Config
+{
+    bool hasty;
+    int threads;
+    std::string index;
+};
+
+int main( int argc, char **argv ) {
+    int steps = 1000;
+    int warmup = 0;
+    int reps = 3;
+    unsigned int seed = 1;
+    std::vector<std::string> steppers = splitList( "space,hasty" );
+    std::vector<std::string> threadList = splitList( "1" );
+    std::vector<std::string> indexes = splitList( "tree" );
+    std::vector<std::string> filters;
+    const char *outPath = NULL;
+    bool list = false;
+
+    for(int i=1;i<argc;i++) {
+        if( strcmp(argv[i],"-t")==0 && i+1<argc ) {
+            steps = atoi(argv[++i]);
+        } else if( strcmp(argv[i],"-w")==0 && i+1<argc ) {
+            warmup = atoi(argv[++i]);
+        } else if( strcmp(argv[i],"-r")==0 && i+1<argc ) {
+            reps = atoi(argv[++i]);
+        } else if( strcmp(argv[i],"-S")==0 && i+1<argc ) {
+            steppers = splitList( argv[++i] );
+        } else if( strcmp(argv[i],"-j")==0 && i+1<argc ) {
+            threadList = splitList( argv[++i] );
+        } else if( strcmp(argv[i],"-i")==0 && i+1<argc ) {
+            indexes = splitList( argv[++i] );
+        } else if( strcmp(argv[i],"-d")==0 && i+1<argc ) {
+            filters.push_back( argv[++i] );
+        } else if( strcmp(argv[i],"-s")==0 && i+1<argc ) {
+            seed = (unsigned int) strtoul(argv[++i], NULL, 10);
+        } else if( strcmp(argv[i],"-o")==0 && i+1<argc ) {
+            outPath = argv[++i];
+        } else if( strcmp(argv[i],"-l")==0 ) {
+            list = true;
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if( steps <= 0 || warmup < 0 || reps <= 0 ) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    std::vector<Config> configs;
+    for(size_t s=0;s<steppers.size();s++) {
+        bool hasty = steppers[s] == "hasty";
+        if( !hasty && steppers[s] != "space" ) {
+            usage(argv[0]);
+            return 1;
+        }
+        for(size_t t=0;t<(hasty ? threadList.size() : 1);t++) {
+            for(size_t k=0;k<indexes.size();k++) {
+                if( indexes[k] != "tree" && indexes[k] != "hash" && indexes[k] != "grid" ) {
+                    usage(argv[0]);
+                    return 1;
+                }
+                Config c;
+                c.hasty = hasty;
+                c.threads = hasty ? atoi( threadList[t].c_str() ) : 1;
+                c.index = indexes[k];
+                configs.push_back(c);
+            }
+        }
+    }
+
+    std::vector<ChipmunkDemo*> scenes;
+    for(int i=0;i<bench_count;i++) scenes.push_back( &bench_list[i] );
+    scenes.push_back( &PyramidStack );
+    scenes.push_back( &Tumble );
+    scenes.push_back( &Plink );
+    scenes.push_back( &Sticky );
+    if( !filters.empty() ) {
+        std::vector<ChipmunkDemo*> picked;
+        for(size_t i=0;i<scenes.size();i++) {
+            for(size_t k=0;k<filters.size();k++) {
+                if( strstr( scenes[i]->name, filters[k].c_str() ) ) { picked.push_back( scenes[i] ); break; }
+            }
+        }
+        scenes = picked;
+    }
+    if( list ) {
+        for(size_t i=0;i<scenes.size();i++) printf( "%s\n", scenes[i]->name );
+        return 0;
+    }
+
+    FILE *out = outPath ? fopen( outPath, "w" ) : stdout;
+    if( !out ) {
+        fprintf( stderr, "can't open %s\n", outPath );
+        return 1;
+    }
+
+    fprintf( out, "{\n  \"steps\": %d,\n  \"warmup\": %d,\n  \"reps\": %d,\n  \"seed\": %u,\n  \"results\": [", steps, warmup, reps, seed );
+    std::vector<double> times, repTimes;
+    bool first = true;
+    for(size_t i=0;i<scenes.size();i++) {
+        ChipmunkDemo *demo = scenes[i];
+        for(size_t c=0;c<configs.size();c++) {
+            const Config &config = configs[c];
+            s_hasty = config.hasty;
+            s_threads = config.threads;
+
+            times.clear();
+            repTimes.clear();
+            int bodies = 0, threads = 1;
+            for(int r=0;r<reps;r++) {
+                // Every repetition starts from the same scene.
+                srand(seed);
+                ChipmunkDemoTicks = 0;
+                ChipmunkDemoTime = 0;
+                cpSpace *space = demo->initFunc();
+                useIndex( space, config.index );
+                if( config.hasty ) threads = (int)cpHastySpaceGetThreads( space );
+                bodies = 0;
+                cpSpaceEachBody( space, (cpSpaceBodyIteratorFunc)countBody, &bodies );
+
+                for(int k=0;k<warmup;k++) demo->updateFunc( space, demo->timestep );
+
+                double total = 0;
+                for(int k=0;k<steps;k++) {
+                    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+                    demo->updateFunc( space, demo->timestep );
+                    std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+                    double us = std::chrono::duration<double, std::micro>( end - start ).count();
+                    times.push_back(us);
+                    total += us;
+                    ChipmunkDemoTicks++;
+                    ChipmunkDemoTime += demo->timestep;
+                }
+                repTimes.push_back( total / 1000.0 );
+                demo->destroyFunc( space );
+            }
+
+            std::sort( times.begin(), times.end() );
+            double sum = 0;
+            for(size_t k=0;k<times.size();k++) sum += times[k];
+            std::vector<double> sortedReps = repTimes;
+            std::sort( sortedReps.begin(), sortedReps.end() );
+
+            fprintf( out, "%s\n    {\"scene\": \"%s\", \"stepper\": \"%s\", \"threads\": %d, \"index\": \"%s\", \"bodies\": %d,\n",
+                     first ? "" : ",", demo->name, config.hasty ? "hasty" : "space", threads, config.index.c_str(), bodies );
+            fprintf( out, "     \"mean_us\": %.2f, \"p50_us\": %.2f, \"p90_us\": %.2f, \"p99_us\": %.2f, \"max_us\": %.2f,\n",
+                     sum / times.size(), percentile( times, 0.5 ), percentile( times, 0.9 ), percentile( times, 0.99 ), times.back() );
+            fprintf( out, "     \"median_rep_ms\": %.3f, \"rep_ms\": [", percentile( sortedReps, 0.5 ) );
+            for(size_t k=0;k<repTimes.size();k++) fprintf( out, "%s%.3f", k ? ", " : "", repTimes[k] );
+            fprintf( out, "]}" );
+            first = false;
+
+            fprintf( stderr, "%-40s %-5s j%-2d %-4s p50 %8.1f us  p99 %8.1f us\n", demo->name, config.hasty ? "hasty" : "space",
+                     threads, config.index.c_str(), percentile( times, 0.5 ), percentile( times, 0.99 ) );
+        }
+    }
+    fprintf( out, "\n  ]\n}\n" );
+    if( outPath ) fclose( out );
+    return 0;
+}
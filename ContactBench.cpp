@@ -0,0 +1,180 @@
+//
+// ContactBench.cpp - Compares the scalar and the SIMD contact and pivot joint solvers of cpHastySpace
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <vector>
+
+#include "chipmunk/chipmunk.h"
+extern "C" {
+#include "chipmunk/cpHastySpace.h"
+}
+
+
+static void usage( const char *cmd ) {
+    fprintf( stderr,
+             "Usage: %s [-s pyramids|chains] [-n count] [-r rows] [-t ticks] [-j threads] [-e tolerance]\n"
+             "  Steps the same scene with the scalar and the SIMD solver side by side, reports the solve time\n"
+             "  of both and fails if the bodies drift further apart than the tolerance.\n"
+             "  pyramids are -n box pyramids of -r rows (contacts), chains are -n chains of -r links (pivot joints).\n",
+             cmd );
+}
+
+// Box pyramids standing on the floor, the same layout as the PyramidStack demo.
+static cpSpace *newPyramids( int pyramids, int rows, int threads, bool batch, std::vector<cpBody*> *bodies ) {
+    cpSpace *space = cpHastySpaceNew();
+    cpHastySpaceSetThreads( space, threads );
+    cpHastySpaceSetBatchContacts( space, batch );
+    cpHastySpaceSetBatchJoints( space, batch );
+    cpSpaceSetGravity( space, cpv(0, -100) );
+    cpSpaceSetCollisionSlop( space, 0.5f );
+
+    float width = rows * 32.0f + 64.0f;
+    cpShape *floor = cpSpaceAddShape( space, cpSegmentShapeNew( cpSpaceGetStaticBody(space), cpv(0, 0), cpv(width * pyramids, 0), 0.0f ) );
+    cpShapeSetFriction( floor, 1.0f );
+
+    for(int p=0;p<pyramids;p++) {
+        float x = width * (p + 0.5f);
+        for(int i=0;i<rows;i++) {
+            for(int j=0;j<=i;j++) {
+                cpBody *body = cpSpaceAddBody( space, cpBodyNew( 1.0f, cpMomentForBox( 1.0f, 30.0f, 30.0f ) ) );
+                cpBodySetPosition( body, cpv( x + j*32 - i*16, (rows - i) * 32 - 16 ) );
+
+                cpShape *shape = cpSpaceAddShape( space, cpBoxShapeNew( body, 30.0f, 30.0f, 0.5f ) );
+                cpShapeSetFriction( shape, 0.8f );
+                bodies->push_back(body);
+            }
+        }
+
+        // A ball dropped on top keeps the stack from settling into a trivial state.
+        cpBody *ball = cpSpaceAddBody( space, cpBodyNew( 10.0f, cpMomentForCircle( 10.0f, 0.0f, 15.0f, cpvzero ) ) );
+        cpBodySetPosition( ball, cpv( x + 8.0f, rows * 32 + 200.0f ) );
+        cpShape *shape = cpSpaceAddShape( space, cpCircleShapeNew( ball, 15.0f, cpvzero ) );
+        cpShapeSetFriction( shape, 0.9f );
+        bodies->push_back(ball);
+    }
+    return space;
+}
+
+// Chains of pivot joints swinging down from the static body, a heavy weight on the end.
+// Every 4th joint is too weak to hold the weight and gets clamped to its maxForce, every 3rd one
+// has a maxBias. In every 5th chain a joint in the middle has a max force of 0 and lets go.
+static cpSpace *newChains( int chains, int links, int threads, bool batch, std::vector<cpBody*> *bodies ) {
+    cpSpace *space = cpHastySpaceNew();
+    cpHastySpaceSetThreads( space, threads );
+    cpHastySpaceSetBatchContacts( space, batch );
+    cpHastySpaceSetBatchJoints( space, batch );
+    cpSpaceSetGravity( space, cpv(0, -100) );
+    cpSpaceSetDamping( space, 0.8f );
+
+    for(int c=0;c<chains;c++) {
+        cpBody *prev = cpSpaceGetStaticBody( space );
+        cpVect pivot = cpv( 0, c * -50.0f );
+        for(int i=0;i<links;i++) {
+            float mass = (i == links - 1 ? 10.0f : 1.0f);
+            cpBody *body = cpSpaceAddBody( space, cpBodyNew( mass, cpMomentForCircle( mass, 0.0f, 5.0f, cpvzero ) ) );
+            cpBodySetPosition( body, cpvadd( pivot, cpv(10, 0) ) );
+            bodies->push_back(body);
+
+            cpConstraint *joint = cpSpaceAddConstraint( space, cpPivotJointNew( prev, body, pivot ) );
+            if( i % 4 == 3 ) cpConstraintSetMaxForce( joint, 500.0f );
+            if( i % 3 == 1 ) cpConstraintSetMaxBias( joint, 100.0f );
+            if( c % 5 == 0 && i == links / 2 ) cpConstraintSetMaxForce( joint, 0.0f );
+
+            prev = body;
+            pivot = cpvadd( pivot, cpv(20, 0) );
+        }
+    }
+    return space;
+}
+
+static void pushShape( cpShape *shape, std::vector<cpShape*> *shapes ) { shapes->push_back(shape); }
+static void pushConstraint( cpConstraint *constraint, std::vector<cpConstraint*> *constraints ) { constraints->push_back(constraint); }
+
+// The space still walks its bodies when it is freed, so they go last.
+static void freeSpace( cpSpace *space, std::vector<cpBody*> *bodies ) {
+    std::vector<cpShape*> shapes;
+    std::vector<cpConstraint*> constraints;
+    cpSpaceEachShape( space, (cpSpaceShapeIteratorFunc)pushShape, &shapes );
+    cpSpaceEachConstraint( space, (cpSpaceConstraintIteratorFunc)pushConstraint, &constraints );
+    cpHastySpaceFree( space );
+    for(size_t i=0;i<shapes.size();i++) cpShapeFree(shapes[i]);
+    for(size_t i=0;i<constraints.size();i++) cpConstraintFree(constraints[i]);
+    for(size_t i=0;i<bodies->size();i++) cpBodyFree((*bodies)[i]);
+}
+
+int main( int argc, char **argv ) {
+    bool chains = false;
+    int count = 16;
+    int rows = 14;
+    int ticks = 600;
+    int threads = 1;
+    double tolerance = 1e-3;
+
+    for(int i=1;i<argc;i++) {
+        if( strcmp(argv[i],"-s")==0 && i+1<argc && (strcmp(argv[i+1],"pyramids")==0 || strcmp(argv[i+1],"chains")==0) ) {
+            chains = strcmp(argv[++i],"chains")==0;
+        } else if( strcmp(argv[i],"-n")==0 && i+1<argc ) {
+            count = atoi(argv[++i]);
+        } else if( strcmp(argv[i],"-r")==0 && i+1<argc ) {
+            rows = atoi(argv[++i]);
+        } else if( strcmp(argv[i],"-t")==0 && i+1<argc ) {
+            ticks = atoi(argv[++i]);
+        } else if( strcmp(argv[i],"-j")==0 && i+1<argc ) {
+            threads = atoi(argv[++i]);
+        } else if( strcmp(argv[i],"-e")==0 && i+1<argc ) {
+            tolerance = atof(argv[++i]);
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if( count <= 0 || rows <= 0 || ticks <= 0 || threads < 0 || tolerance < 0 ) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    std::vector<cpBody*> scalarBodies, simdBodies;
+    cpSpace *(*newScene)( int, int, int, bool, std::vector<cpBody*> * ) = (chains ? newChains : newPyramids);
+    cpSpace *scalar = newScene( count, rows, threads, false, &scalarBodies );
+    cpSpace *simd = newScene( count, rows, threads, true, &simdBodies );
+
+    const double dt = 1.0 / 60.0;
+    double scalarSolve = 0, simdSolve = 0;
+    double maxPosError = 0, maxVelError = 0;
+    for(int i=0;i<ticks;i++) {
+        cpHastySpaceStep( scalar, dt );
+        scalarSolve += cpHastySpaceGetTimings(scalar).solve;
+        cpHastySpaceStep( simd, dt );
+        simdSolve += cpHastySpaceGetTimings(simd).solve;
+
+        for(size_t j=0;j<scalarBodies.size();j++) {
+            double dp = cpvdist( cpBodyGetPosition(scalarBodies[j]), cpBodyGetPosition(simdBodies[j]) );
+            double dv = cpvdist( cpBodyGetVelocity(scalarBodies[j]), cpBodyGetVelocity(simdBodies[j]) );
+            if( dp > maxPosError ) maxPosError = dp;
+            if( dv > maxVelError ) maxVelError = dv;
+        }
+    }
+
+    printf( "%s: %d\n", chains ? "chains" : "pyramids", count );
+    printf( "bodies: %d\n", (int)scalarBodies.size() );
+    printf( "threads: %d\n", (int)cpHastySpaceGetThreads(simd) );
+    printf( "ticks: %d\n", ticks );
+    printf( "scalar_solve_ns: %.0f\n", scalarSolve * 1e9 / ticks );
+    printf( "simd_solve_ns: %.0f\n", simdSolve * 1e9 / ticks );
+    printf( "speedup: %.2f\n", simdSolve > 0 ? scalarSolve / simdSolve : 0.0 );
+    printf( "max_position_error: %g\n", maxPosError );
+    printf( "max_velocity_error: %g\n", maxVelError );
+
+    freeSpace( scalar, &scalarBodies );
+    freeSpace( simd, &simdBodies );
+
+    if( maxPosError > tolerance || maxVelError > tolerance ) {
+        fprintf( stderr, "SIMD solver drifted from the scalar one by more than %g\n", tolerance );
+        return 1;
+    }
+    return 0;
+}
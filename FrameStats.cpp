@@ -0,0 +1,225 @@
+//
+// FrameStats.cpp - Frame time histograms and the window log
+//
+#include <string.h>
+
+#include "FrameStats.h"
+#include "Trace.h"
+
+static int BucketIndex( uint64_t ns ) {
+    const uint64_t sub = 1 << FRAME_HIST_SUB_BITS;
+    if( ns < sub ) return (int)ns;
+    if( ns >> FRAME_HIST_MAX_BITS ) ns = ((uint64_t)1 << FRAME_HIST_MAX_BITS) - 1;
+
+    int msb = FRAME_HIST_SUB_BITS;
+    while( ns >> (msb + 1) ) msb++;
+    int shift = msb - FRAME_HIST_SUB_BITS;
+    return ((shift + 1) << FRAME_HIST_SUB_BITS) + (int)((ns >> shift) - sub);
+}
+
+// Highest value that lands in the bucket.
+static uint64_t BucketTop( int index ) {
+    const uint64_t sub = 1 << FRAME_HIST_SUB_BITS;
+    if( index < (int)sub ) return index;
+    int shift = (index >> FRAME_HIST_SUB_BITS) - 1;
+    uint64_t bottom = (sub + (index & (sub - 1))) << shift;
+    return bottom + ((uint64_t)1 << shift) - 1;
+}
+
+void FrameHistogram::Reset() {
+    memset( m_buckets, 0, sizeof(m_buckets) );
+    m_count = m_sum = m_max = 0;
+}
+
+void FrameHistogram::Record( uint64_t ns ) {
+    m_buckets[BucketIndex(ns)]++;
+    m_count++;
+    m_sum += ns;
+    if( ns > m_max ) m_max = ns;
+}
+
+void FrameHistogram::Add( const FrameHistogram &other ) {
+    for(int i=0;i<FRAME_HIST_BUCKETS;i++) m_buckets[i] += other.m_buckets[i];
+    m_count += other.m_count;
+    m_sum += other.m_sum;
+    if( other.m_max > m_max ) m_max = other.m_max;
+}
+
+uint64_t FrameHistogram::GetPercentile( double p ) const {
+    if( m_count == 0 ) return 0;
+    // The rank of the percentile, 1 based, p=0 is the smallest value.
+    uint64_t rank = (uint64_t)( p * m_count + 0.5 );
+    if( rank < 1 ) rank = 1;
+    if( rank > m_count ) rank = m_count;
+
+    uint64_t seen = 0;
+    for(int i=0;i<FRAME_HIST_BUCKETS;i++) {
+        seen += m_buckets[i];
+        if( seen >= rank ) {
+            uint64_t top = BucketTop(i);
+            return top < m_max ? top : m_max;
+        }
+    }
+    return m_max;
+}
+
+//////////////////////
+
+FrameStats::FrameStats() :
+    m_log(nullptr),
+    m_windowNs(5000000000ull),
+    m_spikeNs(0),
+    m_frame(0),
+    m_spikeNum(0),
+    m_lastSpikeNum(0),
+    m_windowSpikeCount(0),
+    m_spikeCount(0)
+{
+    m_start = m_windowStart = m_frameStart = TraceNow();
+    for(int i=0;i<FRAME_CHANNEL_NUM;i++) m_frameNs[i] = 0;
+}
+
+FrameStats::~FrameStats() {
+    if( m_log ) fclose( m_log );
+}
+
+bool FrameStats::SetLog( const char *path ) {
+    if( m_log ) fclose( m_log );
+    m_log = path ? fopen( path, "a" ) : nullptr;
+    return !path || m_log;
+}
+
+const char *FrameStats::GetChannelName( FrameChannel channel ) {
+    switch( channel ) {
+    case FRAME_UPDATE: return "update";
+    case FRAME_RENDER: return "render";
+    case FRAME_PRESENT: return "present";
+    case FRAME_TOTAL: return "total";
+    default: return "?";
+    }
+}
+
+FramePercentiles FrameStats::Percentiles( const FrameHistogram &h ) {
+    FramePercentiles p;
+    p.count = h.GetCount();
+    p.mean = h.GetMean();
+    p.p50 = h.GetPercentile( 0.5 );
+    p.p90 = h.GetPercentile( 0.9 );
+    p.p99 = h.GetPercentile( 0.99 );
+    p.p999 = h.GetPercentile( 0.999 );
+    p.max = h.GetMax();
+    return p;
+}
+
+void FrameStats::BeginFrame() {
+    m_frameStart = TraceNow();
+    for(int i=0;i<FRAME_CHANNEL_NUM;i++) m_frameNs[i] = 0;
+}
+
+void FrameStats::EndFrame( const SimCounters &counters ) {
+    uint64_t now = TraceNow();
+    m_frameNs[FRAME_TOTAL] = now - m_frameStart;
+    for(int i=0;i<FRAME_CHANNEL_NUM;i++) m_window[i].Record( m_frameNs[i] );
+    m_windowCounters.Add( counters );
+
+    uint64_t threshold = m_spikeNs ? m_spikeNs : m_lastWindow[FRAME_TOTAL].GetPercentile( 0.99 );
+    if( threshold && m_frameNs[FRAME_TOTAL] >= threshold ) {
+        m_windowSpikeCount++;
+        m_windowSpikeCounters.Add( counters );
+
+        // Keep the slowest, the new one replaces the fastest when they're all taken.
+        int slot = m_spikeNum;
+        if( m_spikeNum < FRAME_SPIKE_NUM ) {
+            m_spikeNum++;
+        } else {
+            slot = 0;
+            for(int i=1;i<FRAME_SPIKE_NUM;i++) {
+                if( m_spikes[i].ns[FRAME_TOTAL] < m_spikes[slot].ns[FRAME_TOTAL] ) slot = i;
+            }
+            if( m_spikes[slot].ns[FRAME_TOTAL] >= m_frameNs[FRAME_TOTAL] ) slot = -1;
+        }
+        if( slot >= 0 ) {
+            FrameSpike &s = m_spikes[slot];
+            s.frame = m_frame;
+            for(int i=0;i<FRAME_CHANNEL_NUM;i++) s.ns[i] = m_frameNs[i];
+            s.counters = counters;
+        }
+    }
+
+    m_frame++;
+    if( now - m_windowStart >= m_windowNs ) EndWindow( now );
+}
+
+void FrameStats::Flush() {
+    if( m_window[FRAME_TOTAL].GetCount() ) EndWindow( TraceNow() );
+}
+
+int FrameStats::GetSpikes( FrameSpike *out, int max ) {
+    int n = m_lastSpikeNum < max ? m_lastSpikeNum : max;
+    for(int k=0;k<n;k++) out[k] = m_lastSpikes[k];
+    return n;
+}
+
+void FrameStats::EndWindow( uint64_t now ) {
+    // Slowest first, insertion sort is plenty for FRAME_SPIKE_NUM.
+    for(int k=0;k<m_spikeNum;k++) {
+        int i = k;
+        for(;i>0 && m_lastSpikes[i-1].ns[FRAME_TOTAL] < m_spikes[k].ns[FRAME_TOTAL];i--) m_lastSpikes[i] = m_lastSpikes[i-1];
+        m_lastSpikes[i] = m_spikes[k];
+    }
+    m_lastSpikeNum = m_spikeNum;
+
+    if( m_log ) WriteLog( now );
+
+    for(int i=0;i<FRAME_CHANNEL_NUM;i++) {
+        m_total[i].Add( m_window[i] );
+        m_lastWindow[i] = m_window[i];
+        m_window[i].Reset();
+    }
+    m_totalCounters.Add( m_windowCounters );
+    m_spikeCounters.Add( m_windowSpikeCounters );
+    m_spikeCount += m_windowSpikeCount;
+
+    m_windowCounters = SimCounters();
+    m_windowSpikeCounters = SimCounters();
+    m_windowSpikeCount = 0;
+    m_spikeNum = 0;
+    m_windowStart = now;
+}
+
+static void WriteCounters( FILE *fp, const SimCounters &c, double scale ) {
+    fprintf( fp, "steps=%.1f new_arbiters=%.1f removed_arbiters=%.1f collisions=%.1f joins=%.1f separations=%.1f freed_cells=%.1f respawns=%.2f",
+             c.steps * scale, c.newArbiters * scale, c.removedArbiters * scale, c.collisions * scale,
+             c.joins * scale, c.separations * scale, c.freedCells * scale, c.respawns * scale );
+}
+
+// One window: a line of percentiles per channel in ms, the counters per frame of the spikes
+// next to those of all frames, then the slowest spikes.
+void FrameStats::WriteLog( uint64_t now ) {
+    uint64_t frames = m_window[FRAME_TOTAL].GetCount();
+    fprintf( m_log, "window t=%.1fs frames=%llu spikes=%llu (ms)\n", (now - m_start) / 1e9, (unsigned long long)frames, (unsigned long long)m_windowSpikeCount );
+    for(int i=0;i<FRAME_CHANNEL_NUM;i++) {
+        FramePercentiles p = Percentiles( m_window[i] );
+        fprintf( m_log, "  %-8s mean=%.3f p50=%.3f p90=%.3f p99=%.3f p999=%.3f max=%.3f\n", GetChannelName( (FrameChannel)i ),
+                 p.mean / 1e6, p.p50 / 1e6, p.p90 / 1e6, p.p99 / 1e6, p.p999 / 1e6, p.max / 1e6 );
+    }
+    if( frames ) {
+        fprintf( m_log, "  all frames  " );
+        WriteCounters( m_log, m_windowCounters, 1.0 / frames );
+        fprintf( m_log, "\n" );
+    }
+    if( m_windowSpikeCount ) {
+        fprintf( m_log, "  spike frames  " );
+        WriteCounters( m_log, m_windowSpikeCounters, 1.0 / m_windowSpikeCount );
+        fprintf( m_log, "\n" );
+    }
+
+    for(int k=0;k<m_lastSpikeNum;k++) {
+        const FrameSpike &s = m_lastSpikes[k];
+        fprintf( m_log, "  spike frame=%u total=%.3f update=%.3f render=%.3f present=%.3f ", s.frame,
+                 s.ns[FRAME_TOTAL] / 1e6, s.ns[FRAME_UPDATE] / 1e6, s.ns[FRAME_RENDER] / 1e6, s.ns[FRAME_PRESENT] / 1e6 );
+        WriteCounters( m_log, s.counters, 1.0 );
+        fprintf( m_log, "\n" );
+    }
+    fflush( m_log );
+}
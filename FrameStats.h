@@ -0,0 +1,120 @@
+//
+// FrameStats.h - Frame time histograms, tail percentiles and the slow frames with their sim counters
+//
+
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "Sim.h"
+
+// HDR style buckets: 32 per power of two, so a percentile is at most 1/32 above the real value.
+// Durations are nanoseconds and clamped to 2^40 (18 minutes).
+#define FRAME_HIST_SUB_BITS 5
+#define FRAME_HIST_MAX_BITS 40
+#define FRAME_HIST_BUCKETS ( (FRAME_HIST_MAX_BITS - FRAME_HIST_SUB_BITS + 1) << FRAME_HIST_SUB_BITS )
+
+// Slowest frames kept per window.
+#define FRAME_SPIKE_NUM 16
+
+class FrameHistogram
+{
+public:
+    FrameHistogram() { Reset(); }
+    void Reset();
+    void Record( uint64_t ns );
+    void Add( const FrameHistogram &other );
+
+    uint64_t GetCount() const { return m_count; }
+    uint64_t GetMax() const { return m_max; }
+    double GetMean() const { return m_count ? (double)m_sum / m_count : 0; }
+    // p in [0,1]. The highest value of the bucket the percentile falls into, never above GetMax().
+    uint64_t GetPercentile( double p ) const;
+
+private:
+    uint32_t m_buckets[FRAME_HIST_BUCKETS];
+    uint64_t m_count, m_sum, m_max;
+};
+
+enum FrameChannel
+{
+    FRAME_UPDATE, // the Sim updates of the frame, there can be several with a fixed time step
+    FRAME_RENDER, // drawing, without the Present
+    FRAME_PRESENT, // the swap chain Present, mostly the wait for vsync
+    FRAME_TOTAL, // BeginFrame to EndFrame
+    FRAME_CHANNEL_NUM,
+};
+
+struct FramePercentiles
+{
+    uint64_t count;
+    double mean;
+    uint64_t p50, p90, p99, p999, max;
+};
+
+// A frame over the spike threshold and the work the sim did in it.
+struct FrameSpike
+{
+    uint32_t frame;
+    uint64_t ns[FRAME_CHANNEL_NUM];
+    SimCounters counters;
+};
+
+class FrameStats
+{
+public:
+    FrameStats();
+    ~FrameStats();
+
+    // Appends each window to the file when it is done, nullptr stops logging.
+    bool SetLog( const char *path );
+    void SetWindowSeconds( double seconds ) { m_windowNs = (uint64_t)( seconds * 1e9 ); }
+    // Frames at least this long are spikes. 0 uses the p99 of the last window, so the first window has none.
+    void SetSpikeThreshold( uint64_t ns ) { m_spikeNs = ns; }
+
+    void BeginFrame();
+    // Adds to the channel's time of the current frame.
+    void Record( FrameChannel channel, uint64_t ns ) { m_frameNs[channel] += ns; }
+    // counters are what the sim did during the frame.
+    void EndFrame( const SimCounters &counters );
+    // Ends the window early, at the end of a run so the totals have its last frames.
+    void Flush();
+
+    uint32_t GetFrameCount() { return m_frame; }
+    // Every frame of the windows done so far.
+    FramePercentiles GetTotal( FrameChannel channel ) { return Percentiles( m_total[channel] ); }
+    // The last complete window.
+    FramePercentiles GetWindow( FrameChannel channel ) { return Percentiles( m_lastWindow[channel] ); }
+    // All spikes since the start and the sum of their counters, next to the sum over all frames.
+    uint64_t GetSpikeCount() { return m_spikeCount; }
+    const SimCounters &GetSpikeCounters() { return m_spikeCounters; }
+    const SimCounters &GetTotalCounters() { return m_totalCounters; }
+    // The slowest spikes of the last complete window, slowest first.
+    int GetSpikes( FrameSpike *out, int max );
+
+    static const char *GetChannelName( FrameChannel channel );
+
+private:
+    static FramePercentiles Percentiles( const FrameHistogram &h );
+    void EndWindow( uint64_t now );
+    void WriteLog( uint64_t now );
+
+    FILE *m_log;
+    uint64_t m_windowNs, m_spikeNs;
+    uint64_t m_start, m_windowStart, m_frameStart;
+    uint64_t m_frameNs[FRAME_CHANNEL_NUM];
+    uint32_t m_frame;
+
+    FrameHistogram m_window[FRAME_CHANNEL_NUM];
+    FrameHistogram m_lastWindow[FRAME_CHANNEL_NUM];
+    FrameHistogram m_total[FRAME_CHANNEL_NUM];
+
+    FrameSpike m_spikes[FRAME_SPIKE_NUM]; // unsorted
+    int m_spikeNum;
+    FrameSpike m_lastSpikes[FRAME_SPIKE_NUM]; // sorted
+    int m_lastSpikeNum;
+    uint64_t m_windowSpikeCount, m_spikeCount;
+    SimCounters m_windowCounters, m_windowSpikeCounters;
+    SimCounters m_totalCounters, m_spikeCounters;
+};
@@ -6,6 +6,7 @@
 #include "DDSTextureLoader.h"
 #include "CommonStates.h"
 #include <assert.h>
+#include <time.h>
 
 #include "MMDeviceapi.h"
 
@@ -13,6 +14,7 @@
 
 #include "Phys.h"
 #include "Game.h"
+#include "Trace.h"
 
 
 
@@ -40,7 +42,8 @@ void print( const char *fmt, ... ){
 Game::Game() :
     m_window(0),
     m_featureLevel( D3D_FEATURE_LEVEL_11_1 ),
-	m_framecnt(0)
+	m_framecnt(0),
+    m_sim(nullptr)
 {
     for(int i=0;i<MAX_PLAYER_NUM;i++) m_players[i] = nullptr;
 }
@@ -49,206 +52,58 @@ Game::Game() :
 void Game::Initialize(HWND window)
 {
     m_window = window;
+    TraceNameThread( "main" );
+    // Percentiles and slowest frames of every 5 seconds.
+    if( !m_frameStats.SetLog( "amoeba_frames.log" ) ) print( "can't open amoeba_frames.log" );
 
 	
     CreateDevice();
 
     CreateResources();
 
-    // TODO: Change the timer settings if you want something other than the default variable timestep mode.
-    // e.g. for 60 FPS fixed timestep update logic, call:
-    /*
+    // Fixed 60 updates per second, so the sim runs the same on any machine and a replay matches.
     m_timer.SetFixedTimeStep(true);
     m_timer.SetTargetElapsedSeconds(1.0 / 60);
-    */
     
     // chipmunk
     InitGameWorld();
 }
 
 void Game::InitGameWorld() {
-
-    m_space = cpSpaceNew();
-
-	cpSpaceSetIterations(m_space, 10);
-	cpSpaceSetGravity(m_space, cpv(0, -10));
-	cpSpaceSetCollisionSlop(m_space, 2.0);
-
-	cpBody *staticBody = cpSpaceGetStaticBody( m_space);
-	cpShape *shape;
-
-	// Create segments around the edge of the screen.
     size_t w,h;
     GetDefaultSize(w,h);
 
-    float mgn=10;
-    float minx = -(float)w/2+mgn, maxx = w/2-mgn, miny = -(float)h/2+mgn, maxy = h/2-mgn;
-	shape = cpSpaceAddShape(m_space, cpSegmentShapeNew(staticBody, cpv(minx,miny), cpv(minx, maxy), 20.0f)); // left
-	cpShapeSetElasticity(shape, 1.0f);
-	cpShapeSetFriction(shape, 1.0f);
-	cpShapeSetFilter(shape, NOT_GRABBABLE_FILTER);
-
-	shape = cpSpaceAddShape(m_space, cpSegmentShapeNew(staticBody, cpv( maxx,miny), cpv( maxx, maxy), 20.0f)); // right
-	cpShapeSetElasticity(shape, 1.0f);
-	cpShapeSetFriction(shape, 1.0f);
-	cpShapeSetFilter(shape, NOT_GRABBABLE_FILTER);
-
-	shape = cpSpaceAddShape(m_space, cpSegmentShapeNew(staticBody, cpv(minx,miny), cpv( maxx,miny), 20.0f)); // bottom
-	cpShapeSetElasticity(shape, 1.0f);
-	cpShapeSetFriction(shape, 1.0f);
-	cpShapeSetFilter(shape, NOT_GRABBABLE_FILTER);
-	
-	shape = cpSpaceAddShape(m_space, cpSegmentShapeNew(staticBody, cpv(minx, maxy), cpv( maxx, maxy), 20.0f)); // top
-	cpShapeSetElasticity(shape, 1.0f);
-	cpShapeSetFriction(shape, 1.0f);
-	cpShapeSetFilter(shape, NOT_GRABBABLE_FILTER);
-
-
-	
-	cpCollisionHandler *handler = cpSpaceAddWildcardHandler(m_space, COLLISION_TYPE_STICKY);
-	handler->preSolveFunc = StickyPreSolve;
-	handler->separateFunc = StickySeparate;
-}
-cpBody *Game::CreateCellBody( cpVect pos, BodyState *bs, bool is_eye ) {
-    cpFloat mass = 0.1f, eye_mass = 10.0f;
-    cpFloat radius = CELL_RADIUS;
-
-    if( is_eye ) mass = eye_mass;
-
-    
-    cpBody *body = cpSpaceAddBody(m_space, cpBodyNew( mass, cpMomentForCircle(mass, 0.0f, radius, cpvzero)));
-
-    cpBodySetPosition(body, pos);
-    cpBodySetUserData(body, bs);
-
-    cpShape *shape = cpSpaceAddShape(m_space, cpCircleShapeNew(body, radius + STICK_SENSOR_THICKNESS, cpvzero));
-    cpShapeSetFriction(shape, 0.95f);
-    cpShapeSetCollisionType(shape, COLLISION_TYPE_STICKY);
-
-    bs->radius = radius;
-    bs->hp = BODY_MAXHP * cpflerp( 0.6, 1.0, frand() );
-
-    return body;
+    m_sim = new Sim( (float)w, (float)h, MAX_PLAYER_NUM );
+    m_sim->SetListener(this);
+    // Every game is recorded, amoeba_bench -P amoeba_replay.amr runs it again.
+    m_sim->SetSeed( (uint32_t) time(NULL) );
+    if( !m_replay.Open( "amoeba_replay.amr", m_sim, 1.0 / 60 ) ) print( "can't open amoeba_replay.amr" );
 }
 
 // Executes basic game loop.
 void Game::Tick()
 {
+    TRACE_ZONE( "Game::Tick" );
+    m_frameStats.BeginFrame();
+    m_sim->ResetCounters();
     m_timer.Tick([&]()
     {
+        TRACE_ZONE( "StepTimer::Tick update" );
+        uint64_t t = TraceNow();
         Update(m_timer);
+        m_frameStats.Record( FRAME_UPDATE, TraceNow() - t );
     });
 
     Render();
+    m_frameStats.EndFrame( m_sim->GetCounters() );
 }
 
 
 
-//////////////////////
-
-static void ShapeFreeWrap(cpSpace *space, cpShape *shape, void *unused){
-	cpSpaceRemoveShape(space, shape);
-	cpShapeFree(shape);
-}
-
-static void PostShapeFree(cpShape *shape, cpSpace *space){
-	cpSpaceAddPostStepCallback(space, (cpPostStepFunc)ShapeFreeWrap, shape, NULL);
-}
-
-static void ConstraintFreeWrap(cpSpace *space, cpConstraint *constraint, void *unused){
-	cpSpaceRemoveConstraint(space, constraint);
-	cpConstraintFree(constraint);
-}
-
-static void PostConstraintFree(cpConstraint *constraint, cpSpace *space){
-	cpSpaceAddPostStepCallback(space, (cpPostStepFunc)ConstraintFreeWrap, constraint, NULL);
-}
-
-static void BodyFreeWrap(cpSpace *space, cpBody *body, void *unused){
-	cpSpaceRemoveBody(space, body);
-    BodyState *bs = (BodyState*) cpBodyGetUserData(body);
-    delete bs;
-    cpBodySetUserData(body,NULL);
-	cpBodyFree(body);
-}
-
-static void PostBodyFree(cpBody *body, cpSpace *space){
-	cpSpaceAddPostStepCallback(space, (cpPostStepFunc)BodyFreeWrap, body, NULL);
-}
-
-
-void eachShapeDeleteCallback( cpBody *body, cpShape *shape, void *data ) {
-    //    print("eachShapeDeleteCallback shape:%p body:%p", shape, body );
-    Game *game = (Game*) data;
-    PostShapeFree( shape, game->GetSpace());
-}
-void eachConstraintDeleteCallback( cpBody *body, cpConstraint *ct, void *data ) {
-    //    print("eachConstraintDeleteCallback: ct:%p body:%p", ct, body );
-    Game *game = (Game*) data;
-    PostConstraintFree( ct, game->GetSpace() );
-}
-
-
-void eachBodyGameUpdateCallback( cpBody *body, void *data ) {
-    BodyState *bs = (BodyState*) cpBodyGetUserData(body);
-    Game *game = (Game*) data;
-    Player *pl = game->GetPlayer( bs->group_id );
-    if(!pl)return; 
-    
-    pl->IncrementCellCount();
-    
-    if( bs->eye_id < 0 ) {
-        bs->hp -= HP_CONSUME_SPEED;
-        if( bs->hp < 0 ) {
-            //            cpSpaceAddPostStepCallback( game->GetSpace(), postStepRemoveBodyCallback, body, game );
-            print("eachBodyGameUpdateCallback: removing body:%p", body );
-            cpBodyEachShape(body, eachShapeDeleteCallback, data );
-            cpBodyEachConstraint(body, eachConstraintDeleteCallback, data );
-            PostBodyFree( body, game->GetSpace());
-            return;
-        }
-    } else {
-        float scl = 10000;
-        cpVect f;
-        if( bs->eye_id == 0 ) {
-            XMFLOAT2 lf = pl->GetLeftForce();
-            f = cpv( lf.x * scl, lf.y * scl );
-            bs->force = len( lf.x, lf.y );
-            cpBodySetForce( body, f );        
-        } else {
-            XMFLOAT2 rf = pl->GetRightForce();            
-            f = cpv( rf.x * scl, rf.y * scl );
-            bs->force = len( rf.x, rf.y );
-            cpBodySetForce( body, f );        
-        }
-
-        // Eyes keep max HP 
-        bs->hp = BODY_MAXHP;
-        //    cpVect v = cpBodyGetVelocity( body );
-        //    cpBodySetVelocity( body, cpv( v.x + f.x/1000, v.y + f.y/1000) );        
-    }
-
-}
-
-void eachConstraintGameUpdateCallback( cpConstraint *ct, void *data )  {
-    cpBody *bodyA = cpConstraintGetBodyA(ct);
-    cpBody *bodyB = cpConstraintGetBodyB(ct);
-
-    BodyState *bsA = (BodyState*) cpBodyGetUserData(bodyA);
-    BodyState *bsB = (BodyState*) cpBodyGetUserData(bodyB);
-    {
-        if( bsA->group_id == bsB->group_id ) {
-            // exchange hp
-            float total = bsA->hp + bsB->hp;
-            float average = total / 2.0f;
-            bsA->hp = bsB->hp = average;
-        }
-    }
-}
-
 // Updates the world
 void Game::Update(DX::StepTimer const& timer)
 {
+    TRACE_ZONE( "Game::Update" );
     float elapsedTime = float(timer.GetElapsedSeconds());
 
     // TODO: Add your game logic here
@@ -259,8 +114,6 @@ void Game::Update(DX::StepTimer const& timer)
         if(pl) pl->Update(elapsedTime);
     }
 
-    PhysUpdateSpace( m_space, elapsedTime );
-
     // read joystick
 #if 0    
     print( "js: %.1f %.1f %.1f %.1f %d %d %d %d",
@@ -269,6 +122,7 @@ void Game::Update(DX::StepTimer const& timer)
            state.IsAPressed(), state.IsBPressed(), state.IsXPressed(), state.IsYPressed() );
 #endif
     for(int i=0;i<MAX_PLAYER_NUM;i++) {
+        TRACE_ZONE( "GamePad read" );
         auto state = GetGamePadState(i);      
         if( state.IsConnected()) {
             Player *pl = GetPlayer(i);
@@ -277,37 +131,19 @@ void Game::Update(DX::StepTimer const& timer)
                                  );
         }
     }
-    for(int i=0;i<MAX_PLAYER_NUM;i++) {
-        Player *pl = GetPlayer(i);
-        if( pl ) pl->ResetCellCount();
-    }
-    cpSpaceEachConstraint( m_space, eachConstraintGameUpdateCallback, this );
-    cpSpaceEachBody( m_space, eachBodyGameUpdateCallback, (void*) this );
-    for(int i=0;i<MAX_PLAYER_NUM;i++) {
-        Player *pl = GetPlayer(i);
-        if( pl && pl->GetCellCount() == 2 ) {
-            pl->ResetCells();
-        }
-    }
 
+    // Physics step and the game rules on the cells
+    m_sim->Update( elapsedTime );
 }
 
-void Player::ResetCells() {
-    cpBody *le = m_eyes[0];
-    cpBody *re = m_eyes[1];
-    cpVect lv = cpBodyGetPosition(le);
-    cpVect rv = cpBodyGetPosition(re);
-    float dia;
-    cpVect center = Game::GetPlayerDefaultPosition( group_id, &dia );
-    for(int i=0;i<BODY_CELL_NUM_PER_PLAYER;i++) {
-        cpVect p = cpv( cpflerp( center.x-dia, center.x+dia, frand() ), cpflerp( center.y-dia, center.y+dia, frand() ) );
-        BodyState *bs = new BodyState( CELL_PRIO_LOW, group_id, -1, game );
-        cpBody *body = game->CreateCellBody( p, bs, false );
-        cpBodySetUserData(body,bs);
-    }
+void Player::SetForce( XMFLOAT2 lf, XMFLOAT2 rf ) {
+    game->GetSim()->SetForce( group_id, cpv( lf.x, lf.y ), cpv( rf.x, rf.y ) );
+}
+int Player::GetCellCount() {
+    return game->GetSim()->GetCellCount( group_id );
 }
 void Player::CleanCells() {
-    game->CleanGroup( group_id );
+    game->GetSim()->RemoveGroup( group_id );
 }
 
 
@@ -328,63 +164,49 @@ void DrawCircle( PrimitiveBatch<VertexPositionColor> *pb, XMFLOAT3 pos, float di
 }
 
 
-void Player::DrawBody( cpBody *body ) {
-    BodyState *bs = (BodyState*) cpBodyGetUserData(body);
-
-    cpVect cppos = cpBodyGetPosition(body);
+void Player::DrawBody( BodyStatePool *cells, int i ) {
+    cpVect cppos = cpBodyGetPosition(cells->body[i]);
 
 
     // draw
     size_t scrw, scrh;
     game->GetDefaultSize(scrw,scrh);
     XMFLOAT3 dxtkPos( cppos.x+scrw/2, - cppos.y + scrh/2, 0 );
-    XMFLOAT4 groupCol = Game::GetPlayerColor( bs->group_id );
-    if( bs->eye_id >= 0 ) {
-        XMFLOAT4 eyeCol = XMFLOAT4( bs->force,0.2,0.2,1);
-        DrawCircle( GetPrimBatch(), dxtkPos, bs->radius, groupCol );
-        DrawCircle( GetPrimBatch(), dxtkPos, bs->radius-3, eyeCol );
+    XMFLOAT4 groupCol = Game::GetPlayerColor( cells->group_id[i] );
+    float radius = cells->radius[i];
+    if( cells->eye_id[i] >= 0 ) {
+        XMFLOAT4 eyeCol = XMFLOAT4( cells->force[i],0.2,0.2,1);
+        DrawCircle( GetPrimBatch(), dxtkPos, radius, groupCol );
+        DrawCircle( GetPrimBatch(), dxtkPos, radius-3, eyeCol );
     } else {        
-        float hprate = bs->GetHPRate();
+        float hprate = cells->GetHPRate(i);
         XMFLOAT4 cellCol( groupCol.x * hprate, groupCol.y * hprate, groupCol.z * hprate, 1.0f );
         
-        DrawCircle( GetPrimBatch(), dxtkPos, bs->radius, cellCol );
+        DrawCircle( GetPrimBatch(), dxtkPos, radius, cellCol );
     }
     
     
-}
-void eachBodyPushCallback( cpBody *body, void *data ) {
-    std::vector<cpBody*> *v = (std::vector<cpBody*>*)data;
-    v->push_back(body);
-}
-void SortBodiesById( std::vector<cpBody*> &vec ) {
-    SorterEntry ents[1024];
-    assert( vec.size() <= 1024 );
-    for(unsigned int i=0; i<vec.size();i++ ) {
-        ents[i].ptr = vec[i];
-        BodyState *bs = (BodyState*) cpBodyGetUserData( vec[i] );
-        ents[i].val = bs->draw_priority;
-    }
-    quickSortF( ents, 0, vec.size()-1);    
-    for(unsigned int i=0;i<vec.size();i++) {
-        vec[i] = (cpBody*) ents[i].ptr;
-    }    
 }
 void Game::Render()
 {
+    TRACE_ZONE( "Game::Render" );
 	m_framecnt++;
     // Don't try to render anything before the first Update.
     if (m_timer.GetFrameCount() == 0)
         return;
 
+    uint64_t t = TraceNow();
     for(int i=0;i<MAX_PLAYER_NUM;i++) {
         Player *pl = GetPlayer(i);
         if(pl) pl->Render();
     }
+    m_frameStats.Record( FRAME_RENDER, TraceNow() - t );
 
     Present();    
 }
 
 void Player::Render() {
+    TRACE_ZONE( "Player::Render" );
     
     Clear();
 
@@ -434,13 +256,12 @@ void Player::Render() {
     DrawCircle( m_primBatch, XMFLOAT3(cirpos.x+50,cirpos.y+50,0), range(10,50), col );    
 #endif
 
-    // cells
-    std::vector<cpBody*> to_sort_body;
-    cpSpaceEachBody( game->GetSpace(), eachBodyPushCallback, (void*) &to_sort_body );
-    SortBodiesById( to_sort_body );
-    for(unsigned int i=0;i<to_sort_body.size();i++){
-        cpBody *body = to_sort_body[i];
-        DrawBody(body);
+    // cells, low priority first so eyes are drawn on top
+    BodyStatePool *cells = game->GetSim()->GetCells();
+    for(int prio=CELL_PRIO_LOW;prio<=CELL_PRIO_HIGH;prio++) {
+        for(int i=0;i<cells->Count();i++){
+            if( cells->draw_priority[i] == prio ) DrawBody( cells, i );
+        }
     }
     m_primBatch->End();
 
@@ -499,10 +320,13 @@ void Player::Clear() {
 // Presents the backbuffer contents to the screen
 void Game::Present()
 {
+    TRACE_ZONE( "Game::Present" );
     // The first argument instructs DXGI to block until VSync, putting the application
     // to sleep until the next VSync. This ensures we don't waste any cycles rendering
     // frames that will never be displayed to the screen.
+    uint64_t t = TraceNow();
     HRESULT hr = m_swapChain->Present(1, 0);
+    m_frameStats.Record( FRAME_PRESENT, TraceNow() - t );
 
     // If the device was reset we must completely reinitialize the renderer.
     if (hr == DXGI_ERROR_DEVICE_REMOVED || hr == DXGI_ERROR_DEVICE_RESET)
@@ -781,6 +605,15 @@ void Game::OnKeydown(int keycode) {
 	OutputDebugString(s);
 
 	if (keycode == 'Q' ) exit(0);
+    // T starts recording zones, pressing it again writes them out (AMOEBA_TRACE builds).
+    if( keycode == 'T' ) {
+        if( TraceIsRecording() ) {
+            TraceStop();
+            if( !TraceWrite( "amoeba_trace.json" ) ) print( "can't write amoeba_trace.json" );
+        } else {
+            TraceStart();
+        }
+    }
 #ifndef USE_SHINRA_API    
 	if (keycode == 'P') {
         AddPlayer(0);
@@ -813,11 +646,6 @@ XMFLOAT4 Game::GetPlayerColor( int index ) {
 }
 
 
-void Game::onBodySeparated( cpBody *bodyA, cpBody *bodyB ) {
-}
-
-void Game::onBodyJointed( cpBody *bodyA, cpBody *bodyB ) {
-}
 void Game::PlaySEForAll( SE_ID se_id ) {
 #ifdef USE_SHINRA_API
     int n = MAX_PLAYER_NUM;
@@ -830,14 +658,16 @@ void Game::PlaySEForAll( SE_ID se_id ) {
         if(pl)pl->PlaySE(se_id);
     }
 }
-void Game::onBodyCollide( cpBody *bodyA, cpBody *bodyB ) {
-    cpVect veloA = cpBodyGetVelocity(bodyA);
-    cpVect veloB = cpBodyGetVelocity(bodyB);
-    float relvelo = len( veloA.x, veloA.y, veloB.x, veloB.y );
-    //    print("onBodyCollide: %.2f", relvelo );
+// Called once per Sim::Update, so a pile-up plays the sound once instead of once per contact.
+void Game::onSimEvents( const SimEvent *events, int count, const SimGroupEvents *groups, int groupNum ) {
+    float relvelo = 0;
+    for(int i=0;i<groupNum;i++) {
+        if( groups[i].maxCollideSpeed > relvelo ) relvelo = groups[i].maxCollideSpeed;
+    }
+    //    print("onSimEvents: %d events, %.2f", count, relvelo );
     if( relvelo > 400 ) {
         PlaySEForAll( SE_JOIN );
-    }    
+    }
 }
 // return false when max player
 bool Game::AddPlayer( shinra::PlayerID playerID ) {
@@ -852,31 +682,7 @@ bool Game::AddPlayer( shinra::PlayerID playerID ) {
     }
     if(pl==nullptr) return false;
 
-    float dia;
-    cpVect center = GetPlayerDefaultPosition( pl->GetGroupId(), &dia );
-    
-    int n = CELL_NUM_PER_PLAYER;
-	for(int i=0; i<n; i++){
-        int prio, eye_id=-1;
-        if(i==0 ||i==1) {
-            eye_id = i;
-            prio = CELL_PRIO_HIGH;
-        } else {
-            prio = CELL_PRIO_LOW; // draw eyes always on other cells
-        }
-        
-        BodyState *bs = new BodyState(prio,pl->GetGroupId(),eye_id, this);
-
-        cpVect p = cpv( cpflerp(center.x-dia, center.x+dia, frand()), cpflerp(center.y-dia, center.y+dia, frand() ) );
-        cpBody *body = CreateCellBody(p, bs, eye_id >= 0 );
-
-        if( eye_id == 0 ) pl->SetLeftEye(body);
-        else if( eye_id == 1 ) pl->SetRightEye(body);
-
-	}
-    // add springs between eyes
-    cpSpaceAddConstraint( m_space, new_spring( pl->GetLeftEye(), pl->GetRightEye(), cpv(0,0),cpv(0,0), 70, 110, 0.1 ) );
-    return true;
+    return m_sim->AddGroup( pl->GetGroupId() );
 }
 
 void Game::RemovePlayer( shinra::PlayerID playerID ) {
@@ -895,61 +701,7 @@ Player *Game::GetPlayer( int group_id ) {
     assert( group_id >= 0 && group_id < MAX_PLAYER_NUM );
     return m_players[group_id];
 }
-cpVect Game::GetPlayerDefaultPosition( int index, float *dia ) {
-    size_t w,h;
-    GetDefaultSize(w,h);
-    float wf = (float)w, hf = (float)h;
-
-    *dia = wf/6.0f;
-    
-    /*
-            |
-         0  |  1
-            |   
-       -----O----
-            |
-         2  |  3
-            |
-
-       O: (0,0) in ChipMunk
-       
-     */
-    index = index % 4;
-    switch(index) {
-    case 0: return cpv( -wf/4, hf/4);
-    case 1: return cpv( wf/4, hf/4 );
-    case 2: return cpv( -wf/4, -hf/4 );
-    case 3: return cpv( wf/4, -hf/4 );        
-    }
-    return cpv(0,0);
-}
-
-struct CleanCallbackOpts {
-    Game *game;
-    int group_id;
-};
-void eachBodyCleanCallback( cpBody *body, void *data ) {
-    CleanCallbackOpts *opts = (CleanCallbackOpts*)data;
-    BodyState *bs = (BodyState*) cpBodyGetUserData(body);
-    if( bs->group_id == opts->group_id ) {
-        cpBodyEachShape(body, eachShapeDeleteCallback, opts->game );
-        cpBodyEachConstraint(body, eachConstraintDeleteCallback, opts->game );        
-        PostBodyFree( body, opts->game->GetSpace() );
-    }
-}
-void Game::CleanGroup( int groupid ) {
-    CleanCallbackOpts opts;
-    opts.game = this;
-    opts.group_id = groupid;
-    cpSpaceEachBody( m_space, eachBodyCleanCallback, (void*) & opts );
-}
-
-Player::Player( shinra::PlayerID playerID, Game *game, int group_id ) : m_playerID(playerID), game(game), group_id(group_id), m_cellCount(0) {        
-    for(int i=0;i<2;i++) {
-        m_eyes[i]=nullptr;
-        m_forces[i]=XMFLOAT2(0,0);
-    }
-
+Player::Player( shinra::PlayerID playerID, Game *game, int group_id ) : m_playerID(playerID), game(game), group_id(group_id) {        
     // Audio
     AUDIO_ENGINE_FLAGS eflags = AudioEngine_Default;
     /* TODO: debug engine is not currently support in Shinra Audio Layer.
@@ -1035,6 +787,7 @@ Player::~Player() {
     delete m_brokenSE, *m_joinSE, *m_bgm;    
 }
 void Player::Update( float elapsedTime ) {
+    TRACE_ZONE( "Player::Update" );
 	m_audioEngine->Update();
     if (m_audioEngine->IsCriticalError()) {
         OutputDebugString(L"AudioEngine error!");
@@ -20,6 +20,9 @@
 #include "Main.h"
 #include "AnimatedTexture.h"
 #include "Util.h"
+#include "Sim.h"
+#include "FrameStats.h"
+#include "Replay.h"
 
 #include <math.h>
 
@@ -28,15 +31,6 @@ using namespace Microsoft::WRL;
 using Microsoft::WRL::ComPtr;
 
 
-#define MAX_PLAYER_NUM 4
-#define HP_CONSUME_SPEED 0.2
-#define CELL_RADIUS 10.0f
-#define BODY_CELL_NUM_PER_PLAYER 100
-#define CELL_NUM_PER_PLAYER ( 2 + BODY_CELL_NUM_PER_PLAYER )
-#define TOTAL_CELL_NUM (CELL_NUM_PER_PLAYER * MAX_PLAYER_NUM )
-
-
-
 //////////////
 class Game;
 
@@ -55,23 +49,14 @@ public:
     void Clear();
     
     //    void handleInput(const RAWINPUT& rawInput);
-    void SetLeftEye(cpBody *bd) { m_eyes[0] = bd; }
-    void SetRightEye(cpBody *bd) { m_eyes[1] = bd; }
-    cpBody *GetLeftEye() { return m_eyes[0]; }
-    cpBody *GetRightEye() { return m_eyes[1]; }    
-    void SetForce( XMFLOAT2 lf, XMFLOAT2 rf ) { m_forces[0] = lf; m_forces[1] = rf; };
-    XMFLOAT2 GetLeftForce() { return m_forces[0];  };
-    XMFLOAT2 GetRightForce() { return m_forces[1]; };    
-    void IncrementCellCount() { m_cellCount ++; }
-    void ResetCellCount() { m_cellCount=0; }
-    int GetCellCount() { return m_cellCount; }
-    void ResetCells();
+    void SetForce( XMFLOAT2 lf, XMFLOAT2 rf );
+    int GetCellCount();
     void CleanCells();
     int GetGroupId() { return group_id; }
     void PlaySE( SE_ID se_id );
     PrimitiveBatch<VertexPositionColor> *GetPrimBatch() { return m_primBatch; }
     SpriteBatch *GetSpriteBatch() { return m_spriteBatch; }
-    void DrawBody( cpBody *body );
+    void DrawBody( BodyStatePool *cells, int i );
     
     Player( shinra::PlayerID playerID, Game *game, int group_id );
     ~Player();
@@ -81,9 +66,6 @@ private:
     shinra::PlayerID m_playerID;
     Game *game;
     int group_id;
-    int m_cellCount;
-    cpBody *m_eyes[2]; // 0:Left 1:Right
-    XMFLOAT2 m_forces[2]; // 0:Left 1:Right
     
     // Graphics Resources
 
@@ -103,11 +85,9 @@ private:
 };
 
 
-class BodyState;
-
 // A basic game implementation that creates a D3D11 device and
 // provides a game loop
-class Game
+class Game : public SimListener
 {
 public:
 
@@ -136,19 +116,15 @@ public:
     static void GetDefaultSize( size_t& width, size_t& height );
     static XMFLOAT4 GetPlayerColor( int index );
 
-    cpSpace *GetSpace() { return m_space; };
+    Sim *GetSim() { return m_sim; };
+    FrameStats *GetFrameStats() { return &m_frameStats; }
+    cpSpace *GetSpace() { return m_sim->GetSpace(); };
 
-    void onBodySeparated( cpBody *bodyA, cpBody *bodyB );
-    void onBodyJointed( cpBody *bodyA, cpBody *bodyB );
-    void onBodyCollide( cpBody *bodyA, cpBody *bodyB );    
+    virtual void onSimEvents( const SimEvent *events, int count, const SimGroupEvents *groups, int groupNum );
     bool AddPlayer( shinra::PlayerID playerID );
     void RemovePlayer(shinra::PlayerID playerID );
     Player *GetPlayer( int groupId );
-    static cpVect GetPlayerDefaultPosition( int index, float *dia );
-
-    cpBody *CreateCellBody( cpVect pos, BodyState *bs, bool is_eye );
 
-    void CleanGroup( int groupId );
     void PlaySEForAll( SE_ID se_id );
     Microsoft::WRL::ComPtr<ID3D11Device> GetD3DDevice() { return m_d3dDevice; }
     Microsoft::WRL::ComPtr<ID3D11DeviceContext> GetD3DContext() { return m_d3dContext; }
@@ -188,11 +164,13 @@ private:
     
     // Game state
     DX::StepTimer                                   m_timer;
+    FrameStats                                      m_frameStats;
 	int m_framecnt;
     Player *m_players[MAX_PLAYER_NUM];
 
     // chipmunk related
-    struct cpSpace *m_space;
+    Sim *m_sim;
+    ReplayRecorder m_replay;
 
     //	AudioEngine *m_audioEngine;
     
@@ -1,9 +1,13 @@
-#include "pch.h"
-
 #include "chipmunk/chipmunk.h"
+#ifdef PHYS_HASTY_SPACE
+extern "C" {
+#include "chipmunk/cpHastySpace.h"
+}
+#endif
 
 #include "Phys.h"
-#include "Game.h"
+#include "Sim.h"
+#include "Trace.h"
 
 
 
@@ -13,117 +17,171 @@ cpShapeFilter NOT_GRABBABLE_FILTER = { CP_NO_GROUP, ~GRABBABLE_MASK_BIT, ~GRABBA
 // Physics
 
 
-void PostStepAddJoint(cpSpace *space, void *key, void *data)
-{
-//	printf("Adding joint for %p\n", data);
-	
-	cpConstraint *joint = (cpConstraint *)key;
-	cpSpaceAddConstraint(space, joint);
-}
+// The sticky joints themselves are made by the space, see cpShapeSetAdhesion().
+// Cells are skinned by STICK_SENSOR_THICKNESS so they can squish into each other,
+// which keeps them from separating and destroying the joint.
 
-cpBool StickyPreSolve(cpArbiter *arb, cpSpace *space, void *data)
+cpBool StickyBegin(cpArbiter *arb, cpSpace *space, void *data)
 {
-	// We want to fudge the collisions a bit to allow shapes to overlap more.
-	// This simulates their squishy sticky surface, and more importantly
-	// keeps them from separating and destroying the joint.
-	
-	// Track the deepest collision point and use that to determine if a rigid collision should occur.
-	cpFloat deepest = INFINITY;
-	
-	// Grab the contact set and iterate over them.
-	cpContactPointSet contacts = cpArbiterGetContactPointSet(arb);
-	for(int i=0; i<contacts.count; i++){
-		// Sink the contact points into the surface of each shape.
-		contacts.points[i].pointA = cpvsub(contacts.points[i].pointA, cpvmult(contacts.normal, STICK_SENSOR_THICKNESS));
-		contacts.points[i].pointB = cpvadd(contacts.points[i].pointB, cpvmult(contacts.normal, STICK_SENSOR_THICKNESS));
-		deepest = cpfmin(deepest, contacts.points[i].distance);// + 2.0f*STICK_SENSOR_THICKNESS);
-	}
-	
-	// Set the new contact point data.
-	cpArbiterSetContactPointSet(arb, &contacts);
-	
-	// If the shapes are overlapping enough, then create a
-	// joint that sticks them together at the first contact point.
-	if(!cpArbiterGetUserData(arb) && deepest <= 0.0f){
+	CP_ARBITER_GET_SHAPES(arb, a, b);
+
+	// Shapes that won't stick together just bump into each other.
+	if( cpShapeGetAdhesion(a) == 0 || cpShapeGetAdhesion(b) == 0 || cpShapeGetAdhesionGroup(a) != cpShapeGetAdhesionGroup(b) ) {
 		CP_ARBITER_GET_BODIES(arb, bodyA, bodyB);
-	
-		// Create a joint at the contact point to hold the body in place.
-		cpVect anchorA = cpBodyWorldToLocal(bodyA, contacts.points[0].pointA);
-		cpVect anchorB = cpBodyWorldToLocal(bodyB, contacts.points[0].pointB);
-		cpConstraint *joint = NULL;
-
-        BodyState *bsA = (BodyState*) cpBodyGetUserData(bodyA);
-        BodyState *bsB = (BodyState*) cpBodyGetUserData(bodyB);
-		if ( bsA && bsB && bsA->group_id == bsB->group_id ) {
-			joint = cpPivotJointNew2(bodyA, bodyB, anchorA, anchorB);
-
-			// Give it a finite force for the stickyness.
-			cpConstraintSetMaxForce(joint, 4e3);
-
-			// Schedule a post-step() callback to add the joint.
-			cpSpaceAddPostStepCallback(space, PostStepAddJoint, joint, NULL);
-
-			// Store the joint on the arbiter so we can remove it later.
-			cpArbiterSetUserData(arb, joint);
-            Game *game = bsA->game;
-            game->onBodyJointed(bodyA,bodyB);
-		} else {
-            Game *game = bsA->game;
-            game->onBodyCollide(bodyA,bodyB);
-        }
+		Sim *sim = (Sim*) cpSpaceGetUserData(space);
+		sim->onBodyCollide(bodyA, bodyB);
 	}
-	
-	// Position correction and velocity are handled separately so changing
-	// the overlap distance alone won't prevent the collision from occuring.
-	// Explicitly the collision for this frame if the shapes don't overlap using the new distance.
-	return (deepest <= 0.0f);
-	
-	// Lots more that you could improve upon here as well:
-	// * Modify the joint over time to make it plastic.
-	// * Modify the joint in the post-step to make it conditionally plastic (like clay).
-	// * Track a joint for the deepest contact point instead of the first.
-	// * Track a joint for each contact point. (more complicated since you only get one data pointer).
+	return cpTrue;
 }
 
-void PostStepRemoveJoint(cpSpace *space, void *key, void *data)
+void StickyJoin(cpSpace *space, cpConstraint *joint, void *data)
 {
-//	printf("Removing joint for %p\n", data);
-	
-	cpConstraint *joint = (cpConstraint *)key;
-	cpSpaceRemoveConstraint(space, joint);
-	cpConstraintFree(joint);
+	Sim *sim = (Sim*) data;
+	sim->onBodyJointed( cpConstraintGetBodyA(joint), cpConstraintGetBodyB(joint), joint );
 }
 
-void StickySeparate(cpArbiter *arb, cpSpace *space, void *data)
+void StickySeparate(cpSpace *space, cpConstraint *joint, void *data)
 {
-	cpConstraint *joint = (cpConstraint *)cpArbiterGetUserData(arb);
-	
-	if(joint){
-		// The joint won't be removed until the step is done.
-		// Need to disable it so that it won't apply itself.
-		// Setting the force to 0 will do just that
-		cpConstraintSetMaxForce(joint, 0.0f);
-		
-		// Perform the removal in a post-step() callback.
-		cpSpaceAddPostStepCallback(space, PostStepRemoveJoint, joint, NULL);
-		
-		// NULL out the reference to the joint.
-		// Not required, but it's a good practice.
-		cpArbiterSetUserData(arb, NULL);
-
-        cpBody *bodyA = cpConstraintGetBodyA(joint);
-        cpBody *bodyB = cpConstraintGetBodyB(joint);        
-        BodyState *bs = (BodyState*) cpBodyGetUserData(bodyA);
-        Game *game = bs->game;
-        game->onBodySeparated( bodyA, bodyB );
+	// The space frees the joint as soon as this returns.
+	Sim *sim = (Sim*) data;
+	sim->onBodySeparated( cpConstraintGetBodyA(joint), cpConstraintGetBodyB(joint), joint );
+}
+
+void BodyStatePool::Reserve( int n ) {
+    body.reserve(n); handle.reserve(n); hp.reserve(n); group_id.reserve(n);
+    eye_id.reserve(n); force.reserve(n); radius.reserve(n); draw_priority.reserve(n);
+    m_index.reserve(n+1); m_freeHandles.reserve(n);
+}
+
+BodyHandle BodyStatePool::Alloc( cpBody *b, int prio, int gid, int eid ) {
+    BodyHandle h;
+    if( m_freeHandles.empty() ) {
+        h = (BodyHandle) m_index.size();
+        m_index.push_back(-1);
+    } else {
+        h = m_freeHandles.back();
+        m_freeHandles.pop_back();
+    }
+    m_index[h] = Count();
+    body.push_back(b);
+    handle.push_back(h);
+    hp.push_back(BODY_MAXHP);
+    group_id.push_back(gid);
+    eye_id.push_back(eid);
+    force.push_back(0);
+    radius.push_back(0);
+    draw_priority.push_back(prio);
+    return h;
+}
+
+void BodyStatePool::Free( BodyHandle h ) {
+    int i = m_index[h];
+    int last = Count() - 1;
+    if( i != last ) {
+        // Move the last cell into the hole to keep the arrays packed.
+        body[i] = body[last];
+        handle[i] = handle[last];
+        hp[i] = hp[last];
+        group_id[i] = group_id[last];
+        eye_id[i] = eye_id[last];
+        force[i] = force[last];
+        radius[i] = radius[last];
+        draw_priority[i] = draw_priority[last];
+        m_index[handle[i]] = i;
+    }
+    body.pop_back(); handle.pop_back(); hp.pop_back(); group_id.pop_back();
+    eye_id.pop_back(); force.pop_back(); radius.pop_back(); draw_priority.pop_back();
+    m_index[h] = -1;
+    m_freeHandles.push_back(h);
+}
+
+#ifdef PHYS_HASTY_SPACE
+cpSpace *PhysNewSpace()
+{
+	return cpHastySpaceNew();
+}
+
+void PhysFreeSpace(cpSpace *space)
+{
+	cpHastySpaceFree(space);
+}
+
+void PhysSetSpaceThreads(cpSpace *space, int threads)
+{
+	cpHastySpaceSetThreads(space, threads);
+}
+
+int PhysGetSpaceThreads(cpSpace *space)
+{
+	return (int)cpHastySpaceGetThreads(space);
+}
+
+void PhysReserveSpace(cpSpace *space, int pairs, int contacts, int joints)
+{
+	cpHastySpaceReserve(space, pairs, contacts, joints);
+}
+
+void PhysUpdateSpace(cpSpace *space, double dt)
+{
+	TRACE_ZONE("PhysUpdateSpace");
+	cpHastySpaceStep(space, dt);
+}
+
+#ifdef AMOEBA_TRACE
+// Each thread records its share of the job as a zone on its own ring.
+static void traceWork(const char *name, unsigned long thread, cpBool begin, void *data)
+{
+	if(begin){
+		if(thread > 0) TraceNameThread("chipmunk worker", (int)thread);
+		TraceBegin(name);
+	} else {
+		TraceEnd();
 	}
 }
+#endif
+
+void PhysTraceSpace(cpSpace *space)
+{
+#ifdef AMOEBA_TRACE
+	cpHastySpaceSetWorkHook(space, traceWork, NULL);
+#endif
+}
+#else
+cpSpace *PhysNewSpace()
+{
+	return cpSpaceNew();
+}
+
+void PhysFreeSpace(cpSpace *space)
+{
+	cpSpaceFree(space);
+}
+
+void PhysSetSpaceThreads(cpSpace *space, int threads)
+{
+}
+
+int PhysGetSpaceThreads(cpSpace *space)
+{
+	return 1;
+}
+
+void PhysReserveSpace(cpSpace *space, int pairs, int contacts, int joints)
+{
+	cpSpaceReserve(space, pairs, contacts, joints);
+}
 
 void PhysUpdateSpace(cpSpace *space, double dt)
 {
+	TRACE_ZONE("PhysUpdateSpace");
 	cpSpaceStep(space, dt);
 }
 
+void PhysTraceSpace(cpSpace *space)
+{
+}
+#endif
+
 static cpFloat springForce(cpConstraint *spring, cpFloat dist)
 {
 	cpFloat clamp = 200000.0f;
@@ -1,13 +1,24 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
 
 #include "chipmunk/chipmunk.h"
 #include "ChipmunkDemo.h"
 
-void PostStepAddJoint(cpSpace *space, void *key, void *data);
-cpBool StickyPreSolve(cpArbiter *arb, cpSpace *space, void *data);
-void PostStepRemoveJoint(cpSpace *space, void *key, void *data);
-void StickySeparate(cpArbiter *arb, cpSpace *space, void *data);
+cpBool StickyBegin(cpArbiter *arb, cpSpace *space, void *data);
+void StickyJoin(cpSpace *space, cpConstraint *joint, void *data);
+void StickySeparate(cpSpace *space, cpConstraint *joint, void *data);
 
+// The space is a cpHastySpace when built with PHYS_HASTY_SPACE (needs pthreads), otherwise a plain cpSpace.
+cpSpace *PhysNewSpace();
+void PhysFreeSpace(cpSpace *space);
+void PhysSetSpaceThreads(cpSpace *space, int threads);
+int PhysGetSpaceThreads(cpSpace *space);
+void PhysReserveSpace(cpSpace *space, int pairs, int contacts, int joints);
 void PhysUpdateSpace(cpSpace *space, double dt);
+// Records the jobs of the solver threads as trace zones, only in AMOEBA_TRACE builds of the hasty space.
+void PhysTraceSpace(cpSpace *space);
 
 
 
@@ -17,29 +28,50 @@ enum {
 };
 
 #define STICK_SENSOR_THICKNESS 2.0f
+#define STICK_MAX_FORCE 4e3f
 
 
-#define GRABBABLE_MASK_BIT (1<<31)
+#define GRABBABLE_MASK_BIT (1u<<31)
 extern cpShapeFilter GRAB_FILTER;
 extern cpShapeFilter NOT_GRABBABLE_FILTER;
 
 
-class Game;
-
-class BodyState {
-public:
 #define CELL_PRIO_HIGH 1
 #define CELL_PRIO_LOW 0
-	int draw_priority;
-    int group_id;
-    int eye_id; // -1 for normal, 0,1 for eyes (left/right joystick)
-    float force;
-    float hp;
 #define BODY_MAXHP 100
-    Game *game;
-    float radius;
-	BodyState(int prio, int gid, int eye_id, Game *game) : draw_priority(prio), group_id(gid), eye_id(eye_id), force(0), hp(BODY_MAXHP), game(game), radius(0) {};
-    float GetHPRate() { return hp / (float)BODY_MAXHP; }
+
+// Handle of a cell's state, stored in the cpBody userData. 0 is "no state" (walls).
+typedef int BodyHandle;
+#define BODY_HANDLE_NONE 0
+
+inline BodyHandle GetBodyHandle( cpBody *body ) { return (BodyHandle)(intptr_t) cpBodyGetUserData(body); }
+
+// Per cell game state, held as structure-of-arrays.
+// Live cells are packed in [0,Count()) so the per frame passes stream over the arrays;
+// handles stay valid while other cells come and go.
+class BodyStatePool {
+public:
+    BodyStatePool() : m_index(1, -1) {}
+    void Reserve( int n );
+    BodyHandle Alloc( cpBody *body, int prio, int gid, int eye_id );
+    void Free( BodyHandle h );
+    int Count() { return (int)body.size(); }
+    int IndexOf( BodyHandle h ) { return m_index[h]; }
+    int IndexOf( cpBody *b ) { return m_index[GetBodyHandle(b)]; }
+    float GetHPRate( int i ) { return hp[i] / (float)BODY_MAXHP; }
+
+    std::vector<cpBody*> body;
+    std::vector<BodyHandle> handle;
+    std::vector<float> hp;
+    std::vector<int> group_id;
+    std::vector<int> eye_id; // -1 for normal, 0,1 for eyes (left/right joystick)
+    std::vector<float> force;
+    std::vector<float> radius;
+    std::vector<int> draw_priority;
+
+private:
+    std::vector<int> m_index; // handle -> index in the arrays above, -1 when free
+    std::vector<BodyHandle> m_freeHandles;
 };
 
 
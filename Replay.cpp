@@ -0,0 +1,410 @@
+//
+// Replay.cpp - Input recording and playback
+//
+#include <string.h>
+
+#include "Replay.h"
+
+// The file is the header followed by records, each a tag byte and its fields, all little endian:
+//   REPLAY_TAG_UPDATE          ends a tick
+//   REPLAY_TAG_ADD_GROUP       u16 group
+//   REPLAY_TAG_REMOVE_GROUP    u16 group
+//   REPLAY_TAG_FORCE           u16 group, f32 left x,y right x,y
+//   REPLAY_TAG_DT              f64 time step of this and the following updates
+//   REPLAY_TAG_KEYFRAME        u32 tick, u64 state hash, u32 size, the snapshot
+// A keyframe comes before the inputs of its tick.
+#define REPLAY_MAGIC "AMRP"
+#define REPLAY_VERSION 1
+
+enum ReplayTag
+{
+    REPLAY_TAG_UPDATE = 1,
+    REPLAY_TAG_ADD_GROUP,
+    REPLAY_TAG_REMOVE_GROUP,
+    REPLAY_TAG_FORCE,
+    REPLAY_TAG_DT,
+    REPLAY_TAG_KEYFRAME,
+};
+
+static void Put( std::vector<uint8_t> &buf, uint64_t v, int bytes ) {
+    for(int i=0;i<bytes;i++) buf.push_back( (uint8_t)(v >> (8*i)) );
+}
+static void PutF32( std::vector<uint8_t> &buf, float f ) {
+    uint32_t v;
+    memcpy( &v, &f, 4 );
+    Put( buf, v, 4 );
+}
+static void PutF64( std::vector<uint8_t> &buf, double f ) {
+    uint64_t v;
+    memcpy( &v, &f, 8 );
+    Put( buf, v, 8 );
+}
+
+// Reads fields off a span of the file, past the end everything is 0 and ok turns false.
+struct ReplayReader
+{
+    const uint8_t *p, *end;
+    bool ok;
+    ReplayReader( const uint8_t *p, const uint8_t *end ) : p(p), end(end), ok(true) {}
+    uint64_t Get( int bytes ) {
+        if( end - p < bytes ) {
+            ok = false;
+            p = end;
+            return 0;
+        }
+        uint64_t v = 0;
+        for(int i=0;i<bytes;i++) v |= (uint64_t)p[i] << (8*i);
+        p += bytes;
+        return v;
+    }
+    float GetF32() {
+        uint32_t v = (uint32_t)Get(4);
+        float f;
+        memcpy( &f, &v, 4 );
+        return f;
+    }
+    double GetF64() {
+        uint64_t v = Get(8);
+        double f;
+        memcpy( &f, &v, 8 );
+        return f;
+    }
+};
+
+// Cells take 56 bytes, the sticks are floats already (Sim::SetForce).
+static void PutSnapshot( std::vector<uint8_t> &buf, const SimSnapshot &s ) {
+    Put( buf, s.rng, 8 );
+    Put( buf, s.active.size(), 4 );
+    for(unsigned int i=0;i<s.active.size();i++) {
+        Put( buf, s.active[i] ? 1 : 0, 1 );
+        for(int k=0;k<2;k++) {
+            PutF32( buf, (float)s.forces[2*i+k].x );
+            PutF32( buf, (float)s.forces[2*i+k].y );
+        }
+    }
+    Put( buf, s.cells.size(), 4 );
+    for(unsigned int i=0;i<s.cells.size();i++) {
+        const SimCellState &c = s.cells[i];
+        Put( buf, c.groupId, 2 );
+        Put( buf, (uint8_t)c.eyeId, 1 );
+        Put( buf, (uint8_t)c.prio, 1 );
+        PutF32( buf, c.hp );
+        PutF64( buf, c.pos.x ); PutF64( buf, c.pos.y );
+        PutF64( buf, c.vel.x ); PutF64( buf, c.vel.y );
+        PutF64( buf, c.angle ); PutF64( buf, c.angVel );
+    }
+}
+
+static bool GetSnapshot( ReplayReader &r, SimSnapshot *s ) {
+    s->rng = r.Get(8);
+    uint32_t groupNum = (uint32_t)r.Get(4);
+    if( !r.ok || groupNum > (uint32_t)(r.end - r.p) ) return false;
+    s->active.resize( groupNum );
+    s->forces.resize( 2 * groupNum );
+    for(uint32_t i=0;i<groupNum;i++) {
+        s->active[i] = r.Get(1) != 0;
+        for(int k=0;k<2;k++) {
+            float x = r.GetF32(), y = r.GetF32();
+            s->forces[2*i+k] = cpv( x, y );
+        }
+    }
+    uint32_t cellNum = (uint32_t)r.Get(4);
+    if( !r.ok || cellNum > (uint32_t)(r.end - r.p) ) return false;
+    s->cells.resize( cellNum );
+    for(uint32_t i=0;i<cellNum;i++) {
+        SimCellState &c = s->cells[i];
+        c.groupId = (int)r.Get(2);
+        c.eyeId = (int8_t)r.Get(1);
+        c.prio = (int8_t)r.Get(1);
+        c.hp = r.GetF32();
+        double px = r.GetF64(), py = r.GetF64();
+        double vx = r.GetF64(), vy = r.GetF64();
+        c.pos = cpv( px, py );
+        c.vel = cpv( vx, vy );
+        c.angle = r.GetF64();
+        c.angVel = r.GetF64();
+        if( c.groupId >= (int)groupNum || c.eyeId > 1 ) return false;
+    }
+    return r.ok;
+}
+
+//////////////////////
+
+ReplayRecorder::ReplayRecorder() :
+    m_fp(nullptr),
+    m_sim(nullptr),
+    m_keyframeTicks(REPLAY_KEYFRAME_TICKS),
+    m_tick(0),
+    m_tickStarted(false),
+    m_dt(0)
+{
+}
+
+ReplayRecorder::~ReplayRecorder() {
+    Close();
+}
+
+bool ReplayRecorder::Open( const char *path, Sim *sim, double dt, int keyframeTicks ) {
+    Close();
+    if( sim->GetGroupNum() > 0xffff || keyframeTicks <= 0 ) return false;
+    m_fp = fopen( path, "wb" );
+    if( !m_fp ) return false;
+
+    m_sim = sim;
+    m_keyframeTicks = keyframeTicks;
+    m_tick = 0;
+    m_dt = dt;
+    m_forces.resize( 2 * sim->GetGroupNum() );
+    for(int i=0;i<sim->GetGroupNum();i++) {
+        m_forces[2*i] = sim->GetForce( i, 0 );
+        m_forces[2*i+1] = sim->GetForce( i, 1 );
+    }
+
+    m_buf.clear();
+    for(int i=0;i<4;i++) m_buf.push_back( REPLAY_MAGIC[i] );
+    Put( m_buf, REPLAY_VERSION, 4 );
+    Put( m_buf, sim->GetSeed(), 4 );
+    Put( m_buf, sim->GetGroupNum(), 4 );
+    Put( m_buf, sim->GetBodyCellNum(), 4 );
+    PutF32( m_buf, sim->GetWidth() );
+    PutF32( m_buf, sim->GetHeight() );
+    Put( m_buf, sim->UsesGrid() ? 1 : 0, 1 );
+    PutF64( m_buf, dt );
+    Put( m_buf, keyframeTicks, 4 );
+    fwrite( &m_buf[0], 1, m_buf.size(), m_fp );
+
+    // Tick 0 starts with the sim as it is now.
+    m_tickStarted = false;
+    BeginTick( sim );
+    sim->SetInputListener( this );
+    return true;
+}
+
+void ReplayRecorder::Close() {
+    if( !m_fp ) return;
+    m_sim->SetInputListener( nullptr );
+    fclose( m_fp );
+    m_fp = nullptr;
+    m_sim = nullptr;
+}
+
+void ReplayRecorder::BeginTick( Sim *sim ) {
+    if( m_tickStarted ) return;
+    m_tickStarted = true;
+    if( m_tick % m_keyframeTicks == 0 ) WriteKeyframe( sim );
+}
+
+void ReplayRecorder::WriteKeyframe( Sim *sim ) {
+    sim->Save( &m_snapshot );
+    m_buf.clear();
+    Put( m_buf, REPLAY_TAG_KEYFRAME, 1 );
+    Put( m_buf, m_tick, 4 );
+    Put( m_buf, sim->GetStateHash(), 8 );
+    size_t sizeAt = m_buf.size();
+    Put( m_buf, 0, 4 );
+    PutSnapshot( m_buf, m_snapshot );
+    uint32_t size = (uint32_t)( m_buf.size() - sizeAt - 4 );
+    for(int i=0;i<4;i++) m_buf[sizeAt+i] = (uint8_t)(size >> (8*i));
+    fwrite( &m_buf[0], 1, m_buf.size(), m_fp );
+    // A crashed game still leaves everything up to here.
+    fflush( m_fp );
+}
+
+void ReplayRecorder::onSimAddGroup( Sim *sim, int groupId ) {
+    BeginTick( sim );
+    uint8_t rec[3] = { REPLAY_TAG_ADD_GROUP, (uint8_t)groupId, (uint8_t)(groupId >> 8) };
+    fwrite( rec, 1, sizeof(rec), m_fp );
+}
+
+void ReplayRecorder::onSimRemoveGroup( Sim *sim, int groupId ) {
+    BeginTick( sim );
+    uint8_t rec[3] = { REPLAY_TAG_REMOVE_GROUP, (uint8_t)groupId, (uint8_t)(groupId >> 8) };
+    fwrite( rec, 1, sizeof(rec), m_fp );
+    // RemoveGroup clears the sticks.
+    m_forces[2*groupId] = m_forces[2*groupId+1] = cpvzero;
+}
+
+void ReplayRecorder::onSimSetForce( Sim *sim, int groupId, cpVect lf, cpVect rf ) {
+    if( cpveql( lf, m_forces[2*groupId] ) && cpveql( rf, m_forces[2*groupId+1] ) ) return;
+    BeginTick( sim );
+    m_forces[2*groupId] = lf;
+    m_forces[2*groupId+1] = rf;
+    m_buf.clear();
+    Put( m_buf, REPLAY_TAG_FORCE, 1 );
+    Put( m_buf, groupId, 2 );
+    PutF32( m_buf, (float)lf.x ); PutF32( m_buf, (float)lf.y );
+    PutF32( m_buf, (float)rf.x ); PutF32( m_buf, (float)rf.y );
+    fwrite( &m_buf[0], 1, m_buf.size(), m_fp );
+}
+
+void ReplayRecorder::onSimUpdate( Sim *sim, double dt ) {
+    BeginTick( sim );
+    m_buf.clear();
+    if( dt != m_dt ) {
+        Put( m_buf, REPLAY_TAG_DT, 1 );
+        PutF64( m_buf, dt );
+        m_dt = dt;
+    }
+    Put( m_buf, REPLAY_TAG_UPDATE, 1 );
+    fwrite( &m_buf[0], 1, m_buf.size(), m_fp );
+    m_tick++;
+    m_tickStarted = false;
+}
+
+//////////////////////
+
+ReplayPlayer::ReplayPlayer() :
+    m_tick(0),
+    m_dt(0),
+    m_exact(false),
+    m_mismatchNum(0),
+    m_firstMismatch(-1)
+{
+    memset( &m_header, 0, sizeof(m_header) );
+}
+
+bool ReplayPlayer::Open( const char *path ) {
+    FILE *fp = fopen( path, "rb" );
+    if( !fp ) return false;
+    m_data.clear();
+    uint8_t chunk[65536];
+    size_t n;
+    while( (n = fread( chunk, 1, sizeof(chunk), fp )) > 0 ) m_data.insert( m_data.end(), chunk, chunk + n );
+    fclose( fp );
+
+    m_ticks.clear();
+    m_keyframes.clear();
+    if( m_data.size() < 4 || memcmp( &m_data[0], REPLAY_MAGIC, 4 ) != 0 ) return false;
+    ReplayReader r( &m_data[0] + 4, &m_data[0] + m_data.size() );
+    if( r.Get(4) != REPLAY_VERSION ) return false;
+    m_header.seed = (uint32_t)r.Get(4);
+    m_header.groupNum = (int)r.Get(4);
+    m_header.bodyCellNum = (int)r.Get(4);
+    m_header.width = r.GetF32();
+    m_header.height = r.GetF32();
+    m_header.useGrid = r.Get(1) != 0;
+    m_header.dt = r.GetF64();
+    m_header.keyframeTicks = (int)r.Get(4);
+    if( !r.ok || m_header.groupNum <= 0 || m_header.groupNum > 0xffff || m_header.bodyCellNum < 0 ) return false;
+
+    // Index the ticks and keyframes, a record cut off at the end drops its tick.
+    double dt = m_header.dt;
+    size_t tickStart = r.p - &m_data[0];
+    while( r.ok && r.p < r.end ) {
+        int tag = (int)r.Get(1);
+        switch( tag ) {
+        case REPLAY_TAG_UPDATE:
+            m_ticks.push_back( tickStart );
+            tickStart = r.p - &m_data[0];
+            break;
+        case REPLAY_TAG_ADD_GROUP:
+        case REPLAY_TAG_REMOVE_GROUP:
+            if( (int)r.Get(2) >= m_header.groupNum ) r.ok = false;
+            break;
+        case REPLAY_TAG_FORCE:
+            if( (int)r.Get(2) >= m_header.groupNum ) r.ok = false;
+            r.Get(8);
+            r.Get(8);
+            break;
+        case REPLAY_TAG_DT:
+            dt = r.GetF64();
+            break;
+        case REPLAY_TAG_KEYFRAME: {
+            Keyframe kf;
+            kf.tick = (int)r.Get(4);
+            r.Get(8);
+            kf.size = (size_t)r.Get(4);
+            kf.offset = r.p - &m_data[0];
+            kf.dt = dt;
+            if( !r.ok || kf.tick != (int)m_ticks.size() || kf.size > (size_t)(r.end - r.p) ) {
+                r.ok = false;
+                break;
+            }
+            r.p += kf.size;
+            m_keyframes.push_back( kf );
+            break;
+        }
+        default:
+            r.ok = false;
+            break;
+        }
+    }
+    return !m_keyframes.empty() && m_keyframes[0].tick == 0;
+}
+
+bool ReplayPlayer::ReadSnapshot( const Keyframe &kf, SimSnapshot *snapshot ) {
+    ReplayReader r( &m_data[0] + kf.offset, &m_data[0] + kf.offset + kf.size );
+    return GetSnapshot( r, snapshot ) && (int)snapshot->active.size() == m_header.groupNum;
+}
+
+Sim *ReplayPlayer::NewSim() {
+    SimSnapshot s;
+    if( m_keyframes.empty() || !ReadSnapshot( m_keyframes[0], &s ) ) return nullptr;
+    Sim *sim = new Sim( m_header.width, m_header.height, m_header.groupNum, m_header.useGrid, m_header.bodyCellNum );
+    sim->SetSeed( m_header.seed );
+    sim->Load( s );
+    // Nothing was lost if there was nothing to save.
+    m_exact = s.cells.empty();
+    m_tick = 0;
+    m_dt = m_header.dt;
+    m_mismatchNum = 0;
+    m_firstMismatch = -1;
+    return sim;
+}
+
+double ReplayPlayer::Next( Sim *sim ) {
+    if( m_tick >= GetTickNum() ) return 0;
+    // Open() checked the records, no bounds to watch here.
+    ReplayReader r( &m_data[0] + m_ticks[m_tick], &m_data[0] + m_data.size() );
+    for(;;) {
+        int tag = (int)r.Get(1);
+        switch( tag ) {
+        case REPLAY_TAG_UPDATE:
+            m_tick++;
+            return m_dt;
+        case REPLAY_TAG_ADD_GROUP:
+            sim->AddGroup( (int)r.Get(2) );
+            break;
+        case REPLAY_TAG_REMOVE_GROUP:
+            sim->RemoveGroup( (int)r.Get(2) );
+            break;
+        case REPLAY_TAG_FORCE: {
+            int groupId = (int)r.Get(2);
+            float lx = r.GetF32(), ly = r.GetF32(), rx = r.GetF32(), ry = r.GetF32();
+            sim->SetForce( groupId, cpv( lx, ly ), cpv( rx, ry ) );
+            break;
+        }
+        case REPLAY_TAG_DT:
+            m_dt = r.GetF64();
+            break;
+        case REPLAY_TAG_KEYFRAME: {
+            r.Get(4);
+            uint64_t hash = r.Get(8);
+            r.p += r.Get(4);
+            if( m_exact && sim->GetStateHash() != hash ) {
+                if( m_mismatchNum++ == 0 ) m_firstMismatch = m_tick;
+            }
+            break;
+        }
+        }
+    }
+}
+
+bool ReplayPlayer::Seek( Sim *sim, int tick ) {
+    if( m_keyframes.empty() || tick < 0 || tick > GetTickNum() ) return false;
+    int k = (int)m_keyframes.size() - 1;
+    while( k > 0 && m_keyframes[k].tick > tick ) k--;
+
+    // Only load when it skips ahead or goes back, running on from here is exact.
+    const Keyframe &kf = m_keyframes[k];
+    if( tick < m_tick || kf.tick > m_tick ) {
+        SimSnapshot s;
+        if( !ReadSnapshot( kf, &s ) ) return false;
+        sim->Load( s );
+        m_exact = false;
+        m_tick = kf.tick;
+        m_dt = kf.dt;
+    }
+    while( m_tick < tick ) sim->Update( Next( sim ) );
+    return true;
+}
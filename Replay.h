@@ -0,0 +1,106 @@
+//
+// Replay.h - Recording the inputs of a Sim and playing them back headless
+//
+
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+#include <vector>
+
+#include "Sim.h"
+
+// 10 seconds at 60 updates per second.
+#define REPLAY_KEYFRAME_TICKS 600
+
+// What the Sim was made with, from the start of the file.
+struct ReplayHeader
+{
+    uint32_t seed;
+    int groupNum, bodyCellNum;
+    float width, height;
+    bool useGrid;
+    double dt; // of the first update, the file has a record where it changes
+    int keyframeTicks;
+};
+
+// Writes every input of a sim as it is applied: groups joining and leaving, the sticks when
+// they change and the end of each Update, with a snapshot and state hash every keyframeTicks.
+// A tick with no new input takes a byte.
+class ReplayRecorder : public SimInputListener
+{
+public:
+    ReplayRecorder();
+    ~ReplayRecorder();
+
+    // Hooks into the sim until Close(), which must come before the sim is deleted. Opened on a
+    // sim that never had cells the replay is exact, otherwise it starts from the tick 0 keyframe.
+    bool Open( const char *path, Sim *sim, double dt, int keyframeTicks = REPLAY_KEYFRAME_TICKS );
+    void Close();
+    bool IsOpen() { return m_fp != nullptr; }
+    int GetTick() { return m_tick; }
+
+    virtual void onSimAddGroup( Sim *sim, int groupId );
+    virtual void onSimRemoveGroup( Sim *sim, int groupId );
+    virtual void onSimSetForce( Sim *sim, int groupId, cpVect lf, cpVect rf );
+    virtual void onSimUpdate( Sim *sim, double dt );
+
+private:
+    void BeginTick( Sim *sim );
+    void WriteKeyframe( Sim *sim );
+
+    FILE *m_fp;
+    Sim *m_sim;
+    int m_keyframeTicks;
+    int m_tick;
+    bool m_tickStarted; // the tick's keyframe is written
+    double m_dt;
+    std::vector<cpVect> m_forces; // as last written, 2 per group
+    std::vector<uint8_t> m_buf;
+    SimSnapshot m_snapshot;
+};
+
+// Runs a recording on a sim of its own, as fast as the caller updates it.
+class ReplayPlayer
+{
+public:
+    ReplayPlayer();
+
+    // Reads the whole file. One cut short by a crash plays up to its last complete tick.
+    bool Open( const char *path );
+    const ReplayHeader &GetHeader() { return m_header; }
+    int GetTickNum() { return (int)m_ticks.size(); }
+    int GetTick() { return m_tick; }
+
+    // A sim as it was when the recording started at tick 0, the caller deletes it.
+    Sim *NewSim();
+    // Applies the inputs of the next tick, returns the time step to Update the sim with or 0 at the end.
+    double Next( Sim *sim );
+    // Loads the last keyframe at or before tick and runs the rest. Not exact: snapshots leave out
+    // the links, sticky joints and contact caches, so the joints form again from the touching cells
+    // and from there on the run only stays close to the recording. IsExact() turns false.
+    bool Seek( Sim *sim, int tick );
+
+    // While the run is exact, keyframes Next() passed with a different state than recorded.
+    bool IsExact() { return m_exact; }
+    int GetMismatchNum() { return m_mismatchNum; }
+    int GetFirstMismatch() { return m_firstMismatch; }
+
+private:
+    struct Keyframe
+    {
+        int tick;
+        double dt;
+        size_t offset, size; // of the snapshot
+    };
+    bool ReadSnapshot( const Keyframe &kf, SimSnapshot *snapshot );
+
+    std::vector<uint8_t> m_data;
+    ReplayHeader m_header;
+    std::vector<size_t> m_ticks; // where the records of each tick start
+    std::vector<Keyframe> m_keyframes;
+    int m_tick;
+    double m_dt;
+    bool m_exact;
+    int m_mismatchNum, m_firstMismatch;
+};
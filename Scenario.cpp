@@ -0,0 +1,116 @@
+//
+// Scenario.cpp - Stress scenarios for the simulation
+//
+#include <math.h>
+#include <string.h>
+
+#include "Scenario.h"
+
+// Ticks of each half of a SCENARIO_CHARGE round.
+#define CHARGE_TICKS 180
+// A random stick holds its target for this many ticks at least, and up to twice as long.
+#define RANDOM_HOLD_TICKS 45
+// How fast a random stick turns to its target, per tick.
+#define RANDOM_STEER 0.05
+
+
+Scenario::Scenario( const ScenarioConfig &config ) :
+    m_config(config),
+    m_rng(config.seed)
+{
+    int cols = (int)ceil( sqrt( (double)config.players ) );
+    int rows = (config.players + cols - 1) / cols;
+    if( m_config.width <= 0 || m_config.height <= 0 ) {
+        // Each group gets a 400x300 block, grown with its cells so they spawn as packed as in the game.
+        float scale = (float)sqrt( (double)(2 + config.cells) / CELL_NUM_PER_PLAYER );
+        if( scale < 1 ) scale = 1;
+        m_config.width = 400.0f * cols * scale;
+        m_config.height = 300.0f * rows * scale;
+    }
+
+    m_sim = new Sim( m_config.width, m_config.height, config.players, config.useGrid, config.cells );
+    m_sim->SetSeed( config.seed );
+
+    m_sticks.resize( 2 * config.players, cpvzero );
+    m_targets.resize( 2 * config.players, cpvzero );
+    m_retarget.resize( 2 * config.players, 0 );
+}
+
+Scenario::~Scenario() {
+    delete m_sim;
+}
+
+bool Scenario::ParseForces( const char *name, ScenarioForces *forces ) {
+    for(int i=SCENARIO_SWEEP;i<=SCENARIO_RANDOM;i++) {
+        if( strcmp( name, GetForcesName( (ScenarioForces)i ) ) == 0 ) {
+            *forces = (ScenarioForces)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+const char *Scenario::GetForcesName( ScenarioForces forces ) {
+    switch( forces ) {
+    case SCENARIO_SWEEP: return "sweep";
+    case SCENARIO_CHARGE: return "charge";
+    case SCENARIO_RANDOM: return "random";
+    default: return "?";
+    }
+}
+
+void Scenario::Drive( int tick ) {
+    // Everyone joins on the first tick, after a recorder had the chance to hook in.
+    if( tick == 0 ) {
+        for(int i=0;i<m_sim->GetGroupNum();i++) m_sim->AddGroup(i);
+    }
+    switch( m_config.forces ) {
+    case SCENARIO_SWEEP:
+        for(int i=0;i<m_sim->GetGroupNum();i++) {
+            double t = tick / 60.0 + i;
+            cpVect lf = cpv( cos(t), sin(t*0.7) );
+            cpVect rf = cpv( cos(t*1.3), sin(t) );
+            m_sim->SetForce( i, lf, rf );
+        }
+        break;
+    case SCENARIO_CHARGE: DriveCharge( tick ); break;
+    case SCENARIO_RANDOM: DriveRandom( tick ); break;
+    }
+}
+
+// Charging packs every blob into the middle where they merge, tearing stretches each
+// blob along its eye spring until it breaks up.
+void Scenario::DriveCharge( int tick ) {
+    bool charge = (tick / CHARGE_TICKS) % 2 == 0;
+    for(int i=0;i<m_sim->GetGroupNum();i++) {
+        if( !m_sim->IsGroupActive(i) ) continue;
+        cpVect l = cpBodyGetPosition( m_sim->GetEye(i, 0) );
+        cpVect r = cpBodyGetPosition( m_sim->GetEye(i, 1) );
+        if( charge ) {
+            cpVect f = cpvnormalize( cpvneg( cpvlerp( l, r, 0.5 ) ) );
+            m_sim->SetForce( i, f, f );
+        } else {
+            cpVect apart = cpvnormalize( cpvsub( l, r ) );
+            if( cpveql( apart, cpvzero ) ) apart = cpv( 1, 0 );
+            m_sim->SetForce( i, apart, cpvneg( apart ) );
+        }
+    }
+}
+
+void Scenario::DriveRandom( int tick ) {
+    for(int i=0;i<(int)m_sticks.size();i++) {
+        if( tick >= m_retarget[i] ) {
+            // Straight from the engine, the std distributions differ between standard libraries.
+            cpVect v;
+            do {
+                double x = m_rng() / 2147483647.5 - 1.0;
+                double y = m_rng() / 2147483647.5 - 1.0;
+                v = cpv( x, y );
+            } while( cpvlengthsq(v) > 1.0 );
+            m_targets[i] = v;
+            m_retarget[i] = tick + RANDOM_HOLD_TICKS + (int)( m_rng() % (RANDOM_HOLD_TICKS + 1) );
+        }
+        m_sticks[i] = cpvlerp( m_sticks[i], m_targets[i], RANDOM_STEER );
+    }
+    for(int i=0;i<m_sim->GetGroupNum();i++) m_sim->SetForce( i, m_sticks[2*i], m_sticks[2*i+1] );
+}
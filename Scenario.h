@@ -0,0 +1,59 @@
+//
+// Scenario.h - Stress scenarios: P players with C cells each in a W x H arena, sticks driven by a script or at random
+//
+
+#pragma once
+
+#include <random>
+#include <vector>
+
+#include "Sim.h"
+
+
+enum ScenarioForces
+{
+    SCENARIO_SWEEP, // both sticks sweep around at different rates, the blobs drift into each other
+    SCENARIO_CHARGE, // all blobs charge the arena center, then their eyes pull apart to tear them, over and over
+    SCENARIO_RANDOM, // every stick wanders to a new random target now and then
+};
+
+struct ScenarioConfig
+{
+    int players;
+    int cells; // body cells per player
+    float width, height; // 0 keeps the cell density of the 800x600 4 player arena
+    bool useGrid;
+    ScenarioForces forces;
+    unsigned int seed;
+    ScenarioConfig() : players(MAX_PLAYER_NUM), cells(BODY_CELL_NUM_PER_PLAYER), width(0), height(0),
+                       useGrid(true), forces(SCENARIO_SWEEP), seed(1) {}
+};
+
+// Builds the Sim, adds every group on tick 0 and sets the sticks of each tick. The same config
+// and seed always give the same run.
+class Scenario
+{
+public:
+    Scenario( const ScenarioConfig &config );
+    ~Scenario();
+
+    Sim *GetSim() { return m_sim; }
+    const ScenarioConfig &GetConfig() { return m_config; }
+
+    // Sets every group's sticks for the tick, call it once per tick in order from 0 before Sim::Update.
+    void Drive( int tick );
+
+    static bool ParseForces( const char *name, ScenarioForces *forces );
+    static const char *GetForcesName( ScenarioForces forces );
+
+private:
+    void DriveCharge( int tick );
+    void DriveRandom( int tick );
+
+    ScenarioConfig m_config;
+    Sim *m_sim;
+    std::mt19937 m_rng; // the random sticks, the Sim has its own for the cells
+    std::vector<cpVect> m_sticks; // 2 per group, SCENARIO_RANDOM
+    std::vector<cpVect> m_targets;
+    std::vector<int> m_retarget; // tick the stick picks its next target
+};
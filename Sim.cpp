@@ -0,0 +1,548 @@
+//
+// Sim.cpp - Platform independent amoeba simulation
+//
+#include <assert.h>
+#include <math.h>
+
+#include "Sim.h"
+#include "Phys.h"
+#include "Trace.h"
+
+// Bodies, shapes and joints come from the sim's arena while this is alive.
+struct ArenaScope
+{
+    cpAllocator *prev;
+    ArenaScope( cpArena *arena ) { prev = cpSetAllocator( cpArenaGetAllocator(arena) ); }
+    ~ArenaScope() { cpSetAllocator( prev ); }
+};
+
+
+Sim::Sim( float width, float height, int groupNum, bool useGrid, int bodyCellNum ) :
+    m_width(width),
+    m_height(height),
+    m_bodyCellNum(bodyCellNum),
+    m_useGrid(useGrid),
+    m_groups(groupNum),
+    m_listener(nullptr),
+    m_inputListener(nullptr),
+    m_seed(1),
+    m_rng(1),
+    m_clustersDirty(false)
+{
+    int cellNum = groupNum * (2 + bodyCellNum);
+    m_cells.Reserve( cellNum );
+    m_groupSlot.reserve( cellNum + 1 );
+    m_clusterParent.reserve( cellNum + 1 );
+    m_clusterHP.reserve( cellNum + 1 );
+    m_clusterSize.reserve( cellNum + 1 );
+    m_events.reserve( SIM_MAX_EVENTS );
+    m_groupEvents.resize( groupNum );
+
+    m_arena = cpArenaNew( 1 << 20 );
+    ArenaScope scope( m_arena );
+    m_space = PhysNewSpace();
+    PhysTraceSpace(m_space);
+    cpSpaceSetUserData(m_space, this);
+
+	cpSpaceSetIterations(m_space, 10);
+	cpSpaceSetGravity(m_space, cpv(0, -10));
+	cpSpaceSetCollisionSlop(m_space, 2.0);
+
+    // Every cell shape has the same radius, a uniform grid beats the default tree for that.
+    if(useGrid) cpSpaceUseSpatialGrid(m_space, 2.0f*(CELL_RADIUS + STICK_SENSOR_THICKNESS));
+    InitWalls();
+
+	cpCollisionHandler *handler = cpSpaceAddWildcardHandler(m_space, COLLISION_TYPE_STICKY);
+	handler->beginFunc = StickyBegin;
+	cpSpaceSetAdhesionFuncs(m_space, StickyJoin, StickySeparate, this);
+
+    // Packed circles touch 6 others, 3 pairs per cell, and one more for squeezed blobs and the walls.
+    // With the pools this large the space doesn't allocate while stepping.
+    int pairs = 4 * cellNum;
+    PhysReserveSpace(m_space, pairs, pairs, pairs);
+}
+
+void Sim::InitWalls() {
+	cpBody *staticBody = cpSpaceGetStaticBody( m_space);
+	cpShape *shape;
+
+	// Create segments around the edge of the arena.
+    float mgn=10;
+    float minx = -m_width/2+mgn, maxx = m_width/2-mgn, miny = -m_height/2+mgn, maxy = m_height/2-mgn;
+	shape = cpSpaceAddShape(m_space, cpSegmentShapeNew(staticBody, cpv(minx,miny), cpv(minx, maxy), 20.0f)); // left
+	cpShapeSetElasticity(shape, 1.0f);
+	cpShapeSetFriction(shape, 1.0f);
+	cpShapeSetFilter(shape, NOT_GRABBABLE_FILTER);
+
+	shape = cpSpaceAddShape(m_space, cpSegmentShapeNew(staticBody, cpv( maxx,miny), cpv( maxx, maxy), 20.0f)); // right
+	cpShapeSetElasticity(shape, 1.0f);
+	cpShapeSetFriction(shape, 1.0f);
+	cpShapeSetFilter(shape, NOT_GRABBABLE_FILTER);
+
+	shape = cpSpaceAddShape(m_space, cpSegmentShapeNew(staticBody, cpv(minx,miny), cpv( maxx,miny), 20.0f)); // bottom
+	cpShapeSetElasticity(shape, 1.0f);
+	cpShapeSetFriction(shape, 1.0f);
+	cpShapeSetFilter(shape, NOT_GRABBABLE_FILTER);
+
+	shape = cpSpaceAddShape(m_space, cpSegmentShapeNew(staticBody, cpv(minx, maxy), cpv( maxx, maxy), 20.0f)); // top
+	cpShapeSetElasticity(shape, 1.0f);
+	cpShapeSetFriction(shape, 1.0f);
+	cpShapeSetFilter(shape, NOT_GRABBABLE_FILTER);
+}
+
+//////////////////////
+
+static void ConstraintFreeWrap(cpSpace *space, cpConstraint *constraint, void *unused){
+	cpSpaceRemoveConstraint(space, constraint);
+	cpConstraintFree(constraint);
+}
+
+static void eachShapePushCallback( cpBody *body, cpShape *shape, void *data ) {
+    std::vector<cpShape*> *v = (std::vector<cpShape*>*) data;
+    v->push_back(shape);
+}
+
+Sim::~Sim() {
+    // Freeing the space joins the solver threads, the bodies, shapes and joints still in it go with the arena.
+    PhysFreeSpace(m_space);
+    cpArenaFree(m_arena);
+}
+
+// splitmix64, in [0,1). Unlike rand() it's the same everywhere and nothing else draws from it.
+double Sim::Random() {
+    uint64_t z = (m_rng += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    z ^= z >> 31;
+    return (z >> 11) * (1.0 / 9007199254740992.0);
+}
+
+cpBody *Sim::CreateCellBody( cpVect pos, int prio, int groupId, int eyeId ) {
+    cpFloat mass = 0.1f, eye_mass = 10.0f;
+    cpFloat radius = CELL_RADIUS;
+
+    if( eyeId >= 0 ) mass = eye_mass;
+
+    ArenaScope scope( m_arena );
+
+    cpBody *body = cpSpaceAddBody(m_space, cpBodyNew( mass, cpMomentForCircle(mass, 0.0f, radius, cpvzero)));
+
+    cpBodySetPosition(body, pos);
+    BodyHandle h = m_cells.Alloc( body, prio, groupId, eyeId );
+    cpBodySetUserData(body, (cpDataPointer)(intptr_t) h);
+
+    std::vector<BodyHandle> &members = m_groups[groupId].cells;
+    if( h >= (int)m_groupSlot.size() ) {
+        m_groupSlot.resize( h+1, -1 );
+        m_clusterParent.resize( h+1 );
+        m_clusterHP.resize( h+1 );
+        m_clusterSize.resize( h+1 );
+    }
+    m_groupSlot[h] = (int)members.size();
+    members.push_back(h);
+    m_clusterParent[h] = h;
+
+    cpShape *shape = cpSpaceAddShape(m_space, cpCircleShapeNew(body, radius + STICK_SENSOR_THICKNESS, cpvzero));
+    cpShapeSetFriction(shape, 0.95f);
+    cpShapeSetCollisionType(shape, COLLISION_TYPE_STICKY);
+    cpShapeSetSkin(shape, STICK_SENSOR_THICKNESS);
+    cpShapeSetAdhesion(shape, STICK_MAX_FORCE);
+    cpShapeSetAdhesionGroup(shape, (cpGroup)(groupId + 1));
+
+    int i = m_cells.IndexOf(h);
+    m_cells.radius[i] = radius;
+    m_cells.hp[i] = BODY_MAXHP * cpflerp( 0.6, 1.0, Random() );
+
+    return body;
+}
+
+void Sim::eachConstraintFreeCallback( cpBody *body, cpConstraint *ct, void *data ) {
+    Sim *sim = (Sim*) data;
+    sim->RemoveLink( ct );
+    ConstraintFreeWrap( sim->m_space, ct, NULL );
+}
+
+// Must be called while the space is unlocked.
+void Sim::FreeCell( BodyHandle h ) {
+    FreeCells( &h, 1 );
+}
+
+void Sim::FreeCells( const BodyHandle *handles, int n ) {
+    TRACE_ZONE( "Sim::FreeCells" );
+    ArenaScope scope( m_arena );
+
+    // Removing the shapes separates their arbiters, the space removes the sticky joints then.
+    m_freeShapes.clear();
+    for(int k=0;k<n;k++) cpBodyEachShape( m_cells.body[m_cells.IndexOf(handles[k])], eachShapePushCallback, &m_freeShapes );
+    if( !m_freeShapes.empty() ) cpSpaceRemoveShapes( m_space, &m_freeShapes[0], (int)m_freeShapes.size() );
+    for(unsigned int k=0;k<m_freeShapes.size();k++) cpShapeFree( m_freeShapes[k] );
+
+    for(int k=0;k<n;k++) {
+        BodyHandle h = handles[k];
+        int i = m_cells.IndexOf(h);
+        cpBody *body = m_cells.body[i];
+
+        // Unregister from the group, the last member takes the slot.
+        std::vector<BodyHandle> &members = m_groups[m_cells.group_id[i]].cells;
+        int slot = m_groupSlot[h];
+        members[slot] = members.back();
+        m_groupSlot[members[slot]] = slot;
+        members.pop_back();
+        m_groupSlot[h] = -1;
+
+        cpBodyEachConstraint(body, eachConstraintFreeCallback, this );
+        cpSpaceRemoveBody(m_space, body);
+        cpBodyFree(body);
+        m_cells.Free(h);
+    }
+
+    // Other cells may have these as their root.
+    m_clustersDirty = true;
+    m_counters.freedCells += n;
+}
+
+//////////////////////
+
+void Sim::AddLink( cpConstraint *joint ) {
+    SimLink l;
+    l.a = GetBodyHandle( cpConstraintGetBodyA(joint) );
+    l.b = GetBodyHandle( cpConstraintGetBodyB(joint) );
+    l.joint = joint;
+    m_links.push_back(l);
+    cpConstraintSetUserData( joint, (cpDataPointer)(intptr_t) m_links.size() );
+
+    BodyHandle ra = FindCluster(l.a), rb = FindCluster(l.b);
+    if( ra != rb ) m_clusterParent[ra] = rb;
+}
+
+void Sim::RemoveLink( cpConstraint *joint ) {
+    int i = (int)(intptr_t) cpConstraintGetUserData(joint) - 1;
+    if( i < 0 ) return;
+    m_links[i] = m_links.back();
+    cpConstraintSetUserData( m_links[i].joint, (cpDataPointer)(intptr_t)(i+1) );
+    m_links.pop_back();
+    cpConstraintSetUserData( joint, NULL );
+    m_clustersDirty = true;
+}
+
+BodyHandle Sim::FindCluster( BodyHandle h ) {
+    while( m_clusterParent[h] != h ) {
+        m_clusterParent[h] = m_clusterParent[m_clusterParent[h]];
+        h = m_clusterParent[h];
+    }
+    return h;
+}
+
+void Sim::RebuildClusters() {
+    for(int i=0;i<m_cells.Count();i++) m_clusterParent[m_cells.handle[i]] = m_cells.handle[i];
+    for(unsigned int i=0;i<m_links.size();i++) {
+        BodyHandle ra = FindCluster(m_links[i].a), rb = FindCluster(m_links[i].b);
+        if( ra != rb ) m_clusterParent[ra] = rb;
+    }
+    m_clustersDirty = false;
+}
+
+// Every cell gets the average HP of the cluster it is jointed into.
+void Sim::PoolClusterHP() {
+    TRACE_ZONE( "Sim::PoolClusterHP" );
+    if( m_clustersDirty ) RebuildClusters();
+
+    int n = m_cells.Count();
+    for(int i=0;i<n;i++) {
+        BodyHandle h = m_cells.handle[i];
+        m_clusterHP[h] = 0;
+        m_clusterSize[h] = 0;
+    }
+    for(int i=0;i<n;i++) {
+        BodyHandle r = FindCluster( m_cells.handle[i] );
+        m_clusterHP[r] += m_cells.hp[i];
+        m_clusterSize[r]++;
+    }
+    for(int i=0;i<n;i++) {
+        BodyHandle r = FindCluster( m_cells.handle[i] );
+        m_cells.hp[i] = m_clusterHP[r] / m_clusterSize[r];
+    }
+}
+
+void Sim::Update( double dt ) {
+    TRACE_ZONE( "Sim::Update" );
+    if( m_inputListener ) m_inputListener->onSimUpdate( this, dt );
+    PhysUpdateSpace( m_space, dt );
+    cpSpaceStepStats stats = cpSpaceGetStepStats( m_space );
+    m_counters.steps++;
+    m_counters.newArbiters += stats.newArbiters;
+    m_counters.removedArbiters += stats.removedArbiters;
+
+    PoolClusterHP();
+
+    // HP decay and eye forces
+    m_deadCells.clear();
+    int n = m_cells.Count();
+    {
+        TRACE_ZONE( "Sim::Update cells" );
+        for(int i=0;i<n;i++) {
+            int gid = m_cells.group_id[i];
+            if( !IsGroupActive(gid) ) continue;
+
+            int eye_id = m_cells.eye_id[i];
+            if( eye_id < 0 ) {
+                m_cells.hp[i] -= HP_CONSUME_SPEED;
+                if( m_cells.hp[i] < 0 ) m_deadCells.push_back( m_cells.handle[i] );
+            } else {
+                float scl = 10000;
+                cpVect f = m_groups[gid].forces[eye_id];
+                m_cells.force[i] = (float)cpvlength(f);
+                cpBodySetForce( m_cells.body[i], cpvmult( f, scl ) );
+
+                // Eyes keep max HP
+                m_cells.hp[i] = BODY_MAXHP;
+            }
+        }
+    }
+    if( !m_deadCells.empty() ) FreeCells( &m_deadCells[0], (int)m_deadCells.size() );
+
+    for(unsigned int i=0;i<m_groups.size();i++) {
+        if( m_groups[i].active && m_groups[i].cells.size() == 2 ) {
+            ResetCells(i);
+        }
+    }
+
+    DispatchEvents();
+}
+
+//////////////////////
+
+bool Sim::AddGroup( int groupId ) {
+    assert( groupId >= 0 && groupId < GetGroupNum() );
+    SimGroup *g = &m_groups[groupId];
+    if( g->active ) return false;
+    if( m_inputListener ) m_inputListener->onSimAddGroup( this, groupId );
+    g->active = true;
+    g->cells.reserve( 2 + m_bodyCellNum );
+
+    float dia;
+    cpVect center = GetGroupDefaultPosition( groupId, &dia );
+
+    int n = 2 + m_bodyCellNum;
+	for(int i=0; i<n; i++){
+        int prio, eye_id=-1;
+        if(i==0 ||i==1) {
+            eye_id = i;
+            prio = CELL_PRIO_HIGH;
+        } else {
+            prio = CELL_PRIO_LOW; // draw eyes always on other cells
+        }
+
+        cpVect p = cpv( cpflerp(center.x-dia, center.x+dia, Random()), cpflerp(center.y-dia, center.y+dia, Random() ) );
+        cpBody *body = CreateCellBody( p, prio, groupId, eye_id );
+
+        if( eye_id >= 0 ) g->eyes[eye_id] = body;
+	}
+    AddEyeSpring( groupId );
+    return true;
+}
+
+void Sim::AddEyeSpring( int groupId ) {
+    SimGroup *g = &m_groups[groupId];
+    ArenaScope scope( m_arena );
+    AddLink( cpSpaceAddConstraint( m_space, new_spring( g->eyes[0], g->eyes[1], cpv(0,0),cpv(0,0), 70, 110, 0.1 ) ) );
+}
+
+void Sim::RemoveGroup( int groupId ) {
+    if( !IsGroupActive(groupId) ) return;
+    if( m_inputListener ) m_inputListener->onSimRemoveGroup( this, groupId );
+    CleanGroup( groupId );
+    m_groups[groupId] = SimGroup();
+}
+
+bool Sim::IsGroupActive( int groupId ) {
+    return groupId >= 0 && groupId < GetGroupNum() && m_groups[groupId].active;
+}
+
+void Sim::SetForce( int groupId, cpVect lf, cpVect rf ) {
+    if( !IsGroupActive(groupId) ) return;
+    lf = cpv( (float)lf.x, (float)lf.y );
+    rf = cpv( (float)rf.x, (float)rf.y );
+    if( m_inputListener ) m_inputListener->onSimSetForce( this, groupId, lf, rf );
+    m_groups[groupId].forces[0] = lf;
+    m_groups[groupId].forces[1] = rf;
+}
+
+void Sim::ResetCells( int groupId ) {
+    TRACE_ZONE( "Sim::ResetCells" );
+    m_counters.respawns++;
+    float dia;
+    cpVect center = GetGroupDefaultPosition( groupId, &dia );
+    for(int i=0;i<m_bodyCellNum;i++) {
+        cpVect p = cpv( cpflerp( center.x-dia, center.x+dia, Random() ), cpflerp( center.y-dia, center.y+dia, Random() ) );
+        CreateCellBody( p, CELL_PRIO_LOW, groupId, -1 );
+    }
+}
+
+// Groups are laid out on a grid over the arena, row by row from the top left.
+// With 4 groups this is the original layout:
+/*
+            |
+         0  |  1
+            |
+       -----O----
+            |
+         2  |  3
+            |
+
+       O: (0,0) in ChipMunk
+ */
+cpVect Sim::GetGroupDefaultPosition( int index, float *dia ) {
+    int n = GetGroupNum();
+    int cols = (int)ceil( sqrt( (double)n ) );
+    int rows = (n + cols - 1) / cols;
+    float cw = m_width / cols, ch = m_height / rows;
+
+    *dia = cw/3.0f;
+
+    index = index % n;
+    int c = index % cols, r = index / cols;
+    return cpv( -m_width/2 + cw * (c + 0.5f), m_height/2 - ch * (r + 0.5f) );
+}
+
+void Sim::CleanGroup( int groupid ) {
+    m_deadCells = m_groups[groupid].cells;
+    if( !m_deadCells.empty() ) FreeCells( &m_deadCells[0], (int)m_deadCells.size() );
+}
+
+//////////////////////
+
+void Sim::Save( SimSnapshot *snapshot ) {
+    snapshot->rng = m_rng;
+    snapshot->active.resize( m_groups.size() );
+    snapshot->forces.resize( 2 * m_groups.size() );
+    for(unsigned int i=0;i<m_groups.size();i++) {
+        snapshot->active[i] = m_groups[i].active;
+        snapshot->forces[2*i] = m_groups[i].forces[0];
+        snapshot->forces[2*i+1] = m_groups[i].forces[1];
+    }
+    int n = m_cells.Count();
+    snapshot->cells.resize( n );
+    for(int i=0;i<n;i++) {
+        SimCellState &c = snapshot->cells[i];
+        cpBody *body = m_cells.body[i];
+        c.groupId = m_cells.group_id[i];
+        c.eyeId = m_cells.eye_id[i];
+        c.prio = m_cells.draw_priority[i];
+        c.hp = m_cells.hp[i];
+        c.pos = cpBodyGetPosition( body );
+        c.vel = cpBodyGetVelocity( body );
+        c.angle = cpBodyGetAngle( body );
+        c.angVel = cpBodyGetAngularVelocity( body );
+    }
+}
+
+void Sim::Load( const SimSnapshot &snapshot ) {
+    assert( snapshot.active.size() == m_groups.size() );
+    for(unsigned int i=0;i<m_groups.size();i++) {
+        CleanGroup( i );
+        m_groups[i] = SimGroup();
+        m_groups[i].active = snapshot.active[i];
+        m_groups[i].forces[0] = snapshot.forces[2*i];
+        m_groups[i].forces[1] = snapshot.forces[2*i+1];
+    }
+
+    // Same order as saved, so the pool is packed the same way.
+    for(unsigned int k=0;k<snapshot.cells.size();k++) {
+        const SimCellState &c = snapshot.cells[k];
+        cpBody *body = CreateCellBody( c.pos, c.prio, c.groupId, c.eyeId );
+        cpBodySetVelocity( body, c.vel );
+        cpBodySetAngle( body, c.angle );
+        cpBodySetAngularVelocity( body, c.angVel );
+        m_cells.hp[m_cells.IndexOf(body)] = c.hp;
+        if( c.eyeId >= 0 ) m_groups[c.groupId].eyes[c.eyeId] = body;
+    }
+    for(unsigned int i=0;i<m_groups.size();i++) {
+        if( m_groups[i].active && m_groups[i].eyes[0] && m_groups[i].eyes[1] ) AddEyeSpring( i );
+    }
+
+    // CreateCellBody drew HPs, and the cells freed above left separations behind.
+    m_rng = snapshot.rng;
+    m_events.clear();
+    for(unsigned int i=0;i<m_groupEvents.size();i++) m_groupEvents[i] = SimGroupEvents();
+}
+
+// FNV-1a over the bytes of each cell's state.
+static void HashBytes( uint64_t *h, const void *p, size_t n ) {
+    const unsigned char *b = (const unsigned char*) p;
+    for(size_t i=0;i<n;i++) *h = (*h ^ b[i]) * 0x100000001B3ull;
+}
+
+uint64_t Sim::GetStateHash() {
+    uint64_t h = 0xCBF29CE484222325ull;
+    for(int i=0;i<m_cells.Count();i++) {
+        cpVect p = cpBodyGetPosition( m_cells.body[i] ), v = cpBodyGetVelocity( m_cells.body[i] );
+        HashBytes( &h, &m_cells.group_id[i], sizeof(int) );
+        HashBytes( &h, &m_cells.hp[i], sizeof(float) );
+        HashBytes( &h, &p, sizeof(p) );
+        HashBytes( &h, &v, sizeof(v) );
+    }
+    return h;
+}
+
+//////////////////////
+
+void Sim::onBodySeparated( cpBody *bodyA, cpBody *bodyB, cpConstraint *joint ) {
+    RemoveLink( joint );
+    PushEvent( SIM_EVENT_SEPARATED, bodyA, bodyB );
+}
+void Sim::onBodyJointed( cpBody *bodyA, cpBody *bodyB, cpConstraint *joint ) {
+    AddLink( joint );
+    PushEvent( SIM_EVENT_JOINED, bodyA, bodyB );
+}
+void Sim::onBodyCollide( cpBody *bodyA, cpBody *bodyB ) {
+    PushEvent( SIM_EVENT_COLLIDE, bodyA, bodyB );
+}
+
+void Sim::PushEvent( SimEventType type, cpBody *bodyA, cpBody *bodyB ) {
+    SimEvent ev;
+    ev.type = type;
+    ev.a = GetBodyHandle( bodyA );
+    ev.b = GetBodyHandle( bodyB );
+    ev.groupA = ev.a ? m_cells.group_id[m_cells.IndexOf(ev.a)] : -1;
+    ev.groupB = ev.b ? m_cells.group_id[m_cells.IndexOf(ev.b)] : -1;
+    ev.speed = (float)cpvdist( cpBodyGetVelocity(bodyA), cpBodyGetVelocity(bodyB) );
+    switch( type ) {
+    case SIM_EVENT_COLLIDE: m_counters.collisions++; break;
+    case SIM_EVENT_JOINED: m_counters.joins++; break;
+    case SIM_EVENT_SEPARATED: m_counters.separations++; break;
+    }
+
+    // Past the reserved size only the totals are kept, so this never allocates.
+    if( (int)m_events.size() < SIM_MAX_EVENTS ) {
+        m_events.push_back(ev);
+    } else {
+        AccumulateEvent(ev);
+    }
+}
+
+void Sim::AccumulateEvent( const SimEvent &ev ) {
+    int groups[2] = { ev.groupA, ev.groupB };
+    for(int k=0;k<2;k++) {
+        if( groups[k] < 0 || (k == 1 && groups[1] == groups[0]) ) continue;
+        SimGroupEvents &g = m_groupEvents[groups[k]];
+        switch( ev.type ) {
+        case SIM_EVENT_COLLIDE:
+            g.collisions++;
+            if( ev.speed > g.maxCollideSpeed ) g.maxCollideSpeed = ev.speed;
+            break;
+        case SIM_EVENT_JOINED: g.joins++; break;
+        case SIM_EVENT_SEPARATED: g.separations++; break;
+        }
+    }
+}
+
+// Events raised outside of Update (FreeCells) wait for the next one.
+void Sim::DispatchEvents() {
+    TRACE_ZONE( "Sim::DispatchEvents" );
+    for(unsigned int i=0;i<m_events.size();i++) AccumulateEvent( m_events[i] );
+    if( m_listener ) m_listener->onSimEvents( m_events.empty() ? nullptr : &m_events[0], (int)m_events.size(), &m_groupEvents[0], GetGroupNum() );
+
+    m_events.clear();
+    for(unsigned int i=0;i<m_groupEvents.size();i++) m_groupEvents[i] = SimGroupEvents();
+}
@@ -0,0 +1,222 @@
+//
+// Sim.h - Platform independent amoeba simulation (no window, graphics or audio)
+//
+
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+#include "chipmunk/chipmunk.h"
+
+#include "Phys.h"
+
+
+#define MAX_PLAYER_NUM 4
+#define HP_CONSUME_SPEED 0.2
+#define CELL_RADIUS 10.0f
+#define BODY_CELL_NUM_PER_PLAYER 100 // the game's, a Sim can be made with more
+#define CELL_NUM_PER_PLAYER ( 2 + BODY_CELL_NUM_PER_PLAYER )
+#define TOTAL_CELL_NUM (CELL_NUM_PER_PLAYER * MAX_PLAYER_NUM )
+
+
+#define SIM_MAX_EVENTS 1024
+
+enum SimEventType
+{
+    SIM_EVENT_COLLIDE, // cells of different groups or a cell and a wall touched
+    SIM_EVENT_JOINED,
+    SIM_EVENT_SEPARATED,
+};
+
+// A sticky event raised while the space is stepping. The bodies may be gone by the time
+// it is dispatched, so it keeps their handles and groups.
+struct SimEvent
+{
+    SimEventType type;
+    BodyHandle a, b; // 0 for walls
+    int groupA, groupB; // -1 for walls
+    float speed; // relative speed of the bodies
+};
+
+// Totals of the events of one Update, per group.
+struct SimGroupEvents
+{
+    int collisions, joins, separations;
+    float maxCollideSpeed;
+};
+
+// Receives the sticky events once per Update, after the space is done stepping.
+class SimListener
+{
+public:
+    virtual ~SimListener() {}
+    // events holds at most SIM_MAX_EVENTS of them, the group totals count the rest too.
+    virtual void onSimEvents( const SimEvent *events, int count, const SimGroupEvents *groups, int groupNum ) {}
+};
+
+class Sim;
+
+// Sees every input of the sim before it is applied, to record them. Everything else the sim
+// does follows from these and the seed.
+class SimInputListener
+{
+public:
+    virtual ~SimInputListener() {}
+    virtual void onSimAddGroup( Sim *sim, int groupId ) {}
+    virtual void onSimRemoveGroup( Sim *sim, int groupId ) {}
+    virtual void onSimSetForce( Sim *sim, int groupId, cpVect lf, cpVect rf ) {}
+    virtual void onSimUpdate( Sim *sim, double dt ) {}
+};
+
+// Work done by the Updates since the last ResetCounters(), to tell what slow frames were busy with.
+struct SimCounters
+{
+    int steps;
+    unsigned long newArbiters, removedArbiters; // only counted when chipmunk is built with -DSTEP_STATS=ON
+    int collisions, joins, separations;
+    int freedCells, respawns;
+    SimCounters() : steps(0), newArbiters(0), removedArbiters(0), collisions(0), joins(0), separations(0), freedCells(0), respawns(0) {}
+    void Add( const SimCounters &o ) {
+        steps += o.steps; newArbiters += o.newArbiters; removedArbiters += o.removedArbiters;
+        collisions += o.collisions; joins += o.joins; separations += o.separations;
+        freedCells += o.freedCells; respawns += o.respawns;
+    }
+};
+
+// One blob: two eye cells driven by the thumbsticks and the body cells around them.
+class SimGroup
+{
+public:
+    bool active;
+    std::vector<BodyHandle> cells; // live cells of this group, in no particular order
+    cpBody *eyes[2]; // 0:Left 1:Right
+    cpVect forces[2]; // 0:Left 1:Right
+    SimGroup() : active(false) {
+        for(int i=0;i<2;i++) { eyes[i] = nullptr; forces[i] = cpvzero; }
+    }
+};
+
+// A cell as it is kept in a snapshot.
+struct SimCellState
+{
+    int groupId, eyeId, prio;
+    float hp;
+    cpVect pos, vel;
+    cpFloat angle, angVel;
+};
+
+// Enough of a sim to rebuild it: the groups, their cells and the random state. The sticky
+// joints and chipmunk's contact caches are left out, Load() lets touching cells stick again.
+struct SimSnapshot
+{
+    uint64_t rng;
+    std::vector<bool> active; // per group
+    std::vector<cpVect> forces; // 2 per group
+    std::vector<SimCellState> cells;
+};
+
+// A joint between two cells of the same group. HP is shared over the clusters these form.
+struct SimLink
+{
+    BodyHandle a, b;
+    cpConstraint *joint;
+};
+
+class Sim
+{
+public:
+    // width/height is the arena size in chipmunk units, centered on (0,0).
+    // useGrid=false keeps chipmunk's default bounding box tree as the broadphase.
+    // Every group spawns with its two eyes and bodyCellNum body cells.
+    Sim( float width, float height, int groupNum = MAX_PLAYER_NUM, bool useGrid = true, int bodyCellNum = BODY_CELL_NUM_PER_PLAYER );
+    ~Sim();
+
+    cpSpace *GetSpace() { return m_space; }
+    BodyStatePool *GetCells() { return &m_cells; }
+    void SetListener( SimListener *listener ) { m_listener = listener; }
+    void SetInputListener( SimInputListener *listener ) { m_inputListener = listener; }
+    // Cells are placed and given their HP from this seed. Set it before the first AddGroup.
+    void SetSeed( uint32_t seed ) { m_seed = seed; m_rng = seed; }
+    uint32_t GetSeed() { return m_seed; }
+    int GetGroupNum() { return (int)m_groups.size(); }
+    int GetBodyCellNum() { return m_bodyCellNum; }
+    float GetWidth() { return m_width; }
+    float GetHeight() { return m_height; }
+    bool UsesGrid() { return m_useGrid; }
+    // Solver threads, 0 picks the number of cores. Results don't depend on the count.
+    void SetThreads( int threads ) { PhysSetSpaceThreads( m_space, threads ); }
+    int GetThreads() { return PhysGetSpaceThreads( m_space ); }
+    // Bytes the space, bodies, shapes and joints took from the heap so far.
+    size_t GetArenaBytes() { return cpArenaGetBytes( m_arena ); }
+    const SimCounters &GetCounters() { return m_counters; }
+    void ResetCounters() { m_counters = SimCounters(); }
+
+    // Steps the space and applies the game rules (HP decay and exchange, respawn).
+    void Update( double dt );
+
+    bool AddGroup( int groupId );
+    void RemoveGroup( int groupId );
+    bool IsGroupActive( int groupId );
+    // The sticks are kept at float precision, as the pads give them, so a recording has them exactly.
+    void SetForce( int groupId, cpVect lf, cpVect rf );
+    cpVect GetForce( int groupId, int eyeId ) { return m_groups[groupId].forces[eyeId]; }
+    cpBody *GetEye( int groupId, int eyeId ) { return m_groups[groupId].eyes[eyeId]; }
+    int GetCellCount( int groupId ) { return (int)m_groups[groupId].cells.size(); }
+    const std::vector<BodyHandle> &GetGroupCells( int groupId ) { return m_groups[groupId].cells; }
+
+    cpVect GetGroupDefaultPosition( int index, float *dia );
+    cpBody *CreateCellBody( cpVect pos, int prio, int groupId, int eyeId );
+    void FreeCell( BodyHandle h );
+    void FreeCells( const BodyHandle *handles, int n );
+    void ResetCells( int groupId );
+    void CleanGroup( int groupId );
+
+    void Save( SimSnapshot *snapshot );
+    // Replaces every group and cell with those of the snapshot, of a sim with the same group count.
+    void Load( const SimSnapshot &snapshot );
+    // Of the cells' groups, HP, positions and velocities, equal for equal runs.
+    uint64_t GetStateHash();
+
+    // Called by the sticky collision handlers. Links are updated right away, the listener gets the events after the step.
+    void onBodySeparated( cpBody *bodyA, cpBody *bodyB, cpConstraint *joint );
+    void onBodyJointed( cpBody *bodyA, cpBody *bodyB, cpConstraint *joint );
+    void onBodyCollide( cpBody *bodyA, cpBody *bodyB );
+
+private:
+    void InitWalls();
+    double Random();
+    void AddEyeSpring( int groupId );
+    static void eachConstraintFreeCallback( cpBody *body, cpConstraint *ct, void *data );
+    void AddLink( cpConstraint *joint );
+    void RemoveLink( cpConstraint *joint );
+    BodyHandle FindCluster( BodyHandle h );
+    void RebuildClusters();
+    void PoolClusterHP();
+    void PushEvent( SimEventType type, cpBody *bodyA, cpBody *bodyB );
+    void AccumulateEvent( const SimEvent &ev );
+    void DispatchEvents();
+
+    float m_width, m_height;
+    int m_bodyCellNum;
+    bool m_useGrid;
+    std::vector<SimGroup> m_groups;
+    SimListener *m_listener;
+    SimInputListener *m_inputListener;
+    uint32_t m_seed;
+    uint64_t m_rng;
+    std::vector<SimEvent> m_events; // reserved to SIM_MAX_EVENTS, never grows
+    std::vector<SimGroupEvents> m_groupEvents;
+    BodyStatePool m_cells;
+    std::vector<int> m_groupSlot; // handle -> position in its group's cell list
+    std::vector<SimLink> m_links; // index+1 is kept in the joint's userData
+    std::vector<BodyHandle> m_clusterParent; // union-find over handles
+    std::vector<float> m_clusterHP; // per root handle, scratch for PoolClusterHP
+    std::vector<int> m_clusterSize;
+    bool m_clustersDirty; // links were removed, unions can't be undone so rebuild
+    std::vector<BodyHandle> m_deadCells;
+    std::vector<cpShape*> m_freeShapes;
+    SimCounters m_counters;
+    cpArena *m_arena; // everything chipmunk allocates for this sim, released at once
+    cpSpace *m_space;
+};
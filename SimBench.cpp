@@ -0,0 +1,356 @@
+//
+// SimBench.cpp - Headless benchmark of the amoeba simulation
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <chrono>
+#include <memory>
+
+#include "Sim.h"
+#include "Phys.h"
+#include "Trace.h"
+#include "FrameStats.h"
+#include "Scenario.h"
+#include "Replay.h"
+#ifdef PHYS_HASTY_SPACE
+extern "C" {
+#include "chipmunk/cpHastySpace.h"
+}
+#endif
+
+
+#define MAX_ALLOC_SITES 128
+
+static void usage( const char *cmd ) {
+    fprintf( stderr,
+             "Usage: %s [-p players] [-c cells] [-A WxH] [-f sweep|charge|random] [-t ticks] [-w warmup_ticks] [-s seed] [-j threads] [-i grid|tree] [-b] [-a] [-T trace.json] [-L frames.log] [-W window_seconds] [-S spike_us] [-R out.amr] [-P in.amr [-k tick]]\n"
+             "  Steps players x cells (default %d) body cells and reports ns/tick. -j 0 uses all cores.\n"
+             "  -A sets the arena size, the default grows it with the players and cells.\n"
+             "  -f drives the sticks: sweep them around, charge the center and tear apart, or wander randomly.\n"
+             "  -b integrates the bodies in SIMD batches.\n"
+             "  -a fails if a step allocates after the warm-up ticks.\n"
+             "  -T writes the zones of the timed ticks as a Chrome trace (needs -DAMOEBA_TRACE=ON).\n"
+             "  -L appends the tick time percentiles and slowest ticks of every -W seconds (default the whole run).\n"
+             "  -S counts ticks at least this long as spikes, the default is the p99 of the warm-up ticks.\n"
+             "  -R records the inputs of the run. -P runs a recording instead of a scenario, from its keyframe\n"
+             "     at or before tick -k, and checks the keyframes it passes while the run is exact.\n",
+             cmd, BODY_CELL_NUM_PER_PLAYER );
+}
+
+int main( int argc, char **argv ) {
+    ScenarioConfig config;
+    int ticks = 1000;
+    int warmup = 100;
+    int threads = 1;
+    bool batch = false;
+    bool allocCheck = false;
+    const char *tracePath = NULL;
+    const char *logPath = NULL;
+    double windowSeconds = 0;
+    double spikeUs = 0;
+    const char *recordPath = NULL;
+    const char *playPath = NULL;
+    int seekTick = 0;
+
+    for(int i=1;i<argc;i++) {
+        if( strcmp(argv[i],"-p")==0 && i+1<argc ) {
+            config.players = atoi(argv[++i]);
+        } else if( strcmp(argv[i],"-c")==0 && i+1<argc ) {
+            config.cells = atoi(argv[++i]);
+        } else if( strcmp(argv[i],"-A")==0 && i+1<argc && sscanf(argv[i+1], "%fx%f", &config.width, &config.height)==2 ) {
+            i++;
+        } else if( strcmp(argv[i],"-f")==0 && i+1<argc && Scenario::ParseForces(argv[i+1], &config.forces) ) {
+            i++;
+        } else if( strcmp(argv[i],"-t")==0 && i+1<argc ) {
+            ticks = atoi(argv[++i]);
+        } else if( strcmp(argv[i],"-w")==0 && i+1<argc ) {
+            warmup = atoi(argv[++i]);
+        } else if( strcmp(argv[i],"-s")==0 && i+1<argc ) {
+            config.seed = (unsigned int) strtoul(argv[++i], NULL, 10);
+        } else if( strcmp(argv[i],"-i")==0 && i+1<argc && (strcmp(argv[i+1],"grid")==0 || strcmp(argv[i+1],"tree")==0) ) {
+            config.useGrid = strcmp(argv[++i],"grid")==0;
+        } else if( strcmp(argv[i],"-j")==0 && i+1<argc ) {
+            threads = atoi(argv[++i]);
+        } else if( strcmp(argv[i],"-b")==0 ) {
+            batch = true;
+        } else if( strcmp(argv[i],"-a")==0 ) {
+            allocCheck = true;
+        } else if( strcmp(argv[i],"-T")==0 && i+1<argc ) {
+            tracePath = argv[++i];
+        } else if( strcmp(argv[i],"-L")==0 && i+1<argc ) {
+            logPath = argv[++i];
+        } else if( strcmp(argv[i],"-W")==0 && i+1<argc ) {
+            windowSeconds = atof(argv[++i]);
+        } else if( strcmp(argv[i],"-S")==0 && i+1<argc ) {
+            spikeUs = atof(argv[++i]);
+        } else if( strcmp(argv[i],"-R")==0 && i+1<argc ) {
+            recordPath = argv[++i];
+        } else if( strcmp(argv[i],"-P")==0 && i+1<argc ) {
+            playPath = argv[++i];
+        } else if( strcmp(argv[i],"-k")==0 && i+1<argc ) {
+            seekTick = atoi(argv[++i]);
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if( config.players <= 0 || config.cells < 0 || config.width < 0 || config.height < 0 || ticks <= 0 || warmup < 0 || threads < 0 || windowSeconds < 0 || spikeUs < 0 || seekTick < 0 ) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    // A recording takes the place of the scenario, with the sim it was made on.
+    std::unique_ptr<Scenario> scenario;
+    std::unique_ptr<Sim> replaySim;
+    ReplayPlayer player;
+    if( playPath ) {
+        if( player.Open( playPath ) ) replaySim.reset( player.NewSim() );
+        if( !replaySim ) {
+            fprintf( stderr, "can't read %s\n", playPath );
+            return 1;
+        }
+    } else {
+        scenario.reset( new Scenario( config ) );
+    }
+    Sim &sim = scenario ? *scenario->GetSim() : *replaySim;
+    sim.SetThreads(threads);
+#ifdef PHYS_HASTY_SPACE
+    cpHastySpaceSetBatchIntegration( sim.GetSpace(), batch );
+#endif
+
+    int replayStart = 0;
+    if( playPath ) {
+        if( !player.Seek( &sim, seekTick ) ) {
+            fprintf( stderr, "%s has %d ticks\n", playPath, player.GetTickNum() );
+            return 1;
+        }
+        replayStart = player.GetTick();
+        if( !player.IsExact() ) fprintf( stderr, "starting from a keyframe isn't exact, the snapshots have no joints or contacts\n" );
+        int left = player.GetTickNum() - replayStart;
+        if( warmup + ticks > left ) ticks = left - warmup;
+        if( ticks <= 0 ) {
+            fprintf( stderr, "%s has %d ticks after %d, not enough for %d warm-up ticks\n", playPath, left, replayStart, warmup );
+            return 1;
+        }
+    }
+    ReplayRecorder recorder;
+    if( recordPath && !recorder.Open( recordPath, &sim, 1.0 / 60.0 ) ) {
+        fprintf( stderr, "can't open %s\n", recordPath );
+        return 1;
+    }
+
+    // Applies the inputs of the tick and returns its time step.
+    auto driveTick = [&]( int tick ) -> double {
+        if( !scenario ) return player.Next( &sim );
+        scenario->Drive( tick );
+        return 1.0 / 60.0;
+    };
+    FrameStats warmupFrames;
+    for(int i=0;i<warmup;i++) {
+        warmupFrames.BeginFrame();
+        sim.ResetCounters();
+        sim.Update( driveTick( i ) );
+        warmupFrames.EndFrame( sim.GetCounters() );
+    }
+    warmupFrames.Flush();
+
+    // Every tick is a frame with only an update.
+    FrameStats frames;
+    if( logPath && !frames.SetLog( logPath ) ) {
+        fprintf( stderr, "can't open %s\n", logPath );
+        return 1;
+    }
+    frames.SetWindowSeconds( windowSeconds > 0 ? windowSeconds : 1e9 );
+    frames.SetSpikeThreshold( spikeUs > 0 ? (uint64_t)( spikeUs * 1000 ) : warmupFrames.GetTotal( FRAME_TOTAL ).p99 );
+
+    cpAllocSite sitesBefore[MAX_ALLOC_SITES];
+    int siteCountBefore = cpGetAllocSites( sitesBefore, MAX_ALLOC_SITES );
+    unsigned long stepAllocs = 0, stepAllocBytes = 0;
+    int allocTicks = 0;
+
+    cpSpaceStepStats stats = {};
+#ifdef PHYS_HASTY_SPACE
+    cpHastySpaceTimings phases = {};
+#endif
+    TraceNameThread( "main" );
+    if( tracePath ) TraceStart();
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for(int i=0;i<ticks;i++) {
+        frames.BeginFrame();
+        sim.ResetCounters();
+        double dt = driveTick( warmup + i );
+        uint64_t updateStart = TraceNow();
+        sim.Update(dt);
+        frames.Record( FRAME_UPDATE, TraceNow() - updateStart );
+        cpAllocStats allocs = cpSpaceGetStepAllocStats( sim.GetSpace() );
+        stepAllocs += allocs.allocations;
+        stepAllocBytes += allocs.bytes;
+        if( allocs.allocations ) allocTicks++;
+        cpSpaceStepStats s = cpSpaceGetStepStats( sim.GetSpace() );
+        stats.resetArbiters += s.resetArbiters;
+        stats.integratePositions += s.integratePositions;
+        stats.updateBBs += s.updateBBs;
+        stats.broadphase += s.broadphase;
+        stats.narrowphase += s.narrowphase;
+        stats.processComponents += s.processComponents;
+        stats.filterArbiters += s.filterArbiters;
+        stats.preStep += s.preStep;
+        stats.integrateVelocities += s.integrateVelocities;
+        stats.applyCachedImpulses += s.applyCachedImpulses;
+        stats.solve += s.solve;
+        stats.postSolve += s.postSolve;
+        stats.step += s.step;
+        stats.candidatePairs += s.candidatePairs;
+        stats.collideCalls += s.collideCalls;
+        stats.newArbiters += s.newArbiters;
+        stats.cachedArbiters += s.cachedArbiters;
+        stats.removedArbiters += s.removedArbiters;
+        stats.postStepCallbacks += s.postStepCallbacks;
+#ifdef PHYS_HASTY_SPACE
+        cpHastySpaceTimings t = cpHastySpaceGetTimings( sim.GetSpace() );
+        phases.integratePositions += t.integratePositions;
+        phases.updateBBs += t.updateBBs;
+        phases.broadphase += t.broadphase;
+        phases.narrowphase += t.narrowphase;
+        phases.mergeContacts += t.mergeContacts;
+        phases.processComponents += t.processComponents;
+        phases.preStep += t.preStep;
+        phases.integrateVelocities += t.integrateVelocities;
+        phases.solve += t.solve;
+        phases.postSolve += t.postSolve;
+        phases.step += t.step;
+        phases.wait += t.wait;
+#endif
+        frames.EndFrame( sim.GetCounters() );
+    }
+    std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+    frames.Flush();
+    recorder.Close();
+    if( tracePath ) {
+        TraceStop();
+        if( !TraceWrite( tracePath ) ) {
+            fprintf( stderr, "can't write %s\n", tracePath );
+            return 1;
+        }
+    }
+
+    long long ns = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+    int cells = 0;
+    for(int i=0;i<sim.GetGroupNum();i++) cells += sim.GetCellCount(i);
+
+    printf( "players: %d\n", sim.GetGroupNum() );
+    printf( "cells_per_player: %d\n", sim.GetBodyCellNum() );
+    printf( "arena: %.0fx%.0f\n", sim.GetWidth(), sim.GetHeight() );
+    printf( "forces: %s\n", scenario ? Scenario::GetForcesName( scenario->GetConfig().forces ) : "replay" );
+    printf( "threads: %d\n", sim.GetThreads() );
+    printf( "index: %s\n", sim.UsesGrid() ? "grid" : "tree" );
+    printf( "batch: %d\n", batch ? 1 : 0 );
+    printf( "cells: %d\n", cells );
+    printf( "ticks: %d\n", ticks );
+    printf( "total_ms: %.3f\n", ns / 1e6 );
+    printf( "ns_per_tick: %.0f\n", (double)ns / ticks );
+    printf( "step_allocs: %lu\n", stepAllocs );
+    printf( "step_alloc_bytes: %lu\n", stepAllocBytes );
+    printf( "alloc_ticks: %d\n", allocTicks );
+    printf( "arena_bytes: %lu\n", (unsigned long)sim.GetArenaBytes() );
+    // Tail of the update and of the whole tick (with the stat reads), from the histograms.
+    FrameChannel channels[2] = { FRAME_UPDATE, FRAME_TOTAL };
+    const char *channelNames[2] = { "update", "tick" };
+    for(int k=0;k<2;k++) {
+        FramePercentiles p = frames.GetTotal( channels[k] );
+        printf( "%s_p50_ns: %llu\n", channelNames[k], (unsigned long long)p.p50 );
+        printf( "%s_p90_ns: %llu\n", channelNames[k], (unsigned long long)p.p90 );
+        printf( "%s_p99_ns: %llu\n", channelNames[k], (unsigned long long)p.p99 );
+        printf( "%s_p999_ns: %llu\n", channelNames[k], (unsigned long long)p.p999 );
+        printf( "%s_max_ns: %llu\n", channelNames[k], (unsigned long long)p.max );
+    }
+    // How hard the scenario pushed the sim.
+    const SimCounters &work = frames.GetTotalCounters();
+    printf( "collisions_per_tick: %.1f\n", (double)work.collisions / ticks );
+    printf( "new_arbiters_per_tick: %.1f\n", (double)work.newArbiters / ticks );
+    printf( "joins_per_tick: %.2f\n", (double)work.joins / ticks );
+    printf( "separations_per_tick: %.2f\n", (double)work.separations / ticks );
+    printf( "freed_cells: %llu\n", (unsigned long long)work.freedCells );
+    printf( "respawns: %llu\n", (unsigned long long)work.respawns );
+    if( playPath ) {
+        printf( "replay_start: %d\n", replayStart );
+        // 0 after a seek, the keyframes don't save the joints.
+        printf( "replay_exact: %d\n", player.IsExact() ? 1 : 0 );
+        printf( "replay_mismatches: %d\n", player.GetMismatchNum() );
+        if( player.GetMismatchNum() ) printf( "replay_first_mismatch: %d\n", player.GetFirstMismatch() );
+    }
+    // What the spike ticks did on average, next to all ticks.
+    uint64_t spikes = frames.GetSpikeCount();
+    printf( "spikes: %llu\n", (unsigned long long)spikes );
+    if( spikes ) {
+        const SimCounters &a = frames.GetTotalCounters(), &b = frames.GetSpikeCounters();
+        printf( "spike_new_arbiters: %.1f vs %.1f\n", (double)b.newArbiters / spikes, (double)a.newArbiters / ticks );
+        printf( "spike_removed_arbiters: %.1f vs %.1f\n", (double)b.removedArbiters / spikes, (double)a.removedArbiters / ticks );
+        printf( "spike_collisions: %.1f vs %.1f\n", (double)b.collisions / spikes, (double)a.collisions / ticks );
+        printf( "spike_joins: %.1f vs %.1f\n", (double)b.joins / spikes, (double)a.joins / ticks );
+        printf( "spike_separations: %.1f vs %.1f\n", (double)b.separations / spikes, (double)a.separations / ticks );
+        printf( "spike_freed_cells: %.1f vs %.1f\n", (double)b.freedCells / spikes, (double)a.freedCells / ticks );
+        printf( "spike_respawns: %.2f vs %.2f\n", (double)b.respawns / spikes, (double)a.respawns / ticks );
+    }
+#ifdef PHYS_HASTY_SPACE
+    // Average wall time of each phase of the chipmunk step.
+    printf( "integrate_positions_ns: %.0f\n", phases.integratePositions * 1e9 / ticks );
+    printf( "update_bbs_ns: %.0f\n", phases.updateBBs * 1e9 / ticks );
+    printf( "broadphase_ns: %.0f\n", phases.broadphase * 1e9 / ticks );
+    printf( "narrowphase_ns: %.0f\n", phases.narrowphase * 1e9 / ticks );
+    printf( "merge_contacts_ns: %.0f\n", phases.mergeContacts * 1e9 / ticks );
+    printf( "process_components_ns: %.0f\n", phases.processComponents * 1e9 / ticks );
+    printf( "prestep_ns: %.0f\n", phases.preStep * 1e9 / ticks );
+    printf( "integrate_velocities_ns: %.0f\n", phases.integrateVelocities * 1e9 / ticks );
+    printf( "solve_ns: %.0f\n", phases.solve * 1e9 / ticks );
+    printf( "post_solve_ns: %.0f\n", phases.postSolve * 1e9 / ticks );
+    printf( "step_ns: %.0f\n", phases.step * 1e9 / ticks );
+    printf( "join_wait_ns: %.0f\n", phases.wait * 1e9 / ticks );
+#endif
+    // Only recorded when chipmunk is built with -DSTEP_STATS=ON.
+    if( stats.step > 0 ) {
+        printf( "stats_reset_arbiters_ns: %.0f\n", stats.resetArbiters * 1e9 / ticks );
+        printf( "stats_integrate_positions_ns: %.0f\n", stats.integratePositions * 1e9 / ticks );
+        printf( "stats_update_bbs_ns: %.0f\n", stats.updateBBs * 1e9 / ticks );
+        printf( "stats_broadphase_ns: %.0f\n", stats.broadphase * 1e9 / ticks );
+        printf( "stats_narrowphase_ns: %.0f\n", stats.narrowphase * 1e9 / ticks );
+        printf( "stats_process_components_ns: %.0f\n", stats.processComponents * 1e9 / ticks );
+        printf( "stats_filter_arbiters_ns: %.0f\n", stats.filterArbiters * 1e9 / ticks );
+        printf( "stats_prestep_ns: %.0f\n", stats.preStep * 1e9 / ticks );
+        printf( "stats_integrate_velocities_ns: %.0f\n", stats.integrateVelocities * 1e9 / ticks );
+        printf( "stats_apply_cached_impulses_ns: %.0f\n", stats.applyCachedImpulses * 1e9 / ticks );
+        printf( "stats_solve_ns: %.0f\n", stats.solve * 1e9 / ticks );
+        printf( "stats_post_solve_ns: %.0f\n", stats.postSolve * 1e9 / ticks );
+        printf( "stats_step_ns: %.0f\n", stats.step * 1e9 / ticks );
+        printf( "stats_candidate_pairs: %.1f\n", (double)stats.candidatePairs / ticks );
+        printf( "stats_collide_calls: %.1f\n", (double)stats.collideCalls / ticks );
+        printf( "stats_new_arbiters: %.1f\n", (double)stats.newArbiters / ticks );
+        printf( "stats_cached_arbiters: %.1f\n", (double)stats.cachedArbiters / ticks );
+        printf( "stats_removed_arbiters: %.1f\n", (double)stats.removedArbiters / ticks );
+        printf( "stats_post_step_callbacks: %.1f\n", (double)stats.postStepCallbacks / ticks );
+    }
+
+    if( allocCheck && stepAllocs > 0 ) {
+        // The sites that grew while timing, the step's share of them is what needs a pool.
+        cpAllocSite sites[MAX_ALLOC_SITES];
+        int siteCount = cpGetAllocSites( sites, MAX_ALLOC_SITES );
+        if( siteCount > MAX_ALLOC_SITES ) siteCount = MAX_ALLOC_SITES;
+        if( siteCountBefore > MAX_ALLOC_SITES ) siteCountBefore = MAX_ALLOC_SITES;
+        for(int i=0;i<siteCount;i++) {
+            unsigned long allocations = sites[i].allocations, bytes = sites[i].bytes;
+            if( i < siteCountBefore ) {
+                allocations -= sitesBefore[i].allocations;
+                bytes -= sitesBefore[i].bytes;
+            }
+            if( allocations ) fprintf( stderr, "%s:%d %lu allocations %lu bytes\n", sites[i].file, sites[i].line, allocations, bytes );
+        }
+        // Chipmunk only records the call sites with -DSTEP_STATS=ON.
+        if( siteCount == 0 ) fprintf( stderr, "rebuild with -DSTEP_STATS=ON to see where\n" );
+        fprintf( stderr, "%d of %d steps allocated after %d warm-up ticks\n", allocTicks, ticks, warmup );
+        return 1;
+    }
+    return 0;
+}
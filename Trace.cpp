@@ -0,0 +1,171 @@
+//
+// Trace.cpp - Per thread zone rings and the Chrome trace writer
+//
+#include <stdio.h>
+#include <string.h>
+
+#include <mutex>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#include "Trace.h"
+
+#if defined(_MSC_VER)
+#define TRACE_THREAD_LOCAL __declspec(thread)
+#else
+#define TRACE_THREAD_LOCAL __thread
+#endif
+
+#define TRACE_STACK_DEPTH 32
+
+struct TraceEvent
+{
+    const char *name;
+    uint64_t begin, end;
+};
+
+// Only the owning thread writes to its ring, so recording a zone takes no lock.
+struct TraceRing
+{
+    std::atomic<uint64_t> head; // zones written so far
+    TraceEvent events[TRACE_RING_SIZE];
+    int tid;
+    char name[64];
+    // Open TraceBegin() zones, the name is null if they started while not recording.
+    const char *stackName[TRACE_STACK_DEPTH];
+    uint64_t stackBegin[TRACE_STACK_DEPTH];
+    int depth;
+};
+
+std::atomic<bool> g_traceRecording(false);
+static uint64_t s_traceStart;
+static std::mutex s_ringsMutex;
+static std::vector<TraceRing*> s_rings; // never freed, there is one per thread that ever recorded
+static TRACE_THREAD_LOCAL TraceRing *t_ring;
+
+static TraceRing *GetRing() {
+    TraceRing *ring = t_ring;
+    if( !ring ) {
+        ring = new TraceRing;
+        ring->head.store( 0 );
+        ring->name[0] = '\0';
+        ring->depth = 0;
+
+        std::lock_guard<std::mutex> lock( s_ringsMutex );
+        ring->tid = (int)s_rings.size() + 1;
+        s_rings.push_back( ring );
+        t_ring = ring;
+    }
+    return ring;
+}
+
+uint64_t TraceNow() {
+#ifdef _WIN32
+    static LARGE_INTEGER freq;
+    if( freq.QuadPart == 0 ) QueryPerformanceFrequency( &freq );
+    LARGE_INTEGER count;
+    QueryPerformanceCounter( &count );
+    return (uint64_t)(count.QuadPart / freq.QuadPart) * 1000000000ull + (uint64_t)(count.QuadPart % freq.QuadPart) * 1000000000ull / freq.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+#endif
+}
+
+void TraceStart() {
+    s_traceStart = TraceNow();
+    g_traceRecording.store( true );
+}
+
+void TraceStop() {
+    g_traceRecording.store( false );
+}
+
+void TraceNameThread( const char *name, int number ) {
+    TraceRing *ring = GetRing();
+    if( ring->name[0] ) return;
+    if( number >= 0 ) {
+        sprintf( ring->name, "%.40s %d", name, number );
+    } else {
+        sprintf( ring->name, "%.60s", name );
+    }
+}
+
+void TraceRecord( const char *name, uint64_t begin, uint64_t end ) {
+    TraceRing *ring = GetRing();
+    uint64_t h = ring->head.load( std::memory_order_relaxed );
+    TraceEvent *ev = &ring->events[h & (TRACE_RING_SIZE - 1)];
+    ev->name = name;
+    ev->begin = begin;
+    ev->end = end;
+    ring->head.store( h + 1, std::memory_order_release );
+}
+
+void TraceBegin( const char *name ) {
+    TraceRing *ring = GetRing();
+    int d = ring->depth++;
+    if( d >= TRACE_STACK_DEPTH ) return;
+    ring->stackName[d] = TraceIsRecording() ? name : nullptr;
+    if( ring->stackName[d] ) ring->stackBegin[d] = TraceNow();
+}
+
+void TraceEnd() {
+    TraceRing *ring = GetRing();
+    int d = --ring->depth;
+    if( d < 0 ) {
+        ring->depth = 0;
+        return;
+    }
+    if( d < TRACE_STACK_DEPTH && ring->stackName[d] ) TraceRecord( ring->stackName[d], ring->stackBegin[d], TraceNow() );
+}
+
+static void writeString( FILE *fp, const char *s ) {
+    fputc( '"', fp );
+    for(;*s;s++) {
+        if( *s == '"' || *s == '\\' ) fputc( '\\', fp );
+        if( (unsigned char)*s >= 0x20 ) fputc( *s, fp );
+    }
+    fputc( '"', fp );
+}
+
+bool TraceWrite( const char *path ) {
+    FILE *fp = fopen( path, "w" );
+    if( !fp ) return false;
+
+    fprintf( fp, "{\"traceEvents\":[\n" );
+    const char *sep = "";
+    std::lock_guard<std::mutex> lock( s_ringsMutex );
+    for(unsigned int r=0;r<s_rings.size();r++) {
+        TraceRing *ring = s_rings[r];
+        if( ring->name[0] ) {
+            fprintf( fp, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":", sep, ring->tid );
+            writeString( fp, ring->name );
+            fprintf( fp, "}}" );
+            sep = ",\n";
+        }
+
+        uint64_t head = ring->head.load( std::memory_order_acquire );
+        uint64_t first = head > TRACE_RING_SIZE ? head - TRACE_RING_SIZE : 0;
+        for(uint64_t i=first;i<head;i++) {
+            const TraceEvent *ev = &ring->events[i & (TRACE_RING_SIZE - 1)];
+            if( ev->begin < s_traceStart ) continue;
+            // Chrome wants microseconds.
+            fprintf( fp, "%s{\"name\":", sep );
+            writeString( fp, ev->name );
+            fprintf( fp, ",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+                     ring->tid, (ev->begin - s_traceStart) / 1000.0, (ev->end - ev->begin) / 1000.0 );
+            sep = ",\n";
+        }
+    }
+    fprintf( fp, "\n]}\n" );
+
+    bool ok = !ferror( fp );
+    if( fclose( fp ) != 0 ) ok = false;
+    return ok;
+}
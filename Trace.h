@@ -0,0 +1,55 @@
+//
+// Trace.h - Scoped zone tracer, writes Chrome trace JSON (chrome://tracing or ui.perfetto.dev)
+//
+
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+
+// Zones are only recorded between TraceStart() and TraceStop(), otherwise a zone costs one load.
+// Every thread writes its own ring of TRACE_RING_SIZE zones, the oldest are overwritten when it is full.
+#define TRACE_RING_SIZE (1<<16)
+
+void TraceStart();
+void TraceStop();
+// Writes the zones recorded since TraceStart(). The other threads must not be recording while
+// this runs, call it between frames or after TraceStop().
+bool TraceWrite( const char *path );
+// Names the calling thread in the trace, "name number" if number >= 0. Only the first call per thread counts.
+void TraceNameThread( const char *name, int number = -1 );
+
+// Nanoseconds on a monotonic clock.
+uint64_t TraceNow();
+// name must outlive the trace, string literals are what's expected.
+void TraceRecord( const char *name, uint64_t begin, uint64_t end );
+// For zones that don't match a C++ scope, like the chipmunk worker jobs. They must nest on each thread.
+void TraceBegin( const char *name );
+void TraceEnd();
+
+extern std::atomic<bool> g_traceRecording;
+
+inline bool TraceIsRecording() { return g_traceRecording.load( std::memory_order_relaxed ); }
+
+class TraceZone
+{
+public:
+    TraceZone( const char *name ) : m_name( TraceIsRecording() ? name : nullptr ) {
+        if( m_name ) m_begin = TraceNow();
+    }
+    ~TraceZone() {
+        if( m_name ) TraceRecord( m_name, m_begin, TraceNow() );
+    }
+private:
+    const char *m_name;
+    uint64_t m_begin;
+};
+
+// Build with AMOEBA_TRACE defined to compile the zones in.
+#ifdef AMOEBA_TRACE
+#define TRACE_CONCAT2(a,b) a##b
+#define TRACE_CONCAT(a,b) TRACE_CONCAT2(a,b)
+#define TRACE_ZONE(name) TraceZone TRACE_CONCAT(traceZone, __LINE__)( name )
+#else
+#define TRACE_ZONE(name)
+#endif